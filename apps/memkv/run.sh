@@ -17,6 +17,7 @@ function usage()
     echo "   list_onebox               list memkv onebox"
     echo
     echo "   test                      run unit test"
+    echo "   bench                     run memkv_bench against the onebox"
     echo
     echo "Command 'run.sh <command> -h' will print help for subcommands."
 }
@@ -162,6 +163,16 @@ function unit_test()
 
 function run_test() {
     unit_test memkv_store_test
+    unit_test change_buffer_test
+}
+
+#####################
+## bench
+#####################
+
+function run_bench() {
+    cd ${PROJECT_DIR}
+    ./output/bin/memkv_bench $*
 }
 
 ####################################################################
@@ -200,6 +211,10 @@ case $cmd in
         shift
         run_test $*
         ;;
+    bench)
+        shift
+        run_bench $*
+        ;;
     *)
         echo "ERROR: unknown command $cmd"
         echo
@@ -0,0 +1,81 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdlib>
+
+#include "arena.h"
+#include "logging.h"
+
+namespace memkv {
+
+Arena::Arena() : ptr_(nullptr), remaining_(0), memoryUsage_(0) {
+  for (size_t i = 0; i < kNumClasses; i++) {
+    freeLists_[i] = nullptr;
+  }
+}
+
+Arena::~Arena() {
+  for (char *block : blocks_) {
+    delete[] block;
+  }
+}
+
+char *Arena::Allocate(size_t bytes) {
+  DCHECK_GT(bytes, 0);
+
+  if (bytes > kMaxSmallSize) {
+    memoryUsage_.fetch_add(bytes, std::memory_order_relaxed);
+    return static_cast<char *>(malloc(bytes));
+  }
+
+  size_t cls = classOf(bytes);
+  std::lock_guard<std::mutex> g(mu_);
+  FreeChunk *chunk = freeLists_[cls];
+  if (chunk != nullptr) {
+    freeLists_[cls] = chunk->next;
+    return reinterpret_cast<char *>(chunk);
+  }
+  return allocateFromBlock((cls + 1) * kAlignment);
+}
+
+void Arena::Free(char *p, size_t bytes) {
+  if (bytes > kMaxSmallSize) {
+    memoryUsage_.fetch_sub(bytes, std::memory_order_relaxed);
+    free(p);
+    return;
+  }
+
+  size_t cls = classOf(bytes);
+  auto chunk = reinterpret_cast<FreeChunk *>(p);
+  std::lock_guard<std::mutex> g(mu_);
+  chunk->next = freeLists_[cls];
+  freeLists_[cls] = chunk;
+}
+
+char *Arena::allocateFromBlock(size_t bytes) {
+  if (bytes > remaining_) {
+    // the tail of the current block is wasted, it's less than kMaxSmallSize.
+    ptr_ = new char[kBlockSize];
+    remaining_ = kBlockSize;
+    blocks_.push_back(ptr_);
+    memoryUsage_.fetch_add(kBlockSize, std::memory_order_relaxed);
+  }
+
+  char *result = ptr_;
+  ptr_ += bytes;
+  remaining_ -= bytes;
+  return result;
+}
+
+}  // namespace memkv
@@ -0,0 +1,83 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <silly/disallow_copying.h>
+
+namespace memkv {
+
+// Arena allocates the small objects of a store from large blocks, instead of
+// calling malloc for each of them, which saves the per-allocation overhead of malloc
+// and keeps the objects of a store close to each other.
+//
+// Allocations are rounded up to size classes of 16 bytes. A freed chunk is kept in
+// the free list of its class for reuse, memory is returned to the system only when
+// the arena is destroyed. Allocations larger than kMaxSmallSize go to malloc directly.
+//
+// Thread-Safe
+class Arena {
+  __DISALLOW_COPYING__(Arena);
+
+ public:
+  Arena();
+
+  ~Arena();
+
+  // The returned memory is 8-byte aligned.
+  char* Allocate(size_t bytes);
+
+  // REQUIRES: `bytes` is the size `p` was allocated with.
+  void Free(char* p, size_t bytes);
+
+  // The bytes allocated from the system, including the free chunks.
+  size_t MemoryUsage() const {
+    return memoryUsage_.load(std::memory_order_relaxed);
+  }
+
+  static const size_t kMaxSmallSize = 1024;
+
+ private:
+  static const size_t kAlignment = 16;
+  static const size_t kNumClasses = kMaxSmallSize / kAlignment;
+  static const size_t kBlockSize = 1024 * 1024;
+
+  static size_t classOf(size_t bytes) {
+    return (bytes + kAlignment - 1) / kAlignment - 1;
+  }
+
+  // REQUIRES: mu_ held
+  char* allocateFromBlock(size_t bytes);
+
+ private:
+  struct FreeChunk {
+    FreeChunk* next;
+  };
+
+  std::mutex mu_;
+
+  std::vector<char*> blocks_;
+  char* ptr_;
+  size_t remaining_;
+
+  FreeChunk* freeLists_[kNumClasses];
+
+  std::atomic<size_t> memoryUsage_;
+};
+
+}  // namespace memkv
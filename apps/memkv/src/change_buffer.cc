@@ -0,0 +1,142 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "change_buffer.h"
+#include "logging.h"
+#include "memkv_store.h"
+
+namespace memkv {
+
+// Whether `path` is `dir` or a descendant of it.
+static bool isUnder(const std::string &path, const std::string &dir) {
+  if (dir == "/") {
+    return true;
+  }
+  return path.size() >= dir.size() && path.compare(0, dir.size(), dir) == 0 &&
+         (path.size() == dir.size() || path[dir.size()] == '/');
+}
+
+static bool matches(const WatchEvent &event, const std::string &dir) {
+  // deleting an ancestor of the directory deletes the directory as well.
+  return isUnder(event.path, dir) ||
+         (event.type == WatchEvent::kDelete && isUnder(dir, event.path));
+}
+
+ChangeBuffer::ChangeBuffer(size_t capacity, HistoryReader reader)
+    : capacity_(capacity), reader_(std::move(reader)), firstIndex_(1), lastIndex_(0), nextId_(1) {}
+
+ChangeBuffer::~ChangeBuffer() = default;
+
+void ChangeBuffer::Append(uint64_t index, const std::vector<WatchEvent> &events) {
+  std::lock_guard<std::mutex> g(mu_);
+  DCHECK_GT(index, lastIndex_);
+  lastIndex_ = index;
+
+  for (const WatchEvent &e : events) {
+    events_.push_back(e);
+  }
+  evict();
+
+  for (auto it = watches_.begin(); it != watches_.end();) {
+    bool ok = true;
+    for (const WatchEvent &e : events) {
+      if (matches(e, it->second.path) && !it->second.watcher->OnEvent(e)) {
+        ok = false;
+        break;
+      }
+    }
+    it = ok ? std::next(it) : watches_.erase(it);
+  }
+}
+
+void ChangeBuffer::evict() {
+  // the changes of an index are evicted together, so that the range stays complete.
+  while (events_.size() > capacity_) {
+    uint64_t index = events_.front().index;
+    while (!events_.empty() && events_.front().index == index) {
+      events_.pop_front();
+    }
+    firstIndex_ = index + 1;
+  }
+}
+
+void ChangeBuffer::Reset(uint64_t index) {
+  std::map<uint64_t, Subscription> watches;
+  {
+    std::lock_guard<std::mutex> g(mu_);
+    events_.clear();
+    firstIndex_ = index + 1;
+    lastIndex_ = index;
+    watches.swap(watches_);
+  }
+
+  Status s = FMT_Status(VersionCompacted, "the store is restored to index {}", index);
+  for (auto &e : watches) {
+    e.second.watcher->OnCancelled(s);
+  }
+}
+
+StatusWith<uint64_t> ChangeBuffer::Watch(const Slice &path, uint64_t from_index,
+                                         std::shared_ptr<Watcher> watcher) {
+  std::string dir;
+  ASSIGN_IF_OK(MemKvStore::NormalizePath(path), dir);
+
+  std::unique_lock<std::mutex> lock(mu_);
+  uint64_t id = nextId_++;
+
+  if (from_index != 0 && from_index <= lastIndex_) {
+    // The changes evicted from the buffer are read from the history without the lock,
+    // since it may take long, and Append would block the apply thread meanwhile. The
+    // buffer may evict more in the meantime, so it's checked again after each read.
+    uint64_t next = from_index;
+    while (next < firstIndex_) {
+      uint64_t hi = firstIndex_;
+      lock.unlock();
+
+      std::vector<WatchEvent> history;
+      RETURN_NOT_OK(reader_(next, hi, &history));
+      for (const WatchEvent &e : history) {
+        if (matches(e, dir) && !watcher->OnEvent(e)) {
+          return id;
+        }
+      }
+      next = hi;
+
+      lock.lock();
+    }
+
+    // the rest is in the buffer, the lock is held until the watch is registered, so
+    // that no change is appended in between.
+    for (const WatchEvent &e : events_) {
+      if (e.index >= next && matches(e, dir) && !watcher->OnEvent(e)) {
+        return id;
+      }
+    }
+  }
+
+  watches_[id] = Subscription{std::move(dir), std::move(watcher)};
+  return id;
+}
+
+void ChangeBuffer::Unwatch(uint64_t id) {
+  std::lock_guard<std::mutex> g(mu_);
+  watches_.erase(id);
+}
+
+uint64_t ChangeBuffer::LastIndex() const {
+  std::lock_guard<std::mutex> g(mu_);
+  return lastIndex_;
+}
+
+}  // namespace memkv
@@ -0,0 +1,124 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "slice.h"
+#include "status.h"
+
+namespace memkv {
+
+// A change of a node made by a write, which is pushed to the watchers.
+struct WatchEvent {
+  enum Type {
+    kPut,
+    kDelete,
+  };
+
+  Type type;
+
+  // the index of the raft log entry that made the change.
+  uint64_t index;
+
+  // the normalized path, e.g "/a/b". Deleting a directory deletes all its
+  // descendants as well.
+  std::string path;
+
+  // empty for kDelete.
+  std::string value;
+};
+
+// Watcher receives the changes under a directory in the order of index.
+class Watcher {
+ public:
+  virtual ~Watcher() = default;
+
+  // It's called in the apply thread, so it must not block. Returning false ends the
+  // watch, no more events are delivered afterwards.
+  virtual bool OnEvent(const WatchEvent &event) = 0;
+
+  // The watch is cancelled by the buffer, since the changes it waits for are lost,
+  // e.g the store is restored from a snapshot.
+  virtual void OnCancelled(const Status &reason) = 0;
+};
+
+// ChangeBuffer keeps the latest changes applied to a MemKvStore in memory, and pushes
+// them to the watchers. A watcher may start from an index older than the buffer, the
+// changes not in the buffer are read by the HistoryReader, usually from the raft log.
+//
+// Thread-Safe
+class ChangeBuffer {
+ public:
+  // Reads the changes made by the log entries in [lo, hi).
+  typedef std::function<Status(uint64_t lo, uint64_t hi, std::vector<WatchEvent> *events)>
+      HistoryReader;
+
+  // At most `capacity` changes are kept in memory.
+  ChangeBuffer(size_t capacity, HistoryReader reader);
+
+  ~ChangeBuffer();
+
+  // Appends the changes made by the log entry at `index`, and pushes them to the
+  // watchers.
+  // REQUIRES: `index` > LastIndex()
+  void Append(uint64_t index, const std::vector<WatchEvent> &events);
+
+  // Drops all the changes as the store is restored to the state at `index`. The
+  // watchers are cancelled with VersionCompacted.
+  void Reset(uint64_t index);
+
+  // Watches the changes under `path` made since the entry at `from_index`, 0 means
+  // since the next change. The changes already applied are delivered before it
+  // returns.
+  // Returns the id of the watch, or error VersionCompacted if the changes since
+  // `from_index` are no longer available.
+  StatusWith<uint64_t> Watch(const Slice &path, uint64_t from_index,
+                             std::shared_ptr<Watcher> watcher);
+
+  void Unwatch(uint64_t id);
+
+  // The index of the last appended change.
+  uint64_t LastIndex() const;
+
+ private:
+  struct Subscription {
+    std::string path;
+    std::shared_ptr<Watcher> watcher;
+  };
+
+  // REQUIRES: mu_ held
+  void evict();
+
+  mutable std::mutex mu_;
+
+  const size_t capacity_;
+  HistoryReader reader_;
+
+  // the buffer holds every change made by the entries in [firstIndex_, lastIndex_].
+  std::deque<WatchEvent> events_;
+  uint64_t firstIndex_;
+  uint64_t lastIndex_;
+
+  std::map<uint64_t, Subscription> watches_;
+  uint64_t nextId_;
+};
+
+}  // namespace memkv
@@ -0,0 +1,194 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "change_buffer.h"
+#include "testing.h"
+
+using namespace memkv;
+
+class TestWatcher : public Watcher {
+ public:
+  // the watcher ends after receiving `limit` events, 0 means no limit.
+  explicit TestWatcher(size_t limit = 0) : limit_(limit) {}
+
+  bool OnEvent(const WatchEvent &event) override {
+    events.push_back(event);
+    return limit_ == 0 || events.size() < limit_;
+  }
+
+  void OnCancelled(const Status &reason) override {
+    cancelled = reason;
+  }
+
+  std::vector<uint64_t> Indexes() const {
+    std::vector<uint64_t> result;
+    for (const WatchEvent &e : events) {
+      result.push_back(e.index);
+    }
+    return result;
+  }
+
+  std::vector<WatchEvent> events;
+  Status cancelled;
+
+ private:
+  size_t limit_;
+};
+
+static WatchEvent put(uint64_t index, const std::string &path) {
+  return WatchEvent{WatchEvent::kPut, index, path, "v" + std::to_string(index)};
+}
+
+static WatchEvent del(uint64_t index, const std::string &path) {
+  return WatchEvent{WatchEvent::kDelete, index, path, ""};
+}
+
+static ChangeBuffer::HistoryReader noHistory() {
+  return [](uint64_t lo, uint64_t hi, std::vector<WatchEvent> *events) {
+    return FMT_Status(VersionCompacted, "entries in [{}, {}) are compacted", lo, hi);
+  };
+}
+
+TEST(ChangeBufferTest, WatchDirectory) {
+  ChangeBuffer buffer(100, noHistory());
+  auto watcher = std::make_shared<TestWatcher>();
+  ASSERT_OK(buffer.Watch("/a", 0, watcher).GetStatus());
+  auto deep = std::make_shared<TestWatcher>();
+  ASSERT_OK(buffer.Watch("//a/b/c/", 0, deep).GetStatus());
+
+  buffer.Append(1, {put(1, "/a/b")});
+  buffer.Append(2, {put(2, "/ab"), put(2, "/c")});
+  buffer.Append(3, {put(3, "/a")});
+  buffer.Append(5, {del(5, "/a/b/c")});
+
+  // deleting an ancestor deletes the directory.
+  buffer.Append(6, {del(6, "/a")});
+
+  ASSERT_EQ(watcher->Indexes(), std::vector<uint64_t>({1, 3, 5, 6}));
+  ASSERT_EQ(deep->Indexes(), std::vector<uint64_t>({5, 6}));
+  ASSERT_EQ(watcher->events[1].value, "v3");
+  ASSERT_EQ(watcher->events[2].type, WatchEvent::kDelete);
+  ASSERT_EQ(buffer.LastIndex(), 6);
+}
+
+TEST(ChangeBufferTest, CatchUpFromBuffer) {
+  ChangeBuffer buffer(100, noHistory());
+  for (uint64_t i = 1; i <= 5; i++) {
+    buffer.Append(i, {put(i, "/a")});
+  }
+
+  auto watcher = std::make_shared<TestWatcher>();
+  ASSERT_OK(buffer.Watch("/", 3, watcher).GetStatus());
+  ASSERT_EQ(watcher->Indexes(), std::vector<uint64_t>({3, 4, 5}));
+
+  buffer.Append(6, {put(6, "/a")});
+  ASSERT_EQ(watcher->Indexes(), std::vector<uint64_t>({3, 4, 5, 6}));
+
+  // a watch from a future index starts once the index is applied.
+  auto future = std::make_shared<TestWatcher>();
+  ASSERT_OK(buffer.Watch("/", 10, future).GetStatus());
+  ASSERT_TRUE(future->events.empty());
+}
+
+TEST(ChangeBufferTest, CatchUpFromHistory) {
+  std::vector<std::pair<uint64_t, uint64_t>> reads;
+  ChangeBuffer buffer(2, [&](uint64_t lo, uint64_t hi, std::vector<WatchEvent> *events) {
+    reads.emplace_back(lo, hi);
+    for (uint64_t i = lo; i < hi; i++) {
+      events->push_back(put(i, "/a"));
+    }
+    return Status::OK();
+  });
+
+  for (uint64_t i = 1; i <= 5; i++) {
+    buffer.Append(i, {put(i, "/a")});
+  }
+
+  auto watcher = std::make_shared<TestWatcher>();
+  ASSERT_OK(buffer.Watch("/a", 2, watcher).GetStatus());
+  ASSERT_EQ(watcher->Indexes(), std::vector<uint64_t>({2, 3, 4, 5}));
+  ASSERT_EQ(reads, (std::vector<std::pair<uint64_t, uint64_t>>{{2, 4}}));
+}
+
+TEST(ChangeBufferTest, AppendDuringCatchUp) {
+  std::vector<std::pair<uint64_t, uint64_t>> reads;
+  ChangeBuffer *applier = nullptr;
+  ChangeBuffer buffer(2, [&](uint64_t lo, uint64_t hi, std::vector<WatchEvent> *events) {
+    reads.emplace_back(lo, hi);
+    for (uint64_t i = lo; i < hi; i++) {
+      events->push_back(put(i, "/a"));
+    }
+
+    // the apply thread isn't blocked by the history read, and evicts the changes
+    // that the watch hasn't caught up.
+    if (applier) {
+      applier->Append(6, {put(6, "/a")});
+      applier->Append(7, {put(7, "/a")});
+      applier = nullptr;
+    }
+    return Status::OK();
+  });
+
+  for (uint64_t i = 1; i <= 5; i++) {
+    buffer.Append(i, {put(i, "/a")});
+  }
+
+  applier = &buffer;
+  auto watcher = std::make_shared<TestWatcher>();
+  ASSERT_OK(buffer.Watch("/a", 2, watcher).GetStatus());
+  ASSERT_EQ(watcher->Indexes(), std::vector<uint64_t>({2, 3, 4, 5, 6, 7}));
+  ASSERT_EQ(reads, (std::vector<std::pair<uint64_t, uint64_t>>{{2, 4}, {4, 6}}));
+
+  buffer.Append(8, {put(8, "/a")});
+  ASSERT_EQ(watcher->Indexes(), std::vector<uint64_t>({2, 3, 4, 5, 6, 7, 8}));
+}
+
+TEST(ChangeBufferTest, HistoryCompacted) {
+  ChangeBuffer buffer(1, noHistory());
+  buffer.Append(1, {put(1, "/a")});
+  buffer.Append(2, {put(2, "/a")});
+
+  auto watcher = std::make_shared<TestWatcher>();
+  ASSERT_ERROR(buffer.Watch("/a", 1, watcher).GetStatus(), Error::VersionCompacted);
+  ASSERT_TRUE(watcher->events.empty());
+
+  buffer.Append(3, {put(3, "/a")});
+  ASSERT_TRUE(watcher->events.empty());
+}
+
+TEST(ChangeBufferTest, EndAndCancel) {
+  ChangeBuffer buffer(100, noHistory());
+  auto once = std::make_shared<TestWatcher>(1);
+  auto unwatched = std::make_shared<TestWatcher>();
+  auto cancelled = std::make_shared<TestWatcher>();
+  ASSERT_OK(buffer.Watch("/", 0, once).GetStatus());
+  ASSERT_OK(buffer.Watch("/", 0, cancelled).GetStatus());
+  auto sw = buffer.Watch("/", 0, unwatched);
+  ASSERT_OK(sw.GetStatus());
+  buffer.Unwatch(sw.GetValue());
+
+  buffer.Append(1, {put(1, "/a")});
+  buffer.Append(2, {put(2, "/a")});
+  ASSERT_EQ(once->events.size(), 1);
+  ASSERT_TRUE(unwatched->events.empty());
+  ASSERT_EQ(cancelled->events.size(), 2);
+
+  buffer.Reset(10);
+  ASSERT_ERROR(cancelled->cancelled, Error::VersionCompacted);
+  ASSERT_TRUE(once->cancelled.IsOK());
+  ASSERT_EQ(buffer.LastIndex(), 10);
+
+  buffer.Append(11, {put(11, "/a")});
+  ASSERT_EQ(cancelled->events.size(), 2);
+}
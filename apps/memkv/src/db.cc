@@ -12,11 +12,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <future>
+#include <iterator>
+#include <mutex>
+
+#include "change_buffer.h"
 #include "db.h"
 #include "logging.h"
 #include "memkv_service.h"
 
 #include <consensus/base/coding.h>
+#include <consensus/base/env.h>
 #include <consensus/raft_task_executor.h>
 #include <consensus/replicated_log.h>
 
@@ -25,6 +32,7 @@ namespace memkv {
 enum OpType {
   kWrite = 1,
   kDelete = 2,
+  kBatch = 3,
 };
 
 // Log format:
@@ -32,76 +40,619 @@ enum OpType {
 //            type = 1 byte
 //            path, value = varstring
 //   - DELETE: type path
+//   - BATCH: type count op...
+//            count = varint32
+//            op = WRITE | DELETE
 //
-static std::string LogEncode(OpType type, const Slice &path, const Slice &value) {
-  using consensus::VarintLength;
+static void encodeOp(std::string *result, OpType type, const Slice &path, const Slice &value) {
   using consensus::PutLengthPrefixedSlice;
 
+  result->push_back(static_cast<unsigned char>(type));
+  PutLengthPrefixedSlice(result, path);
+  if (type == kWrite) {
+    PutLengthPrefixedSlice(result, value);
+  }
+}
+
+static std::string LogEncode(OpType type, const Slice &path, const Slice &value) {
   std::string result;
-  result.push_back(static_cast<unsigned char>(type));
+  encodeOp(&result, type, path, value);
+  return result;
+}
 
-  PutLengthPrefixedSlice(&result, path);
-  if (type == kWrite) {
-    PutLengthPrefixedSlice(&result, value);
+static std::string LogEncodeBatch(const std::vector<WriteOp> &ops) {
+  std::string result;
+  result.push_back(static_cast<unsigned char>(kBatch));
+  consensus::PutVarint32(&result, static_cast<uint32_t>(ops.size()));
+  for (const WriteOp &op : ops) {
+    encodeOp(&result, op.type == WriteOp::kWrite ? kWrite : kDelete, op.path, op.value);
   }
   return result;
 }
 
-class DB::Impl {
+static Status decodeOp(Slice *log, WriteOp *op) {
+  using consensus::GetLengthPrefixedSlice;
+
+  if (UNLIKELY(log->size() < 1)) {
+    return Status::Make(Error::InvalidArgument, "empty log");
+  }
+  auto type = static_cast<OpType>((*log)[0]);
+  log->Skip(1);
+
+  if (UNLIKELY(type != kWrite && type != kDelete)) {
+    return FMT_Status(InvalidArgument, "unknown type of log: {}", static_cast<int>(type));
+  }
+  op->type = type == kWrite ? WriteOp::kWrite : WriteOp::kDelete;
+  if (UNLIKELY(!GetLengthPrefixedSlice(log, &op->path))) {
+    return Status::Make(Error::InvalidArgument, "bad path in log");
+  }
+  if (type == kWrite && UNLIKELY(!GetLengthPrefixedSlice(log, &op->value))) {
+    return Status::Make(Error::InvalidArgument, "bad value in log");
+  }
+  return Status::OK();
+}
+
+// Decodes the operations in `log`, a single WRITE or DELETE is decoded as a batch
+// of one.
+static Status LogDecode(Slice log, std::vector<WriteOp> *ops) {
+  ops->clear();
+  if (log.size() > 0 && log[0] == kBatch) {
+    log.Skip(1);
+    uint32_t count;
+    if (UNLIKELY(!consensus::GetVarint32(&log, &count))) {
+      return Status::Make(Error::InvalidArgument, "bad count of batch in log");
+    }
+    // every op takes at least 2 bytes.
+    if (UNLIKELY(count > log.size() / 2)) {
+      return FMT_Status(InvalidArgument, "bad count of batch in log: {}", count);
+    }
+    ops->resize(count);
+  } else {
+    ops->resize(1);
+  }
+
+  for (WriteOp &op : *ops) {
+    RETURN_NOT_OK(decodeOp(&log, &op));
+  }
+  if (UNLIKELY(log.size() > 0)) {
+    return Status::Make(Error::InvalidArgument, "trailing bytes in log");
+  }
+  return Status::OK();
+}
+
+// The changes made by `ops` applied at `index`.
+static void toEvents(const std::vector<WriteOp> &ops, uint64_t index,
+                     std::vector<WatchEvent> *events) {
+  for (const WriteOp &op : ops) {
+    StatusWith<std::string> sw = MemKvStore::NormalizePath(op.path);
+    if (!sw.IsOK()) {
+      continue;
+    }
+
+    WatchEvent e;
+    e.index = index;
+    e.path = sw.GetValue();
+    if (op.type == WriteOp::kWrite) {
+      e.type = WatchEvent::kPut;
+      e.value = op.value.ToString();
+    } else {
+      e.type = WatchEvent::kDelete;
+    }
+    events->push_back(std::move(e));
+  }
+}
+
+// A copy-on-write snapshot of MemKvStore, from which raft snapshots are made.
+class MemKvSnapshot : public consensus::StateMachineSnapshot {
  public:
-  explicit Impl(consensus::ReplicatedLog *replicatedLog)
-      : kv_(new MemKvStore), log_(replicatedLog) {}
+  explicit MemKvSnapshot(MemKvStore *kv) : kv_(kv), snapshot_(kv->GetSnapshot()) {}
 
-  Status Get(const Slice &path, bool stale, std::string *data) {
-    bool allowed = false;
-
-    // TODO: use read/write lock to protect `leader`, it's more efficient than using task queue.
-    uint64_t currentLeader = 0;
-    consensus::Barrier barrier;
-    log_->RaftTaskExecutorInstance()->Submit([&](yaraft::RawNode *node) {
-      currentLeader = node->LeaderHint();
-      barrier.Signal();
+  ~MemKvSnapshot() override {
+    kv_->ReleaseSnapshot(snapshot_);
+  }
+
+  consensus::Status Serialize(std::string *data) override {
+    Status s = kv_->SerializeSnapshot(snapshot_, data);
+    if (!s.IsOK()) {
+      return consensus::Status::Make(consensus::Error::RuntimeError, s.ToString());
+    }
+    return consensus::Status::OK();
+  }
+
+ private:
+  MemKvStore *kv_;
+  const Snapshot *snapshot_;
+};
+
+// WriteCoalescer merges the writes waiting to be proposed. While a proposal is in
+// flight, new writes are queued, and a write to a path that's queued replaces the
+// queued value, so that only the last value is replicated. The queue is proposed as a
+// single batch once the proposal in flight completes, every write in it is
+// acknowledged with the result of the batch.
+// A delete or a batch of writes is never merged, nor is anything merged across it.
+class WriteCoalescer {
+ public:
+  typedef std::function<void(const std::string &log, const DB::Callback &callback)> Proposer;
+
+  explicit WriteCoalescer(Proposer proposer) : proposer_(std::move(proposer)), inflight_(0) {}
+
+  // REQUIRES: `ops` are valid.
+  void Add(const std::vector<WriteOp> &ops, const DB::Callback &callback) {
+    std::lock_guard<std::mutex> g(mu_);
+    bool mergeable = ops.size() == 1 && ops[0].type == WriteOp::kWrite;
+    if (mergeable) {
+      std::string key = MemKvStore::NormalizePath(ops[0].path).GetValue();
+      auto it = lastWrites_.find(key);
+      if (it != lastWrites_.end()) {
+        pending_[it->second].value = ops[0].value.ToString();
+      } else {
+        lastWrites_[key] = pending_.size();
+        pending_.emplace_back(ops[0]);
+      }
+    } else {
+      for (const WriteOp &op : ops) {
+        pending_.emplace_back(op);
+      }
+      lastWrites_.clear();
+    }
+    callbacks_.push_back(callback);
+
+    // a batch is proposed anyway once it's large enough.
+    if (inflight_ == 0 || pending_.size() >= kMaxCoalescedOps) {
+      propose();
+    }
+  }
+
+ private:
+  // A WriteOp that owns its data.
+  struct PendingOp {
+    explicit PendingOp(const WriteOp &op) : type(op.type), path(op.path.ToString()) {
+      if (op.type == WriteOp::kWrite) {
+        value = op.value.ToString();
+      }
+    }
+
+    WriteOp::Type type;
+    std::string path;
+    std::string value;
+  };
+
+  // The proposals are submitted in order under the lock, so that the queued writes
+  // are never reordered.
+  // REQUIRES: mu_ held
+  void propose() {
+    std::vector<WriteOp> ops;
+    for (const PendingOp &op : pending_) {
+      ops.push_back(WriteOp{op.type, op.path, op.value});
+    }
+    std::string log = ops.size() == 1
+                          ? LogEncode(ops[0].type == WriteOp::kWrite ? kWrite : kDelete,
+                                      ops[0].path, ops[0].value)
+                          : LogEncodeBatch(ops);
+
+    auto callbacks = std::make_shared<std::vector<DB::Callback>>(std::move(callbacks_));
+    callbacks_.clear();
+    pending_.clear();
+    lastWrites_.clear();
+    inflight_++;
+
+    proposer_(log, [this, callbacks](const Status &s) {
+      for (const DB::Callback &cb : *callbacks) {
+        cb(s);
+      }
+
+      std::lock_guard<std::mutex> g(mu_);
+      inflight_--;
+      if (inflight_ == 0 && !pending_.empty()) {
+        propose();
+      }
     });
-    barrier.Wait();
+  }
+
+ private:
+  static constexpr size_t kMaxCoalescedOps = 1024;
+
+  Proposer proposer_;
+
+  std::mutex mu_;
+  std::vector<PendingOp> pending_;
+  std::vector<DB::Callback> callbacks_;
+
+  // normalized path -> the position of the last write to it in pending_
+  std::map<std::string, size_t> lastWrites_;
+
+  // the number of proposals in flight.
+  size_t inflight_;
+};
+
+// Partition is the state machine of the replicated log of a raft group, every node
+// applies the committed logs to its own MemKvStore.
+class Partition : public consensus::StateMachine {
+ public:
+  explicit Partition(const DBOptions &options)
+      : readTimeoutMs_(options.read_timeout_ms),
+        kv_(new MemKvStore),
+        changes_(options.watch_buffer_size,
+                 [this](uint64_t lo, uint64_t hi, std::vector<WatchEvent> *events) {
+                   return readHistory(lo, hi, events);
+                 }) {
+    if (options.coalesce_writes) {
+      coalescer_.reset(new WriteCoalescer(
+          [this](const std::string &log, const DB::Callback &cb) { asyncPropose(log, cb); }));
+    }
+  }
+
+  void Apply(const std::vector<yaraft::pb::Entry> &entries) override {
+    for (const auto &e : entries) {
+      if (e.data().empty()) {
+        continue;
+      }
+
+      Status s = applyLog(e.data(), e.index());
+      if (UNLIKELY(!s.IsOK())) {
+        FMT_LOG(WARNING, "failed to apply log [index: {}]: {}", e.index(), s.ToString());
+      }
+    }
+  }
+
+  void ApplySnapshot(const yaraft::pb::Snapshot &snapshot) override {
+    Status s = kv_->Restore(snapshot.data(), snapshot.metadata().index());
+    if (UNLIKELY(!s.IsOK())) {
+      LOG(FATAL) << "failed to restore from snapshot [index: " << snapshot.metadata().index()
+                 << "]: " << s.ToString();
+    }
+    changes_.Reset(snapshot.metadata().index());
+  }
+
+  consensus::StateMachineSnapshot *TakeSnapshot() override {
+    return new MemKvSnapshot(kv_.get());
+  }
+
+  StatusWith<uint64_t> Watch(const Slice &path, uint64_t fromIndex,
+                             std::shared_ptr<Watcher> watcher) {
+    return changes_.Watch(path, fromIndex, std::move(watcher));
+  }
+
+  void Unwatch(uint64_t id) {
+    changes_.Unwatch(id);
+  }
 
-    uint64_t id = log_->Id();
-    if (currentLeader != id && !stale) {
-      return FMT_Status(ConsensusError,
-                        "read from a non-leader node, stale read not allowed [id: {}, leader: {}]",
-                        id, currentLeader);
+  // The batch is replicated as a single log entry.
+  Status Write(const std::vector<WriteOp> &ops) {
+    return waitFor([&](const DB::Callback &cb) { AsyncWrite(ops, cb); });
+  }
+
+  // All the paths are read in one snapshot after a single read index.
+  Status MultiGet(const std::vector<Slice> &paths, bool stale, std::vector<std::string> *values,
+                  std::vector<Status> *statuses) {
+    if (!stale) {
+      RETURN_NOT_OK(waitReadIndex());
+    }
+
+    values->resize(paths.size());
+    statuses->resize(paths.size());
+    const Snapshot *snapshot = kv_->GetSnapshot();
+    for (size_t i = 0; i < paths.size(); i++) {
+      (*statuses)[i] = kv_->Get(paths[i], snapshot, &(*values)[i]);
+    }
+    kv_->ReleaseSnapshot(snapshot);
+    return Status::OK();
+  }
+
+  // A non-stale read is linearizable: it's served after the store has applied the
+  // read index confirmed by the leader. Followers obtain the read index from the
+  // leader, so every replica serves reads.
+  Status Get(const Slice &path, bool stale, std::string *data) {
+    if (!stale) {
+      RETURN_NOT_OK(waitReadIndex());
     }
     return kv_->Get(path, data);
   }
 
+  // The nodes are read in a snapshot, so a page never sees a write partially.
+  Status List(const Slice &path, const ScanOptions &options, bool recursive, bool stale,
+              std::vector<KeyValue> *result, bool *more) {
+    if (!stale) {
+      RETURN_NOT_OK(waitReadIndex());
+    }
+
+    ScanOptions opts = options;
+    opts.snapshot = kv_->GetSnapshot();
+    Status s = recursive ? kv_->Scan(path, opts, result, more)
+                         : kv_->List(path, opts, result, more);
+    kv_->ReleaseSnapshot(opts.snapshot);
+    return s;
+  }
+
+  // The write returns after it's applied to the leader's store.
   Status Delete(const Slice &path) {
-    std::string log = LogEncode(OpType::kDelete, path, nullptr);
+    return waitFor([&](const DB::Callback &cb) { AsyncDelete(path, cb); });
+  }
+
+  Status Write(const Slice &path, const Slice &value) {
+    return waitFor([&](const DB::Callback &cb) { AsyncWrite(path, value, cb); });
+  }
 
-    consensus::Status s = log_->Write(log);
+  // The asynchronous writes complete after they're applied to the leader's store.
+  void AsyncWrite(const Slice &path, const Slice &value, const DB::Callback &callback) {
+    Status s = MemKvStore::CheckWrite(path);
     if (!s.IsOK()) {
-      return Status::Make(Error::ConsensusError, s.ToString());
+      callback(s);
+      return;
     }
+    if (coalescer_) {
+      coalescer_->Add({WriteOp{WriteOp::kWrite, path, value}}, callback);
+      return;
+    }
+    asyncPropose(LogEncode(OpType::kWrite, path, value), callback);
+  }
 
-    RETURN_NOT_OK(kv_->Delete(path));
-    return Status::OK();
+  void AsyncDelete(const Slice &path, const DB::Callback &callback) {
+    Status s = MemKvStore::CheckDelete(path);
+    if (!s.IsOK()) {
+      callback(s);
+      return;
+    }
+    if (coalescer_) {
+      coalescer_->Add({WriteOp{WriteOp::kDelete, path, Slice()}}, callback);
+      return;
+    }
+    asyncPropose(LogEncode(OpType::kDelete, path, nullptr), callback);
   }
 
-  Status Write(const Slice &path, const Slice &value) {
-    std::string log = LogEncode(OpType::kWrite, path, value);
+  void AsyncWrite(const std::vector<WriteOp> &ops, const DB::Callback &callback) {
+    Status s = MemKvStore::CheckWrite(ops);
+    if (!s.IsOK() || ops.empty()) {
+      callback(s);
+      return;
+    }
+    if (coalescer_) {
+      coalescer_->Add(ops, callback);
+      return;
+    }
+    asyncPropose(LogEncodeBatch(ops), callback);
+  }
+
+ private:
+  // Runs the asynchronous write `fn`, and waits for its result.
+  static Status waitFor(const std::function<void(const DB::Callback &)> &fn) {
+    std::promise<Status> result;
+    fn([&result](const Status &s) { result.set_value(s); });
+    return result.get_future().get();
+  }
+
+  void asyncPropose(const std::string &log, const DB::Callback &callback) {
+    log_->AsyncWrite(log, [callback](const consensus::Status &s) {
+      if (!s.IsOK()) {
+        callback(Status::Make(Error::ConsensusError, s.ToString()));
+      } else {
+        callback(Status::OK());
+      }
+    });
+  }
 
-    consensus::Status s = log_->Write(log);
+  Status waitReadIndex() {
+    consensus::StatusWith<uint64_t> sw = log_->ReadIndex();
+    if (!sw.IsOK()) {
+      return Status::Make(Error::ConsensusError, sw.ToString());
+    }
+
+    consensus::Status s = log_->WaitApplied(sw.GetValue(), readTimeoutMs_);
     if (!s.IsOK()) {
-      return Status::Make(Error::ConsensusError, s.ToString());
+      // the store may catch up later, or the read may be served by another node.
+      bool retryable = s.Code() == consensus::Error::TimedOut ||
+                       s.Code() == consensus::Error::IllegalState;
+      return Status::Make(retryable ? Error::Unavailable : Error::ConsensusError, s.ToString());
+    }
+    return Status::OK();
+  }
+
+  // The versions made by the log are tagged by its index, so that the state of the
+  // store at an index is the same on every replica.
+  Status applyLog(const Slice &log, uint64_t index) {
+    std::vector<WriteOp> ops;
+    RETURN_NOT_OK(LogDecode(log, &ops));
+
+    Status s;
+    if (ops.size() == 1) {
+      const WriteOp &op = ops[0];
+      s = op.type == WriteOp::kWrite ? kv_->Write(op.path, op.value, index)
+                                     : kv_->Delete(op.path, index);
+    } else {
+      s = kv_->Write(ops, index);
     }
+    RETURN_NOT_OK(s);
 
-    RETURN_NOT_OK(kv_->Write(path, value));
+    std::vector<WatchEvent> events;
+    toEvents(ops, index, &events);
+    changes_.Append(index, events);
     return Status::OK();
   }
 
+  // The changes older than the change buffer are decoded from the raft log, which
+  // has every entry since the last compaction.
+  Status readHistory(uint64_t lo, uint64_t hi, std::vector<WatchEvent> *events) {
+    while (lo < hi) {
+      std::vector<yaraft::pb::Entry> entries;
+      consensus::Status s = log_->Entries(lo, hi, kHistoryBatchBytes, &entries);
+      if (s.Code() == consensus::Error::LogCompacted) {
+        return Status::Make(Error::VersionCompacted, s.ToString());
+      }
+      if (!s.IsOK()) {
+        return Status::Make(Error::ConsensusError, s.ToString());
+      }
+
+      if (entries.empty()) {
+        break;
+      }
+      for (const auto &e : entries) {
+        std::vector<WriteOp> ops;
+        if (!e.data().empty() && LogDecode(e.data(), &ops).IsOK()) {
+          toEvents(ops, e.index(), events);
+        }
+      }
+      lo = entries.back().index() + 1;
+    }
+    return Status::OK();
+  }
+
+ public:
+  void SetLog(consensus::ReplicatedLog *log) {
+    log_.reset(log);
+  }
+
+  consensus::ReplicatedLog *Log() const {
+    return log_.get();
+  }
+
  private:
-  friend class DB;
+  static constexpr uint64_t kHistoryBatchBytes = 1024 * 1024;
+
+  const uint32_t readTimeoutMs_;
 
-  std::unique_ptr<consensus::ReplicatedLog> log_;
   std::unique_ptr<MemKvStore> kv_;
+
+  ChangeBuffer changes_;
+
+  // null if writes are not coalesced.
+  std::unique_ptr<WriteCoalescer> coalescer_;
+
+  // the log is destroyed first, nothing is applied afterwards.
+  std::unique_ptr<consensus::ReplicatedLog> log_;
+};
+
+// The first segment of `path`, e.g "/a/b" => "a". It's empty for the root.
+static Slice topDirectory(const Slice &p) {
+  Slice path = p;
+  path.TrimSpace();
+  size_t begin = 0;
+  while (begin < path.size() && path[begin] == '/') {
+    begin++;
+  }
+  size_t end = begin;
+  while (end < path.size() && path[end] != '/') {
+    end++;
+  }
+  return Slice(path.data() + begin, end - begin);
+}
+
+// FNV-1a
+static uint64_t hashSlice(const Slice &s) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < s.size(); i++) {
+    h ^= static_cast<unsigned char>(s[i]);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// DB::Impl routes the operations to the partitions. The keyspace is partitioned by
+// the hash of the top-level directory, so a directory and all its descendants, except
+// the root, are in the same partition.
+class DB::Impl {
+ public:
+  Partition *Route(const Slice &path) const {
+    return partitions_[indexOf(path)].get();
+  }
+
+  size_t indexOf(const Slice &path) const {
+    if (partitions_.size() == 1) {
+      return 0;
+    }
+    Slice dir = topDirectory(path);
+    if (dir.empty()) {
+      return 0;
+    }
+    return hashSlice(dir) % partitions_.size();
+  }
+
+  // Every partition has the root directory, whose children are spread over all of
+  // them. The result of each partition is merged, a page of the root is not read in
+  // a consistent state across partitions.
+  Status List(const Slice &path, const ScanOptions &options, bool recursive, bool stale,
+              std::vector<KeyValue> *result, bool *more) {
+    if (partitions_.size() == 1 || !topDirectory(path).empty()) {
+      return Route(path)->List(path, options, recursive, stale, result, more);
+    }
+
+    result->clear();
+    *more = false;
+    for (const auto &p : partitions_) {
+      std::vector<KeyValue> nodes;
+      bool partMore = false;
+      RETURN_NOT_OK(p->List(path, options, recursive, stale, &nodes, &partMore));
+      *more |= partMore;
+      std::move(nodes.begin(), nodes.end(), std::back_inserter(*result));
+    }
+
+    std::sort(result->begin(), result->end(),
+              [](const KeyValue &a, const KeyValue &b) { return a.path < b.path; });
+    if (options.limit > 0 && result->size() > options.limit) {
+      result->resize(options.limit);
+      *more = true;
+    }
+    return Status::OK();
+  }
+
+  // Each partition is read in a consistent state of its own.
+  Status MultiGet(const std::vector<Slice> &paths, bool stale, std::vector<std::string> *values,
+                  std::vector<Status> *statuses) {
+    if (partitions_.size() == 1) {
+      return partitions_[0]->MultiGet(paths, stale, values, statuses);
+    }
+
+    std::vector<std::vector<size_t>> positions(partitions_.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+      positions[indexOf(paths[i])].push_back(i);
+    }
+
+    values->resize(paths.size());
+    statuses->resize(paths.size());
+    for (size_t p = 0; p < partitions_.size(); p++) {
+      if (positions[p].empty()) {
+        continue;
+      }
+
+      std::vector<Slice> partPaths;
+      for (size_t i : positions[p]) {
+        partPaths.push_back(paths[i]);
+      }
+      std::vector<std::string> partValues;
+      std::vector<Status> partStatuses;
+      RETURN_NOT_OK(partitions_[p]->MultiGet(partPaths, stale, &partValues, &partStatuses));
+      for (size_t j = 0; j < positions[p].size(); j++) {
+        (*values)[positions[p][j]] = std::move(partValues[j]);
+        (*statuses)[positions[p][j]] = partStatuses[j];
+      }
+    }
+    return Status::OK();
+  }
+
+  // A batch is atomic only within a partition, so it must not span partitions.
+  StatusWith<Partition *> RouteBatch(const std::vector<WriteOp> &ops) const {
+    if (ops.empty()) {
+      return partitions_[0].get();
+    }
+    size_t index = indexOf(ops[0].path);
+    for (const WriteOp &op : ops) {
+      if (indexOf(op.path) != index) {
+        return FMT_Status(InvalidArgument, "batch spans multiple partitions: {} and {}",
+                          ops[0].path.ToString(), op.path.ToString());
+      }
+    }
+    return partitions_[index].get();
+  }
+
+ private:
+  friend class DB;
+
+  // shared by the replicated logs of all the partitions.
+  std::shared_ptr<consensus::TaskQueue> taskQueue_;
+  std::shared_ptr<consensus::RaftTimer> timer_;
+  std::shared_ptr<consensus::ReadyFlusher> flusher_;
+
+  // the partition i is served by the raft group i.
+  std::vector<std::unique_ptr<Partition>> partitions_;
 };
 
 StatusWith<DB *> DB::Bootstrap(const DBOptions &options) {
@@ -109,45 +660,137 @@ StatusWith<DB *> DB::Bootstrap(const DBOptions &options) {
   using consensus::ReplicatedLog;
   using namespace consensus::wal;
 
-  ReplicatedLogOptions rlogOptions;
-  rlogOptions.id = options.member_id;
-  rlogOptions.heartbeat_interval = 100;
-  rlogOptions.election_timeout = 1000;
-  rlogOptions.initial_cluster = options.initial_cluster;
+  if (options.num_groups == 0) {
+    return Status::Make(Error::InvalidArgument, "DBOptions::num_groups should be positive");
+  }
 
-  WriteAheadLogOptions walOptions;
-  walOptions.log_dir = options.wal_dir;
+  std::unique_ptr<DB::Impl> impl(new DB::Impl);
+  impl->taskQueue_ = std::make_shared<consensus::TaskQueue>();
+  impl->timer_ = std::make_shared<consensus::RaftTimer>();
+  impl->flusher_ = std::make_shared<consensus::ReadyFlusher>();
 
-  WriteAheadLogUPtr wal;
-  yaraft::MemStoreUptr memstore;
-  consensus::Status s = WriteAheadLog::Default(walOptions, &wal, &memstore);
-  if (!s.IsOK()) {
-    return Status::Make(Error::ConsensusError, s.ToString()) << " [WriteAheadLog::Default]";
+  if (options.num_groups > 1) {
+    consensus::Status s = consensus::Env::Default()->CreateDirIfMissing(options.wal_dir);
+    if (!s.IsOK()) {
+      return Status::Make(Error::ConsensusError, s.ToString()) << " [CreateDirIfMissing]";
+    }
   }
-  rlogOptions.wal = wal.release();
-  rlogOptions.memstore = memstore.release();
 
-  consensus::StatusWith<ReplicatedLog *> sw = ReplicatedLog::New(rlogOptions);
-  if (!sw.IsOK()) {
-    return Status::Make(Error::ConsensusError, sw.ToString()) << " [ReplicatedLog::New]";
+  std::vector<uint64_t> members;
+  for (const auto &e : options.initial_cluster) {
+    members.push_back(e.first);
+  }
+
+  for (uint32_t g = 0; g < options.num_groups; g++) {
+    ReplicatedLogOptions rlogOptions;
+    rlogOptions.id = options.member_id;
+    rlogOptions.group_id = g;
+    rlogOptions.heartbeat_interval = 100;
+    rlogOptions.election_timeout = 1000;
+    rlogOptions.initial_cluster = options.initial_cluster;
+    rlogOptions.lease_read = options.lease_read;
+    rlogOptions.lease_clock_drift = 200;
+    rlogOptions.snapshot_threshold = options.snapshot_threshold;
+    rlogOptions.trace_sample_every = options.trace_sample_every;
+    rlogOptions.taskQueue = impl->taskQueue_;
+    rlogOptions.timer = impl->timer_;
+    rlogOptions.flusher = impl->flusher_;
+
+    // the leaders are spread over the members in a round-robin way.
+    rlogOptions.campaign_on_start = options.num_groups > 1 && !members.empty() &&
+                                    members[g % members.size()] == options.member_id;
+
+    WriteAheadLogOptions walOptions;
+    walOptions.log_dir = options.num_groups == 1 ? options.wal_dir
+                                                 : fmt::format("{}/{}", options.wal_dir, g);
+
+    WriteAheadLogUPtr wal;
+    yaraft::MemStoreUptr memstore;
+    consensus::Status s = WriteAheadLog::Default(walOptions, &wal, &memstore);
+    if (!s.IsOK()) {
+      return Status::Make(Error::ConsensusError, s.ToString()) << " [WriteAheadLog::Default]";
+    }
+    rlogOptions.wal = wal.release();
+    rlogOptions.memstore = memstore.release();
+
+    std::unique_ptr<Partition> partition(new Partition(options));
+    rlogOptions.state_machine = partition.get();
+
+    consensus::StatusWith<ReplicatedLog *> sw = ReplicatedLog::New(rlogOptions);
+    if (!sw.IsOK()) {
+      return Status::Make(Error::ConsensusError, sw.ToString()) << " [ReplicatedLog::New]";
+    }
+
+    partition->SetLog(sw.GetValue());
+    impl->partitions_.push_back(std::move(partition));
   }
 
-  ReplicatedLog *rlog = sw.GetValue();
   auto db = new DB();
-  db->impl_.reset(new DB::Impl(rlog));
+  db->impl_ = std::move(impl);
   return db;
 }
 
 Status DB::Get(const Slice &path, bool stale, std::string *data) {
-  return impl_->Get(path, stale, data);
+  return impl_->Route(path)->Get(path, stale, data);
+}
+
+Status DB::List(const Slice &path, const ScanOptions &options, bool stale,
+                std::vector<KeyValue> *result, bool *more) {
+  return impl_->List(path, options, false, stale, result, more);
+}
+
+Status DB::Scan(const Slice &path, const ScanOptions &options, bool stale,
+                std::vector<KeyValue> *result, bool *more) {
+  return impl_->List(path, options, true, stale, result, more);
+}
+
+Status DB::MultiGet(const std::vector<Slice> &paths, bool stale, std::vector<std::string> *values,
+                    std::vector<Status> *statuses) {
+  return impl_->MultiGet(paths, stale, values, statuses);
+}
+
+Status DB::Write(const std::vector<WriteOp> &ops) {
+  Partition *partition;
+  ASSIGN_IF_OK(impl_->RouteBatch(ops), partition);
+  return partition->Write(ops);
+}
+
+void DB::AsyncWrite(const Slice &path, const Slice &value, Callback callback) {
+  impl_->Route(path)->AsyncWrite(path, value, callback);
+}
+
+void DB::AsyncDelete(const Slice &path, Callback callback) {
+  impl_->Route(path)->AsyncDelete(path, callback);
+}
+
+void DB::AsyncWrite(const std::vector<WriteOp> &ops, Callback callback) {
+  StatusWith<Partition *> sw = impl_->RouteBatch(ops);
+  if (!sw.IsOK()) {
+    callback(sw.GetStatus());
+    return;
+  }
+  sw.GetValue()->AsyncWrite(ops, callback);
+}
+
+StatusWith<uint64_t> DB::Watch(const Slice &path, uint64_t from_index,
+                               std::shared_ptr<Watcher> watcher) {
+  if (impl_->partitions_.size() > 1 && topDirectory(path).empty()) {
+    return Status::Make(Error::InvalidArgument,
+                        "the root cannot be watched when there're multiple partitions");
+  }
+  return impl_->Route(path)->Watch(path, from_index, std::move(watcher));
+}
+
+void DB::Unwatch(const Slice &path, uint64_t id) {
+  impl_->Route(path)->Unwatch(id);
 }
 
 Status DB::Delete(const Slice &path) {
-  return impl_->Delete(path);
+  return impl_->Route(path)->Delete(path);
 }
 
 Status DB::Write(const Slice &path, const Slice &value) {
-  return impl_->Write(path, value);
+  return impl_->Route(path)->Write(path, value);
 }
 
 DB::DB() {}
@@ -155,7 +798,11 @@ DB::DB() {}
 DB::~DB() = default;
 
 consensus::pb::RaftService *DB::CreateRaftServiceInstance() const {
-  return new consensus::RaftServiceImpl(impl_->log_->RaftTaskExecutorInstance());
+  auto service = new consensus::RaftServiceImpl();
+  for (const auto &p : impl_->partitions_) {
+    service->AddGroup(p->Log());
+  }
+  return service;
 }
 
-}  // namespace memkv
\ No newline at end of file
+}  // namespace memkv
@@ -14,8 +14,11 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 
+#include "change_buffer.h"
+#include "memkv_store.h"
 #include "slice.h"
 #include "status.h"
 
@@ -25,19 +28,38 @@
 
 namespace memkv {
 
-// Abstract handle to particular state of a DB.
-// A Snapshot is an immutable object and can therefore be safely
-// accessed from multiple threads without any external synchronization.
-class Snapshot {
- protected:
-  virtual ~Snapshot();
-};
-
 class DBOptions {
  public:
   uint64_t member_id;
   std::string wal_dir;
   std::map<uint64_t, std::string> initial_cluster;
+
+  // see consensus::ReplicatedLogOptions::lease_read.
+  bool lease_read = false;
+
+  // time (in milliseconds) a linearizable read waits for the store to apply the read
+  // index, after which it fails with Unavailable.
+  uint32_t read_timeout_ms = 5000;
+
+  // see consensus::ReplicatedLogOptions::snapshot_threshold. 0 disables snapshots.
+  uint64_t snapshot_threshold = 0;
+
+  // number of raft groups the keyspace is partitioned into, every node is a member
+  // of all the groups. The wal of group i is stored in `wal_dir`/i if there're
+  // more than one.
+  uint32_t num_groups = 1;
+
+  // the number of the latest changes kept in memory for the watchers of each
+  // partition, see ChangeBuffer.
+  size_t watch_buffer_size = 10000;
+
+  // whether the writes waiting for the proposal in flight are merged, so that only
+  // the last value of a path is replicated, see WriteCoalescer. The callers are
+  // acknowledged once the merged batch is applied.
+  bool coalesce_writes = false;
+
+  // see consensus::ReplicatedLogOptions::trace_sample_every.
+  uint32_t trace_sample_every = 0;
 };
 
 class DB {
@@ -48,8 +70,48 @@ class DB {
 
   Status Delete(const Slice &path);
 
+  // Applies `ops` atomically. Nothing is applied if any of them is invalid, or they
+  // belong to different partitions.
+  Status Write(const std::vector<WriteOp> &ops);
+
+  typedef std::function<void(const Status &)> Callback;
+
+  // Asynchronous versions of the writes, which return immediately. `callback` is
+  // invoked with the result once the write completes, on an internal thread of the
+  // replicated log, so it must not block.
+  void AsyncWrite(const Slice &path, const Slice &value, Callback callback);
+
+  void AsyncDelete(const Slice &path, Callback callback);
+
+  void AsyncWrite(const std::vector<WriteOp> &ops, Callback callback);
+
   Status Get(const Slice &path, bool stale, std::string *data);
 
+  // Reads `paths` in a consistent state, the result of each path is returned in
+  // `values` and `statuses`, while the returned status reports errors of the whole
+  // read.
+  Status MultiGet(const std::vector<Slice> &paths, bool stale, std::vector<std::string> *values,
+                  std::vector<Status> *statuses);
+
+  // See MemKvStore::List and MemKvStore::Scan. `options.snapshot` is ignored, each
+  // call reads in a snapshot of its own.
+  Status List(const Slice &path, const ScanOptions &options, bool stale,
+              std::vector<KeyValue> *result, bool *more);
+
+  Status Scan(const Slice &path, const ScanOptions &options, bool stale,
+              std::vector<KeyValue> *result, bool *more);
+
+  // Pushes the changes under `path` to `watcher`, starting from the raft index
+  // `from_index` of the partition that `path` belongs to, 0 means from the next
+  // change. The changes are pushed once they're applied to the local store, so a
+  // follower pushes them later than the leader.
+  // The root can't be watched if there're multiple partitions.
+  // See ChangeBuffer::Watch.
+  StatusWith<uint64_t> Watch(const Slice &path, uint64_t from_index,
+                             std::shared_ptr<Watcher> watcher);
+
+  void Unwatch(const Slice &path, uint64_t id);
+
   consensus::pb::RaftService *CreateRaftServiceInstance() const;
 
   DB();
@@ -0,0 +1,170 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "epoch.h"
+#include "logging.h"
+
+namespace memkv {
+
+namespace {
+
+const size_t kMaxReaders = 1024;
+
+// The number of retired objects that triggers a reclamation.
+const size_t kReclaimThreshold = 128;
+
+const uint64_t kIdle = std::numeric_limits<uint64_t>::max();
+
+// Each reader thread owns a slot, publishing the epoch it entered, or kIdle.
+// Slots are padded to cache lines so that readers don't contend on them.
+struct alignas(64) Slot {
+  std::atomic<uint64_t> epoch{kIdle};
+  std::atomic<bool> used{false};
+};
+
+Slot gSlots[kMaxReaders];
+
+// the number of slots that have ever been used.
+std::atomic<size_t> gSlotsInUse{0};
+
+std::atomic<uint64_t> gEpoch{1};
+
+struct Retired {
+  uint64_t epoch;
+  std::function<void()> deleter;
+};
+
+std::mutex gRetiredMu;
+std::vector<Retired> gRetired;
+
+struct ThreadSlot {
+  Slot *slot = nullptr;
+  int depth = 0;
+
+  ~ThreadSlot() {
+    if (slot) {
+      slot->epoch.store(kIdle);
+      slot->used.store(false);
+    }
+  }
+
+  Slot *Get() {
+    if (slot) {
+      return slot;
+    }
+    for (size_t i = 0; i < kMaxReaders; i++) {
+      bool expected = false;
+      if (gSlots[i].used.compare_exchange_strong(expected, true)) {
+        slot = &gSlots[i];
+
+        size_t inUse = gSlotsInUse.load();
+        while (inUse < i + 1 && !gSlotsInUse.compare_exchange_weak(inUse, i + 1)) {
+        }
+        return slot;
+      }
+    }
+    LOG(FATAL) << "Epoch: too many reader threads, at most " << kMaxReaders;
+    return nullptr;
+  }
+};
+
+thread_local ThreadSlot tThreadSlot;
+
+// The minimum epoch that active readers have entered.
+uint64_t minActiveEpoch() {
+  uint64_t min = kIdle;
+  size_t n = gSlotsInUse.load();
+  for (size_t i = 0; i < n; i++) {
+    min = std::min(min, gSlots[i].epoch.load());
+  }
+  return min;
+}
+
+// Takes the objects retired before `epoch` out of the list.
+// REQUIRES: gRetiredMu held
+std::vector<Retired> collectRetired(uint64_t epoch) {
+  std::vector<Retired> result;
+  auto it = gRetired.begin();
+  while (it != gRetired.end()) {
+    if (it->epoch < epoch) {
+      result.push_back(std::move(*it));
+      *it = std::move(gRetired.back());
+      gRetired.pop_back();
+    } else {
+      it++;
+    }
+  }
+  return result;
+}
+
+// The deleters run without the lock held, they may retire other objects.
+void runDeleters(std::vector<Retired> *freed) {
+  for (auto &r : *freed) {
+    r.deleter();
+  }
+}
+
+}  // namespace
+
+Epoch::Guard::Guard() {
+  if (tThreadSlot.depth++ == 0) {
+    tThreadSlot.Get()->epoch.store(gEpoch.load());
+  }
+}
+
+Epoch::Guard::~Guard() {
+  if (--tThreadSlot.depth == 0) {
+    tThreadSlot.slot->epoch.store(kIdle);
+  }
+}
+
+void Epoch::Retire(std::function<void()> deleter) {
+  std::vector<Retired> freed;
+  {
+    std::lock_guard<std::mutex> g(gRetiredMu);
+    gRetired.push_back(Retired{gEpoch.load(), std::move(deleter)});
+    if (gRetired.size() < kReclaimThreshold) {
+      return;
+    }
+
+    // readers entering from now on can't reach the objects retired so far.
+    gEpoch.fetch_add(1);
+    freed = collectRetired(minActiveEpoch());
+  }
+  runDeleters(&freed);
+}
+
+void Epoch::Synchronize() {
+  DCHECK_EQ(tThreadSlot.depth, 0);
+
+  uint64_t epoch = gEpoch.fetch_add(1) + 1;
+  while (minActiveEpoch() < epoch) {
+    std::this_thread::yield();
+  }
+
+  std::vector<Retired> freed;
+  {
+    std::lock_guard<std::mutex> g(gRetiredMu);
+    freed = collectRetired(epoch);
+  }
+  runDeleters(&freed);
+}
+
+}  // namespace memkv
@@ -0,0 +1,55 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <functional>
+
+#include <silly/disallow_copying.h>
+
+namespace memkv {
+
+// Epoch-based reclamation of the objects shared with lock-free readers.
+//
+// A reader accesses the shared objects only within the scope of an Epoch::Guard.
+// A writer that has unlinked an object, so that no new reader can reach it, retires
+// the object instead of freeing it. The object is freed once every reader that was
+// active at the time of retirement has left its guard.
+//
+// The epochs are process-wide, so are the readers: a guard protects the objects of
+// every store.
+class Epoch {
+ public:
+  // Guard marks the current thread as a reader during its lifetime.
+  // Guards can be nested. A guard must be released on the thread that created it.
+  class Guard {
+    __DISALLOW_COPYING__(Guard);
+
+   public:
+    Guard();
+
+    ~Guard();
+  };
+
+  // Defers `deleter` until no reader may still access the retired object.
+  // Thread-Safe
+  static void Retire(std::function<void()> deleter);
+
+  // Waits until all the readers active at the time of call have left, and runs
+  // the deleters retired before the call.
+  // REQUIRES: the calling thread holds no guard.
+  static void Synchronize();
+};
+
+}  // namespace memkv
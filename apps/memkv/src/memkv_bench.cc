@@ -0,0 +1,287 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// memkv_bench drives a memkv cluster with a mix of reads and writes from concurrent
+// clients, and reports the throughput and the latency percentiles.
+//
+// Against the onebox started by `run.sh start_onebox`:
+//   ./memkv_bench --threads=32 --read_ratio=0.9 --distribution=zipfian
+// Against a 3-node cluster in the process itself:
+//   ./memkv_bench --in_process --wal_dir=/tmp/memkv_bench
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "db.h"
+#include "logging.h"
+#include "memkv_service.h"
+
+#include <boost/algorithm/string/split.hpp>
+#include <brpc/channel.h>
+#include <consensus/base/env.h>
+#include <consensus/base/random.h>
+
+using namespace memkv;
+
+DEFINE_string(servers, "127.0.0.1:12321,127.0.0.1:12322,127.0.0.1:12323",
+              "comma-separated addresses of the memkv servers");
+DEFINE_bool(in_process, false, "start a cluster of --servers in this process");
+DEFINE_string(wal_dir, "/tmp/memkv_bench", "directory of the wal of the in-process cluster");
+DEFINE_int32(threads, 16, "number of concurrent clients");
+DEFINE_int32(duration, 10, "seconds to run");
+DEFINE_int32(num_keys, 100000, "number of distinct keys");
+DEFINE_string(distribution, "uniform", "distribution of the keys: uniform or zipfian");
+DEFINE_double(zipfian_theta, 0.99, "skewness of the zipfian distribution");
+DEFINE_int32(value_size, 100, "bytes of each written value");
+DEFINE_double(read_ratio, 0.5, "fraction of the operations that are reads");
+DEFINE_bool(stale, false, "whether reads are allowed to be stale");
+DEFINE_int32(timeout_ms, 1000, "timeout of each request");
+
+// Generates the indexes in [0, n) following the zipfian distribution, the smaller the
+// index the more frequent. See "Quickly Generating Billion-Record Synthetic
+// Databases", Jim Gray et al, SIGMOD 1994.
+class ZipfianGenerator {
+ public:
+  ZipfianGenerator(uint32_t n, double theta) : n_(n), theta_(theta) {
+    zetan_ = zeta(n, theta);
+    double zeta2 = zeta(2, theta);
+    alpha_ = 1.0 / (1.0 - theta);
+    eta_ = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan_);
+  }
+
+  // `u` is uniformly distributed in [0, 1).
+  uint32_t Next(double u) const {
+    double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, theta_)) {
+      return 1;
+    }
+    auto i = static_cast<uint32_t>(n_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+    return std::min(i, n_ - 1);
+  }
+
+ private:
+  static double zeta(uint32_t n, double theta) {
+    double sum = 0;
+    for (uint32_t i = 1; i <= n; i++) {
+      sum += 1.0 / std::pow(i, theta);
+    }
+    return sum;
+  }
+
+ private:
+  uint32_t n_;
+  double theta_;
+  double zetan_;
+  double alpha_;
+  double eta_;
+};
+
+// The keys are spread over the top-level directories, so that they're spread over
+// the partitions as well.
+static std::string keyOf(uint32_t i) {
+  return fmt::format("/bench{}/key{}", i % 256, i);
+}
+
+struct OpStats {
+  uint64_t errors = 0;
+
+  // in microseconds
+  std::vector<uint32_t> latencies;
+
+  void Merge(const OpStats &other) {
+    errors += other.errors;
+    latencies.insert(latencies.end(), other.latencies.begin(), other.latencies.end());
+  }
+
+  void Report(const char *name, double seconds) {
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [this](double p) -> uint32_t {
+      if (latencies.empty()) {
+        return 0;
+      }
+      return latencies[std::min(latencies.size() - 1, static_cast<size_t>(latencies.size() * p))];
+    };
+    fmt::print("{:<6} ops: {:<10} errors: {:<8} qps: {:<10.0f} latency(us) p50: {} p99: {} "
+               "p999: {} max: {}\n",
+               name, latencies.size(), errors, latencies.size() / seconds, percentile(0.5),
+               percentile(0.99), percentile(0.999), latencies.empty() ? 0 : latencies.back());
+  }
+};
+
+class Client {
+ public:
+  explicit Client(const std::vector<std::unique_ptr<brpc::Channel>> *channels)
+      : channels_(channels) {}
+
+  // Writes are sent to the leader, which is found by trying the servers in turn.
+  bool Write(const std::string &path, const std::string &value) {
+    pb::WriteRequest request;
+    request.set_path(path);
+    request.set_value(value);
+    for (size_t i = 0; i < channels_->size(); i++) {
+      size_t leader = leader_.load();
+      pb::MemKVService_Stub stub((*channels_)[leader].get());
+      pb::WriteResult result;
+      brpc::Controller cntl;
+      stub.Write(&cntl, &request, &result, nullptr);
+      if (!cntl.Failed() && result.errorcode() == pb::OK) {
+        return true;
+      }
+      leader_.compare_exchange_strong(leader, (leader + 1) % channels_->size());
+    }
+    return false;
+  }
+
+  // Reads are served by every server.
+  bool Read(const std::string &path) {
+    pb::ReadRequest request;
+    request.set_path(path);
+    request.set_stale(FLAGS_stale);
+    pb::MemKVService_Stub stub((*channels_)[next_++ % channels_->size()].get());
+    pb::ReadResult result;
+    brpc::Controller cntl;
+    stub.Read(&cntl, &request, &result, nullptr);
+    return !cntl.Failed() &&
+           (result.errorcode() == pb::OK || result.errorcode() == pb::NodeNotExist);
+  }
+
+ private:
+  const std::vector<std::unique_ptr<brpc::Channel>> *channels_;
+  size_t next_ = 0;
+
+  // shared by all clients
+  static std::atomic<size_t> leader_;
+};
+
+std::atomic<size_t> Client::leader_{0};
+
+static void startInProcessCluster(const std::vector<std::string> &servers) {
+  DBOptions options;
+  for (size_t i = 0; i < servers.size(); i++) {
+    options.initial_cluster[i + 1] = servers[i];
+  }
+
+  // the cluster lives until the process exits.
+  for (size_t i = 0; i < servers.size(); i++) {
+    options.member_id = i + 1;
+    options.wal_dir = fmt::format("{}/server{}", FLAGS_wal_dir, i + 1);
+    auto sw = DB::Bootstrap(options);
+    if (!sw.IsOK()) {
+      LOG(FATAL) << sw.GetStatus();
+    }
+    DB *db = sw.GetValue();
+
+    auto server = new brpc::Server;
+    server->AddService(new MemKVServiceImpl(db), brpc::SERVER_OWNS_SERVICE);
+    server->AddService(db->CreateRaftServiceInstance(), brpc::SERVER_OWNS_SERVICE);
+    if (server->Start(servers[i].c_str(), nullptr) != 0) {
+      LOG(FATAL) << "failed to start server at " << servers[i];
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::vector<std::string> servers;
+  boost::split(servers, FLAGS_servers, [](char c) { return c == ','; });
+  if (FLAGS_in_process) {
+    FATAL_NOT_OK(consensus::Env::Default()->CreateDirIfMissing(FLAGS_wal_dir), FLAGS_wal_dir);
+    startInProcessCluster(servers);
+  }
+
+  std::vector<std::unique_ptr<brpc::Channel>> channels;
+  for (const std::string &server : servers) {
+    brpc::ChannelOptions options;
+    options.timeout_ms = FLAGS_timeout_ms;
+    options.max_retry = 0;
+    std::unique_ptr<brpc::Channel> channel(new brpc::Channel);
+    if (channel->Init(server.c_str(), &options) != 0) {
+      LOG(FATAL) << "failed to connect to " << server;
+    }
+    channels.push_back(std::move(channel));
+  }
+
+  // waits for a leader to be elected.
+  Client warmup(&channels);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (!warmup.Write(keyOf(0), "")) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      LOG(FATAL) << "no leader is elected in 30s";
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  std::unique_ptr<ZipfianGenerator> zipfian;
+  if (FLAGS_distribution == "zipfian") {
+    zipfian.reset(new ZipfianGenerator(FLAGS_num_keys, FLAGS_zipfian_theta));
+  } else if (FLAGS_distribution != "uniform") {
+    LOG(FATAL) << "unknown distribution: " << FLAGS_distribution;
+  }
+
+  FMT_LOG(INFO, "running {} clients for {}s, read ratio: {}, {} distribution over {} keys",
+          FLAGS_threads, FLAGS_duration, FLAGS_read_ratio, FLAGS_distribution, FLAGS_num_keys);
+
+  std::atomic<bool> stop(false);
+  std::vector<OpStats> readStats(FLAGS_threads), writeStats(FLAGS_threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < FLAGS_threads; t++) {
+    threads.emplace_back([&, t]() {
+      Client client(&channels);
+      consensus::Random rnd(t + 1);
+      std::string value(FLAGS_value_size, 'v');
+
+      while (!stop.load()) {
+        double u = rnd.Next() / 4294967296.0;
+        uint32_t k = zipfian ? zipfian->Next(u) : rnd.Uniform(FLAGS_num_keys);
+        bool isRead = rnd.Next() / 4294967296.0 < FLAGS_read_ratio;
+
+        auto start = std::chrono::steady_clock::now();
+        bool ok = isRead ? client.Read(keyOf(k)) : client.Write(keyOf(k), value);
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        OpStats &stats = isRead ? readStats[t] : writeStats[t];
+        if (ok) {
+          stats.latencies.push_back(static_cast<uint32_t>(elapsed.count()));
+        } else {
+          stats.errors++;
+        }
+      }
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::this_thread::sleep_for(std::chrono::seconds(FLAGS_duration));
+  stop = true;
+  for (auto &t : threads) {
+    t.join();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  OpStats reads, writes;
+  for (int t = 0; t < FLAGS_threads; t++) {
+    reads.Merge(readStats[t]);
+    writes.Merge(writeStats[t]);
+  }
+  reads.Report("read", seconds);
+  writes.Report("write", seconds);
+  return 0;
+}
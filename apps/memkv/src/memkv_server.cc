@@ -19,12 +19,38 @@
 #include <boost/make_unique.hpp>
 #include <consensus/base/env.h>
 #include <consensus/base/glog_logger.h>
+#include <consensus/base/profiler.h>
 
 using namespace memkv;
 
 DEFINE_uint64(id, 1, "one of the values in {1, 2, 3}");
 DEFINE_string(wal_dir, "", "directory to store wal");
 DEFINE_int32(server_count, 3, "number of servers in the cluster");
+DEFINE_bool(lease_read, false, "serve linearizable reads by the leader lease");
+DEFINE_int32(num_groups, 1, "number of raft groups the keyspace is partitioned into");
+DEFINE_uint64(snapshot_threshold, 0,
+              "number of applied entries between two snapshots of the store, after which the "
+              "raft log is compacted. 0 disables snapshots");
+DEFINE_bool(coalesce_writes, false,
+            "merge the pending writes to the same path, so that only the last one is replicated");
+DEFINE_int32(trace_sample_every, 0,
+             "trace one in every N writes through the consensus pipeline, the latencies of "
+             "each stage are shown in /vars. 0 disables tracing");
+DEFINE_int32(num_threads, 0,
+             "number of threads serving requests, 0 means the default of brpc, "
+             "which is the number of cores");
+DEFINE_string(profile_dir, "",
+              "directory the continuous profiles are written to, required by --cpu_profile, "
+              "--heap_profile and --contention_profile. The on-demand profiles are served "
+              "by /hotspots regardless");
+DEFINE_bool(cpu_profile, false, "collect cpu profiles periodically, requires WITH_GPERFTOOLS");
+DEFINE_bool(heap_profile, false,
+            "dump the sampled heap periodically, requires WITH_GPERFTOOLS and "
+            "TCMALLOC_SAMPLE_PARAMETER set in the environment");
+DEFINE_bool(contention_profile, false, "collect the contention of the mutexes periodically");
+DEFINE_int32(profile_seconds, 30, "time covered by a cpu or contention profile");
+DEFINE_int32(profile_interval_seconds, 600, "time between two rounds of profiling");
+DEFINE_int32(max_profiles, 24, "number of profiles of each kind kept in --profile_dir");
 DEFINE_string(memkv_log_dir, "",
               "If specified, logfiles are written into this directory instead "
               "of the default logging directory.");
@@ -41,6 +67,28 @@ void InitLogging(const char* argv0) {
   yaraft::SetLogger(boost::make_unique<consensus::GLogLogger>());
 }
 
+// Returns nullptr if no continuous profiling is enabled.
+std::unique_ptr<consensus::ContinuousProfiler> StartProfiler() {
+  if (!FLAGS_cpu_profile && !FLAGS_heap_profile && !FLAGS_contention_profile) {
+    return nullptr;
+  }
+
+  consensus::ProfilerOptions options;
+  options.profile_dir = FLAGS_profile_dir;
+  options.cpu_profile = FLAGS_cpu_profile;
+  options.heap_profile = FLAGS_heap_profile;
+  options.contention_profile = FLAGS_contention_profile;
+  options.profile_duration = FLAGS_profile_seconds * 1000;
+  options.profile_interval = FLAGS_profile_interval_seconds * 1000;
+  options.max_profiles = FLAGS_max_profiles;
+  auto sw = consensus::ContinuousProfiler::New(options);
+  if (!sw.IsOK()) {
+    LOG(FATAL) << sw.GetStatus();
+  }
+  FMT_LOG(INFO, "--profile_dir: {}", FLAGS_profile_dir);
+  return std::unique_ptr<consensus::ContinuousProfiler>(sw.GetValue());
+}
+
 int main(int argc, char* argv[]) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
   InitLogging(argv[0]);
@@ -51,6 +99,11 @@ int main(int argc, char* argv[]) {
   DBOptions options;
   options.member_id = FLAGS_id;
   options.wal_dir = FLAGS_wal_dir;
+  options.lease_read = FLAGS_lease_read;
+  options.num_groups = FLAGS_num_groups;
+  options.snapshot_threshold = FLAGS_snapshot_threshold;
+  options.coalesce_writes = FLAGS_coalesce_writes;
+  options.trace_sample_every = FLAGS_trace_sample_every;
   for (int i = 1; i <= FLAGS_server_count; i++) {
     // TODO: initial_cluster should be configured by user
     options.initial_cluster[i] = fmt::format("127.0.0.1:{}", 12320 + i);
@@ -67,11 +120,15 @@ int main(int argc, char* argv[]) {
   FMT_LOG(INFO, "Starting memkv server {} at {}", FLAGS_id, options.initial_cluster[FLAGS_id]);
   FMT_LOG(INFO, "--wal_dir: {}", FLAGS_wal_dir);
   brpc::ServerOptions opts;
-  opts.num_threads = 1;
+  if (FLAGS_num_threads > 0) {
+    opts.num_threads = FLAGS_num_threads;
+  }
   brpc::Server server;
   server.AddService(new MemKVServiceImpl(db), brpc::SERVER_OWNS_SERVICE);
   server.AddService(db->CreateRaftServiceInstance(), brpc::SERVER_OWNS_SERVICE);
   server.Start(options.initial_cluster[FLAGS_id].c_str(), &opts);
+
+  auto profiler = StartProfiler();
   server.RunUntilAskedToQuit();
 
   return 0;
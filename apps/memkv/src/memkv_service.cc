@@ -15,6 +15,9 @@
 #include "memkv_service.h"
 #include "logging.h"
 
+#include <brpc/closure_guard.h>
+#include <brpc/stream.h>
+
 namespace memkv {
 
 static inline pb::ErrCode memkvErrorToRpcErrno(Error::ErrorCodes code) {
@@ -27,12 +30,29 @@ static inline pb::ErrCode memkvErrorToRpcErrno(Error::ErrorCodes code) {
       return pb::NodeNotExist;
     case Error::ConsensusError:
       return pb::ConsensusError;
+    case Error::VersionCompacted:
+      return pb::VersionCompacted;
+    case Error::Unavailable:
+      return pb::Unavailable;
     default:
       LOG(FATAL) << "Unexpected error code: " << Error::toString(code);
       return pb::OK;
   }
 }
 
+// Returns a callback that completes the asynchronous call with the result of the
+// write. The response is sent by the thread that runs the callback.
+template <typename Result>
+static DB::Callback completeWith(Result *response, ::google::protobuf::Closure *done) {
+  return [response, done](const Status &s) {
+    response->set_errorcode(memkvErrorToRpcErrno(s.Code()));
+    if (!s.IsOK()) {
+      response->set_errormessage(s.ToString());
+    }
+    done->Run();
+  };
+}
+
 // write request via http goes like this:
 //  http 'URL:PORT/Write/abc/a?value=hello'
 // if ok, path "/abc/a" will be set to "hello"
@@ -41,20 +61,13 @@ void MemKVServiceImpl::Write(::google::protobuf::RpcController *controller,
                              ::memkv::pb::WriteResult *response,
                              ::google::protobuf::Closure *done) {
   auto cntl = static_cast<brpc::Controller *>(controller);
-  Status s;
   if (cntl->has_http_request()) {
     Slice path(cntl->http_request().unresolved_path());
-    Slice value(*cntl->http_request().uri().GetQuery("value"));
-    s = db_->Write(path, value);
+    const std::string *value = cntl->http_request().uri().GetQuery("value");
+    db_->AsyncWrite(path, value ? Slice(*value) : Slice(), completeWith(response, done));
   } else {
-    s = db_->Write(request->path(), request->value());
-  }
-
-  response->set_errorcode(memkvErrorToRpcErrno(s.Code()));
-  if (!s.IsOK()) {
-    response->set_errormessage(s.ToString());
+    db_->AsyncWrite(request->path(), request->value(), completeWith(response, done));
   }
-  done->Run();
 }
 
 void MemKVServiceImpl::Read(::google::protobuf::RpcController *controller,
@@ -89,10 +102,171 @@ void MemKVServiceImpl::Read(::google::protobuf::RpcController *controller,
 void MemKVServiceImpl::Delete(::google::protobuf::RpcController *controller,
                               const ::memkv::pb::DeleteRequest *request,
                               ::memkv::pb::DeleteResult *response,
-                              ::google::protobuf::Closure *done) {}
+                              ::google::protobuf::Closure *done) {
+  auto cntl = static_cast<brpc::Controller *>(controller);
+  if (cntl->has_http_request()) {
+    Slice path(cntl->http_request().unresolved_path());
+    db_->AsyncDelete(path, completeWith(response, done));
+  } else {
+    db_->AsyncDelete(request->path(), completeWith(response, done));
+  }
+}
+
+void MemKVServiceImpl::BatchWrite(::google::protobuf::RpcController *controller,
+                                  const ::memkv::pb::BatchWriteRequest *request,
+                                  ::memkv::pb::BatchWriteResult *response,
+                                  ::google::protobuf::Closure *done) {
+  std::vector<WriteOp> ops(request->ops_size());
+  for (int i = 0; i < request->ops_size(); i++) {
+    const pb::WriteOp &op = request->ops(i);
+    ops[i].type = op.type() == pb::WriteOp::DELETE ? WriteOp::kDelete : WriteOp::kWrite;
+    ops[i].path = op.path();
+    ops[i].value = op.value();
+  }
+  db_->AsyncWrite(ops, completeWith(response, done));
+}
+
+void MemKVServiceImpl::MultiGet(::google::protobuf::RpcController *controller,
+                                const ::memkv::pb::MultiGetRequest *request,
+                                ::memkv::pb::MultiGetResult *response,
+                                ::google::protobuf::Closure *done) {
+  std::vector<Slice> paths(request->paths().begin(), request->paths().end());
+  std::vector<std::string> values;
+  std::vector<Status> statuses;
+  Status s = db_->MultiGet(paths, request->stale(), &values, &statuses);
+
+  response->set_errorcode(memkvErrorToRpcErrno(s.Code()));
+  if (!s.IsOK()) {
+    response->set_errormessage(s.ToString());
+    done->Run();
+    return;
+  }
+  for (size_t i = 0; i < paths.size(); i++) {
+    pb::ReadResult *result = response->add_results();
+    result->set_errorcode(memkvErrorToRpcErrno(statuses[i].Code()));
+    if (statuses[i].IsOK()) {
+      result->mutable_value()->swap(values[i]);
+    } else {
+      result->set_errormessage(statuses[i].ToString());
+    }
+  }
+  done->Run();
+}
+
+// list request via http goes like this:
+//  http 'URL:PORT/List/abc?start_after=/abc/a&limit=100&stale'
+static void listNodes(DB *db, brpc::Controller *cntl, const ::memkv::pb::ListRequest *request,
+                      bool recursive, ::memkv::pb::ListResult *response) {
+  std::string path;
+  ScanOptions options;
+  bool stale;
+  if (cntl->has_http_request()) {
+    const brpc::URI &uri = cntl->http_request().uri();
+    path = cntl->http_request().unresolved_path();
+    if (uri.GetQuery("start_after") != nullptr) {
+      options.start_after = *uri.GetQuery("start_after");
+    }
+    if (uri.GetQuery("limit") != nullptr) {
+      options.limit = strtoul(uri.GetQuery("limit")->c_str(), nullptr, 10);
+    }
+    stale = uri.GetQuery("stale") != nullptr;
+  } else {
+    path = request->path();
+    options.start_after = request->start_after();
+    options.limit = request->limit();
+    stale = request->stale();
+  }
+
+  std::vector<KeyValue> result;
+  bool more = false;
+  Status s = recursive ? db->Scan(path, options, stale, &result, &more)
+                       : db->List(path, options, stale, &result, &more);
+
+  response->set_errorcode(memkvErrorToRpcErrno(s.Code()));
+  if (!s.IsOK()) {
+    response->set_errormessage(s.ToString());
+    return;
+  }
+  for (auto &kv : result) {
+    pb::Node *node = response->add_nodes();
+    node->mutable_path()->swap(kv.path);
+    node->mutable_value()->swap(kv.value);
+  }
+  response->set_more(more);
+}
+
+void MemKVServiceImpl::List(::google::protobuf::RpcController *controller,
+                            const ::memkv::pb::ListRequest *request,
+                            ::memkv::pb::ListResult *response, ::google::protobuf::Closure *done) {
+  auto cntl = static_cast<brpc::Controller *>(controller);
+  listNodes(db_.get(), cntl, request, false, response);
+  done->Run();
+}
+
+void MemKVServiceImpl::Scan(::google::protobuf::RpcController *controller,
+                            const ::memkv::pb::ListRequest *request,
+                            ::memkv::pb::ListResult *response, ::google::protobuf::Closure *done) {
+  auto cntl = static_cast<brpc::Controller *>(controller);
+  listNodes(db_.get(), cntl, request, true, response);
+  done->Run();
+}
 
 MemKVServiceImpl::MemKVServiceImpl(DB *db) : db_(db) {}
 
 MemKVServiceImpl::~MemKVServiceImpl() = default;
 
+// StreamWatcher pushes the changes to a brpc stream. The watch ends once the stream
+// is full, since a change is never dropped silently, or closed by the client, which
+// is found at the next change.
+class StreamWatcher : public Watcher {
+ public:
+  explicit StreamWatcher(brpc::StreamId stream) : stream_(stream) {}
+
+  ~StreamWatcher() override {
+    brpc::StreamClose(stream_);
+  }
+
+  bool OnEvent(const WatchEvent &event) override {
+    pb::WatchEvent e;
+    e.set_type(event.type == WatchEvent::kPut ? pb::WatchEvent::PUT : pb::WatchEvent::DELETE);
+    e.set_index(event.index);
+    e.set_path(event.path);
+    e.set_value(event.value);
+
+    butil::IOBuf buf;
+    butil::IOBufAsZeroCopyOutputStream wrapper(&buf);
+    e.SerializeToZeroCopyStream(&wrapper);
+    return brpc::StreamWrite(stream_, buf) == 0;
+  }
+
+  void OnCancelled(const Status &reason) override {
+    FMT_LOG(INFO, "watch on stream {} is cancelled: {}", stream_, reason.ToString());
+  }
+
+ private:
+  brpc::StreamId stream_;
+};
+
+void MemKVServiceImpl::Watch(::google::protobuf::RpcController *controller,
+                             const ::memkv::pb::WatchRequest *request,
+                             ::memkv::pb::WatchResponse *response,
+                             ::google::protobuf::Closure *done) {
+  brpc::ClosureGuard doneGuard(done);
+  auto cntl = static_cast<brpc::Controller *>(controller);
+
+  brpc::StreamId stream;
+  if (brpc::StreamAccept(&stream, *cntl, nullptr) != 0) {
+    cntl->SetFailed("failed to accept stream");
+    return;
+  }
+
+  // the stream is closed once the watcher is released.
+  auto watcher = std::make_shared<StreamWatcher>(stream);
+  Status s = db_->Watch(request->path(), request->from_index(), watcher).GetStatus();
+  response->set_errorcode(memkvErrorToRpcErrno(s.Code()));
+  if (!s.IsOK()) {
+    response->set_errormessage(s.ToString());
+  }
+}
+
 }  // namespace memkv
\ No newline at end of file
@@ -35,6 +35,25 @@ class MemKVServiceImpl : public pb::MemKVService {
               const ::memkv::pb::DeleteRequest* request, ::memkv::pb::DeleteResult* response,
               ::google::protobuf::Closure* done) override;
 
+  void BatchWrite(::google::protobuf::RpcController* controller,
+                  const ::memkv::pb::BatchWriteRequest* request,
+                  ::memkv::pb::BatchWriteResult* response,
+                  ::google::protobuf::Closure* done) override;
+
+  void MultiGet(::google::protobuf::RpcController* controller,
+                const ::memkv::pb::MultiGetRequest* request, ::memkv::pb::MultiGetResult* response,
+                ::google::protobuf::Closure* done) override;
+
+  void List(::google::protobuf::RpcController* controller, const ::memkv::pb::ListRequest* request,
+            ::memkv::pb::ListResult* response, ::google::protobuf::Closure* done) override;
+
+  void Scan(::google::protobuf::RpcController* controller, const ::memkv::pb::ListRequest* request,
+            ::memkv::pb::ListResult* response, ::google::protobuf::Closure* done) override;
+
+  void Watch(::google::protobuf::RpcController* controller,
+             const ::memkv::pb::WatchRequest* request, ::memkv::pb::WatchResponse* response,
+             ::google::protobuf::Closure* done) override;
+
   explicit MemKVServiceImpl(DB* db);
 
   ~MemKVServiceImpl() override;
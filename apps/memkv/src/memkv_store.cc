@@ -12,13 +12,20 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <mutex>
-#include <unordered_map>
+#include <set>
 
+#include "arena.h"
+#include "epoch.h"
 #include "logging.h"
 #include "memkv_store.h"
+#include "skiplist.h"
 
 #include <boost/algorithm/string/split.hpp>
+#include <consensus/base/coding.h>
 
 namespace boost {
 template <>
@@ -29,140 +36,667 @@ struct range_iterator<memkv::Slice> {
 
 namespace memkv {
 
-struct Node {
-  using ChildrenTable = std::unordered_map<std::string, Node *>;
+static StatusWith<std::vector<Slice>> validatePath(const Slice &p) {
+  Slice path = p;
+  path.TrimSpace();
+  if (UNLIKELY(path.Len() == 0)) {
+    return Status::Make(Error::InvalidArgument, "path is empty");
+  }
+
+  for (size_t i = 0; i < path.size(); i++) {
+    if (path[i] == '\0') {
+      return FMT_Status(InvalidArgument, "path contains NUL at index {}", i);
+    }
+  }
+
+  std::vector<Slice> result;
+  boost::split(result, path, [](char c) { return c == '/'; });
+  return result;
+}
+
+// Joins the non-empty segments of a path with '/', e.g "///a//b" => "a/b".
+// The root directory is the empty key.
+static std::string normalizePath(const std::vector<Slice> &pathVec) {
+  std::string key;
+  for (const Slice &seg : pathVec) {
+    // ignore empty segment
+    if (seg.Len() == 0) {
+      continue;
+    }
+    if (!key.empty()) {
+      key.push_back('/');
+    }
+    key.append(seg.data(), seg.size());
+  }
+  return key;
+}
+
+static bool hasPrefix(const Slice &s, const Slice &prefix) {
+  return s.size() >= prefix.size() && memcmp(s.data(), prefix.data(), prefix.size()) == 0;
+}
+
+// A version of the data of a node, allocated from the arena in a single chunk with
+// the data stored right behind. The versions of a node are chained from the newest
+// to the oldest.
+struct Version {
+  static const uint32_t kTombstone = UINT32_MAX;
+
+  // the sequence number of the write that made this version.
+  uint64_t seq;
+
+  std::atomic<Version *> older;
+
+  // kTombstone if the node is deleted in this version.
+  uint32_t size;
+
+  bool IsTombstone() const {
+    return size == kTombstone;
+  }
+
+  Slice ToSlice() const {
+    return Slice(reinterpret_cast<const char *>(this + 1), size);
+  }
+
+  static size_t SizeOf(uint32_t size) {
+    return sizeof(Version) + (size == kTombstone ? 0 : size);
+  }
+
+  static Version *New(uint64_t seq, const Slice &data, Arena *arena) {
+    auto v = newVersion(seq, static_cast<uint32_t>(data.size()), arena);
+    memcpy(reinterpret_cast<char *>(v + 1), data.data(), data.size());
+    return v;
+  }
+
+  static Version *NewTombstone(uint64_t seq, Arena *arena) {
+    return newVersion(seq, kTombstone, arena);
+  }
+
+  // Frees `v` and the older versions.
+  static void DisposeChain(Version *v, Arena *arena) {
+    while (v != nullptr) {
+      Version *older = v->older.load(std::memory_order_relaxed);
+      arena->Free(reinterpret_cast<char *>(v), SizeOf(v->size));
+      v = older;
+    }
+  }
+
+  // Returns the newest version in the chain of `v` made by writes up to `seq`.
+  static const Version *VisibleAt(const Version *v, uint64_t seq) {
+    while (v != nullptr && v->seq > seq) {
+      v = v->older.load(std::memory_order_acquire);
+    }
+    return v;
+  }
+
+ private:
+  static Version *newVersion(uint64_t seq, uint32_t size, Arena *arena) {
+    auto v = reinterpret_cast<Version *>(arena->Allocate(SizeOf(size)));
+    v->seq = seq;
+    new (&v->older) std::atomic<Version *>(nullptr);
+    v->size = size;
+    return v;
+  }
+};
+
+class SnapshotImpl : public Snapshot {
+ public:
+  explicit SnapshotImpl(uint64_t s) : seq(s) {}
+
+  ~SnapshotImpl() override = default;
+
+  uint64_t Index() const override {
+    return seq;
+  }
+
+  const uint64_t seq;
+};
+
+Snapshot::~Snapshot() = default;
+
+// The number of nodes visited within an Epoch::Guard by a long iteration, so that
+// it doesn't hold back the reclamation of other stores.
+static const int kScanBatchSize = 1024;
+
+// Cursor iterates over the index like SkipList::Iterator, within an Epoch::Guard
+// of its own. The guard is renewed every kScanBatchSize steps, after which the
+// cursor seeks again to the key it stood on.
+class Cursor {
+ public:
+  explicit Cursor(const SkipList<Version> *index)
+      : guard_(new Epoch::Guard), it_(index), steps_(0) {}
 
-  ~Node() {
-    for (auto &child : children) {
-      delete child.second;
+  bool Valid() const {
+    return it_.Valid();
+  }
+
+  SkipList<Version>::Node *node() const {
+    return it_.node();
+  }
+
+  void Seek(const Slice &target) {
+    it_.Seek(target);
+  }
+
+  void Next() {
+    it_.Next();
+    if (++steps_ % kScanBatchSize == 0 && it_.Valid()) {
+      std::string key = it_.node()->Key().ToString();
+      guard_.reset();
+      guard_.reset(new Epoch::Guard);
+      it_.Seek(key);
     }
   }
 
-  ChildrenTable children;
-  std::string data;
+ private:
+  std::unique_ptr<Epoch::Guard> guard_;
+  SkipList<Version>::Iterator it_;
+  int steps_;
 };
 
+// Every node of the tree is indexed by its full path in a skiplist. Since '/' is
+// the separator, the descendants of a node "a/b" are the keys in the range
+// ["a/b/", "a/b0"), which makes a subtree contiguous.
+//
+// Writes are serialized by a mutex, reads never take a lock.
+// Nodes and values are allocated from the arena of the store.
+//
+// Every write is numbered by a sequence, the index of the write, and makes a new
+// version of the node. A snapshot is simply a sequence number, it reads the newest
+// versions up to that number. Versions and deleted nodes are kept only as long as a
+// snapshot may read them, once they're hidden by a newer version from every snapshot
+// and the latest state, they're freed. Hence the oldest snapshot bounds the states
+// that are still readable.
 class MemKvStore::Impl {
  public:
-  Status Write(const Slice &path, const Slice &value) {
-    std::lock_guard<std::mutex> d(mu_);
+  Impl() : index_(&arena_, &Version::DisposeChain), seq_(0) {
+    // the root directory always exists.
+    index_.Insert(Slice())->value.store(Version::New(0, Slice(), &arena_));
+  }
+
+  ~Impl() {
+    // the retired nodes and values must not outlive the store.
+    Epoch::Synchronize();
+  }
 
+  // `index` = 0 means the next of the last write.
+  Status Write(const Slice &path, const Slice &value, uint64_t index) {
     std::vector<Slice> pathVec;
     ASSIGN_IF_OK(validatePath(path), pathVec);
+    std::string key = normalizePath(pathVec);
 
-    Node *n = &root_;
-    for (const Slice &seg : pathVec) {
-      // ignore empty segment
-      if (seg.Len() == 0) {
-        continue;
-      }
+    std::lock_guard<std::mutex> d(writeMu_);
+    write(key, value, nextSeq(index));
+    return Status::OK();
+  }
 
-      auto result = n->children.emplace(std::make_pair(seg.ToString(), nullptr));
-      bool nodeNotExist = result.second;
+  Status Delete(const Slice &path, uint64_t index) {
+    std::string key;
+    RETURN_NOT_OK(deleteKey(path, &key));
 
-      Node **pNode = &result.first->second;
-      if (nodeNotExist) {
-        *pNode = new Node();
-      }
+    std::lock_guard<std::mutex> d(writeMu_);
+    removeSubtree(key, nextSeq(index));
+    return Status::OK();
+  }
 
-      n = *pNode;
+  Status Write(const std::vector<WriteOp> &ops, uint64_t index) {
+    // validates all the operations before applying any of them.
+    std::vector<std::string> keys(ops.size());
+    for (size_t i = 0; i < ops.size(); i++) {
+      if (ops[i].type == WriteOp::kWrite) {
+        std::vector<Slice> pathVec;
+        ASSIGN_IF_OK(validatePath(ops[i].path), pathVec);
+        keys[i] = normalizePath(pathVec);
+      } else {
+        RETURN_NOT_OK(deleteKey(ops[i].path, &keys[i]));
+      }
     }
 
-    n->data = value.ToString();
+    std::lock_guard<std::mutex> d(writeMu_);
+    uint64_t seq = nextSeq(index);
+    for (size_t i = 0; i < ops.size(); i++) {
+      if (ops[i].type == WriteOp::kWrite) {
+        write(keys[i], ops[i].value, seq);
+      } else {
+        removeSubtree(keys[i], seq);
+      }
+    }
     return Status::OK();
   }
 
-  Status Delete(const Slice &path) {
-    std::lock_guard<std::mutex> d(mu_);
+  Status Get(const Slice &path, const Snapshot *snapshot, std::string *data) {
+    std::vector<Slice> pathVec;
+    ASSIGN_IF_OK(validatePath(path), pathVec);
+    std::string key = normalizePath(pathVec);
+
+    Epoch::Guard guard;
+    Node *n = index_.Find(key);
+    const Version *v = n ? visibleVersion(n, snapshot) : nullptr;
+    if (v == nullptr) {
+      return FMT_Status(NodeNotExist, "node does not exist on path {}", path.ToString());
+    }
+    Slice value = v->ToSlice();
+    data->assign(value.data(), value.size());
+    return Status::OK();
+  }
 
+  // Lists the children of `path`, or all the descendants if `recursive`.
+  Status List(const Slice &path, const ScanOptions &options, bool recursive,
+              std::vector<KeyValue> *result, bool *more) {
     std::vector<Slice> pathVec;
     ASSIGN_IF_OK(validatePath(path), pathVec);
+    std::string key = normalizePath(pathVec);
+
+    std::string start;
+    if (!options.start_after.empty()) {
+      ASSIGN_IF_OK(validatePath(options.start_after), pathVec);
+      start = normalizePath(pathVec);
+    }
+
+    result->clear();
+    *more = false;
 
-    Node *n = &root_;
-    for (auto segIt = pathVec.begin(); segIt != pathVec.end(); segIt++) {
-      Slice seg = *segIt;
+    Cursor it(&index_);
+    it.Seek(key);
+    if (!it.Valid() || it.node()->Key().Compare(key) != 0 ||
+        visibleVersion(it.node(), options.snapshot) == nullptr) {
+      return FMT_Status(NodeNotExist, "node does not exist on path {}", path.ToString());
+    }
+
+    std::string prefix = key;
+    if (!prefix.empty()) {
+      prefix.push_back('/');
+    }
 
-      if (seg.Len() == 0) {
-        continue;
+    it.Seek(Slice(start).Compare(prefix) > 0 ? start : prefix);
+    while (it.Valid() && hasPrefix(it.node()->Key(), prefix)) {
+      Slice k = it.node()->Key();
+      if (!recursive) {
+        // skips the subtree of the child, which is ["child/", "child0").
+        auto sep = static_cast<const char *>(
+            memchr(k.data() + prefix.size(), '/', k.size() - prefix.size()));
+        if (sep != nullptr) {
+          std::string next(k.data(), sep);
+          next.push_back('/' + 1);
+          it.Seek(next);
+          continue;
+        }
       }
 
-      auto it = n->children.find(seg.ToString());
-      if (it == n->children.end()) {
-        // the given path is deleted
-        return Status::OK();
+      // the root is excluded from its own descendants.
+      const Version *v = visibleVersion(it.node(), options.snapshot);
+      if (v != nullptr && k.size() > 0 && k.Compare(start) > 0) {
+        if (options.limit > 0 && result->size() == options.limit) {
+          *more = true;
+          break;
+        }
+        result->push_back(KeyValue{"/" + k.ToString(), v->ToSlice().ToString()});
       }
+      it.Next();
+    }
+    return Status::OK();
+  }
+
+  uint64_t AppliedIndex() const {
+    return seq_.load(std::memory_order_relaxed);
+  }
+
+  const Snapshot *GetSnapshot() {
+    std::lock_guard<std::mutex> d(writeMu_);
+    uint64_t seq = seq_.load(std::memory_order_relaxed);
+    snapshots_.insert(seq);
+    return new SnapshotImpl(seq);
+  }
+
+  Status GetSnapshot(uint64_t index, const Snapshot **snapshot) {
+    std::lock_guard<std::mutex> d(writeMu_);
+    uint64_t seq = seq_.load(std::memory_order_relaxed);
+    if (index > seq) {
+      return FMT_Status(InvalidArgument, "index {} is not applied yet, applied index: {}", index,
+                        seq);
+    }
+
+    // every state since the oldest snapshot is readable, or only the latest one
+    // if there's no snapshot.
+    uint64_t oldest = snapshots_.empty() ? seq : *snapshots_.begin();
+    if (index < oldest) {
+      return FMT_Status(VersionCompacted, "versions at index {} are freed, oldest readable: {}",
+                        index, oldest);
+    }
+    snapshots_.insert(index);
+    *snapshot = new SnapshotImpl(index);
+    return Status::OK();
+  }
+
+  void ReleaseSnapshot(const Snapshot *snapshot) {
+    auto snap = static_cast<const SnapshotImpl *>(snapshot);
+
+    std::lock_guard<std::mutex> d(writeMu_);
+    snapshots_.erase(snapshots_.find(snap->seq));
+    delete snap;
 
-      // we have found the matched node, delete it now.
-      if (std::next(segIt) == pathVec.end()) {
-        n->children.erase(it);
-        return Status::OK();
+    // frees the versions that were kept for the snapshot.
+    std::sort(dirty_.begin(), dirty_.end());
+    dirty_.erase(std::unique(dirty_.begin(), dirty_.end()), dirty_.end());
+
+    std::vector<std::string> dirty;
+    dirty.swap(dirty_);
+    for (auto it = dirty.rbegin(); it != dirty.rend(); it++) {
+      Node *n = index_.Find(*it);
+      if (n != nullptr && !collect(n)) {
+        dirty_.push_back(*it);
+      }
+    }
+  }
+
+  Status SerializeSnapshot(const Snapshot *snapshot, std::string *data) {
+    using consensus::PutLengthPrefixedSlice;
+
+    data->clear();
+
+    Cursor it(&index_);
+    for (it.Seek(Slice()); it.Valid(); it.Next()) {
+      const Version *v = visibleVersion(it.node(), snapshot);
+      if (v != nullptr) {
+        PutLengthPrefixedSlice(data, it.node()->Key());
+        PutLengthPrefixedSlice(data, v->ToSlice());
+      }
+    }
+    return Status::OK();
+  }
+
+  Status Restore(Slice data, uint64_t index) {
+    using consensus::GetLengthPrefixedSlice;
+
+    std::vector<std::pair<Slice, Slice>> entries;
+    while (!data.empty()) {
+      Slice key, value;
+      if (!GetLengthPrefixedSlice(&data, &key) || !GetLengthPrefixedSlice(&data, &value)) {
+        return Status::Make(Error::InvalidArgument, "corrupted snapshot data");
       }
+      entries.emplace_back(key, value);
+    }
+
+    std::lock_guard<std::mutex> d(writeMu_);
+    uint64_t seq = nextSeq(index);
 
-      n = it->second;
+    for (const auto &key : liveDescendants(Slice())) {
+      remove(key, seq);
     }
+    write(Slice(), Slice(), seq);
+    for (const auto &e : entries) {
+      write(e.first, e.second, seq);
+    }
+    return Status::OK();
+  }
 
-    return Status::Make(Error::InvalidArgument, "cannot delete root directory");
+  size_t ApproximateMemoryUsage() const {
+    return arena_.MemoryUsage();
   }
 
-  Status Get(const Slice &path, std::string *data) {
-    std::lock_guard<std::mutex> d(mu_);
+ private:
+  typedef SkipList<Version>::Node Node;
 
+  // Returns the key of `path` to be deleted.
+  static Status deleteKey(const Slice &path, std::string *key) {
     std::vector<Slice> pathVec;
     ASSIGN_IF_OK(validatePath(path), pathVec);
+    *key = normalizePath(pathVec);
+    if (key->empty()) {
+      return Status::Make(Error::InvalidArgument, "cannot delete root directory");
+    }
+    return Status::OK();
+  }
+
+  // REQUIRES: writeMu_ held
+  uint64_t nextSeq(uint64_t index) {
+    uint64_t seq = seq_.load(std::memory_order_relaxed);
+    if (index == 0) {
+      index = seq + 1;
+    }
+    DCHECK_GT(index, seq);
+    seq_.store(index, std::memory_order_relaxed);
+    return index;
+  }
+
+  // Returns the version of `n` in the state of `snapshot`, or in the latest state
+  // if `snapshot` is null. Returns nullptr if `n` doesn't exist in that state.
+  static const Version *visibleVersion(const Node *n, const Snapshot *snapshot) {
+    // a node without version is being inserted.
+    const Version *v = n->value.load(std::memory_order_acquire);
+    if (snapshot != nullptr) {
+      v = Version::VisibleAt(v, static_cast<const SnapshotImpl *>(snapshot)->seq);
+    }
+    if (v == nullptr || v->IsTombstone()) {
+      return nullptr;
+    }
+    return v;
+  }
+
+  static bool isLive(const Node *n) {
+    const Version *v = n->value.load(std::memory_order_relaxed);
+    return v != nullptr && !v->IsTombstone();
+  }
+
+  // Returns the keys of the live descendants of `key`, ordered by key.
+  // REQUIRES: writeMu_ held
+  std::vector<std::string> liveDescendants(const Slice &key) {
+    std::string prefix = key.ToString();
+    if (!prefix.empty()) {
+      prefix.push_back('/');
+    }
 
-    Node *n = &root_;
-    for (const Slice &seg : pathVec) {
-      if (seg.Len() == 0) {
-        continue;
+    std::vector<std::string> result;
+    Epoch::Guard guard;
+    SkipList<Version>::Iterator it(&index_);
+    for (it.Seek(prefix); it.Valid() && hasPrefix(it.node()->Key(), prefix); it.Next()) {
+      if (isLive(it.node()) && it.node()->Key().size() > 0) {
+        result.push_back(it.node()->Key().ToString());
       }
+    }
+    // bottom-up
+    std::reverse(result.begin(), result.end());
+    return result;
+  }
 
-      auto it = n->children.find(seg.ToString());
-      if (it == n->children.end()) {
-        return FMT_Status(NodeNotExist, "node does not exist on path {}", path.data());
+  // Writes `value` to `key`, creating the missing ancestors.
+  // REQUIRES: writeMu_ held
+  void write(const Slice &key, const Slice &value, uint64_t seq) {
+    for (size_t i = 0; i < key.size(); i++) {
+      if (key[i] == '/') {
+        Node *n = index_.Insert(Slice(key.data(), i));
+        if (!isLive(n)) {
+          addVersion(n, Version::New(seq, Slice(), &arena_));
+        }
       }
+    }
+    addVersion(index_.Insert(key), Version::New(seq, value, &arena_));
+  }
 
-      n = it->second;
+  // REQUIRES: writeMu_ held
+  void removeSubtree(const Slice &key, uint64_t seq) {
+    Node *n = index_.Find(key);
+    if (n == nullptr || !isLive(n)) {
+      // the given path is deleted
+      return;
     }
 
-    *data = n->data;
-    return Status::OK();
+    // removes the subtree bottom-up, so that readers never see a node without
+    // its parent.
+    for (const auto &child : liveDescendants(key)) {
+      remove(child, seq);
+    }
+    remove(key, seq);
   }
 
- private:
-  StatusWith<std::vector<Slice>> validatePath(const Slice &p) {
-    Slice path = p;
-    path.TrimSpace();
-    if (UNLIKELY(path.Len() == 0)) {
-      return Status::Make(Error::InvalidArgument, "path is empty");
+  // REQUIRES: writeMu_ held
+  void remove(const Slice &key, uint64_t seq) {
+    Node *n = index_.Find(key);
+    if (n != nullptr) {
+      addVersion(n, Version::NewTombstone(seq, &arena_));
+    }
+  }
+
+  // REQUIRES: writeMu_ held
+  void addVersion(Node *n, Version *v) {
+    v->older.store(n->value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    n->value.store(v, std::memory_order_release);
+    if (!collect(n)) {
+      dirty_.push_back(n->Key().ToString());
+    }
+  }
+
+  // Frees the versions of `n` that no one can read, and the node itself if it's
+  // deleted in all of them. Returns false if some versions are kept for snapshots.
+  // REQUIRES: writeMu_ held
+  bool collect(Node *n) {
+    uint64_t minSeq = snapshots_.empty() ? UINT64_MAX : *snapshots_.begin();
+
+    // the oldest version that anyone reads.
+    Version *head = n->value.load(std::memory_order_relaxed);
+    Version *v = head;
+    while (v != nullptr && v->seq > minSeq) {
+      v = v->older.load(std::memory_order_relaxed);
     }
 
-    for (size_t i = 0; i < path.size(); i++) {
-      if (path[i] == '\0') {
-        return FMT_Status(InvalidArgument, "path contains NUL at index {}", i);
+    if (v != nullptr) {
+      Version *older = v->older.load(std::memory_order_relaxed);
+      if (older != nullptr) {
+        v->older.store(nullptr, std::memory_order_release);
+        Arena *arena = &arena_;
+        Epoch::Retire([older, arena]() { Version::DisposeChain(older, arena); });
       }
     }
 
-    std::vector<Slice> result;
-    boost::split(result, path, [](char c) { return c == '/'; });
-    return result;
+    if (v == head && head->IsTombstone() && n->Key().size() > 0) {
+      index_.Remove(n->Key());
+      return true;
+    }
+    return v == head;
   }
 
  private:
-  Node root_;
+  // destroyed after the index.
+  Arena arena_;
+
+  SkipList<Version> index_;
+
+  std::mutex writeMu_;
 
-  mutable std::mutex mu_;
+  // the sequence number of the last write, only modified with writeMu_ held.
+  std::atomic<uint64_t> seq_;
+
+  // the sequence numbers of the live snapshots.
+  std::multiset<uint64_t> snapshots_;
+
+  // the keys of the nodes holding versions for snapshots.
+  std::vector<std::string> dirty_;
 };
 
+Status MemKvStore::Write(const Slice &path, const Slice &value, uint64_t index) {
+  DCHECK_GT(index, 0);
+  return impl_->Write(path, value, index);
+}
+
+Status MemKvStore::Delete(const Slice &path, uint64_t index) {
+  DCHECK_GT(index, 0);
+  return impl_->Delete(path, index);
+}
+
 Status MemKvStore::Write(const Slice &path, const Slice &value) {
-  return impl_->Write(path, value);
+  return impl_->Write(path, value, 0);
 }
 
 Status MemKvStore::Delete(const Slice &path) {
-  return impl_->Delete(path);
+  return impl_->Delete(path, 0);
+}
+
+Status MemKvStore::Write(const std::vector<WriteOp> &ops, uint64_t index) {
+  DCHECK_GT(index, 0);
+  return impl_->Write(ops, index);
+}
+
+Status MemKvStore::Write(const std::vector<WriteOp> &ops) {
+  return impl_->Write(ops, 0);
 }
 
 Status MemKvStore::Get(const Slice &path, std::string *data) {
-  return impl_->Get(path, data);
+  return impl_->Get(path, nullptr, data);
+}
+
+Status MemKvStore::Get(const Slice &path, const Snapshot *snapshot, std::string *data) {
+  return impl_->Get(path, snapshot, data);
+}
+
+Status MemKvStore::List(const Slice &path, const ScanOptions &options,
+                        std::vector<KeyValue> *result, bool *more) {
+  return impl_->List(path, options, false, result, more);
+}
+
+Status MemKvStore::Scan(const Slice &path, const ScanOptions &options,
+                        std::vector<KeyValue> *result, bool *more) {
+  return impl_->List(path, options, true, result, more);
+}
+
+uint64_t MemKvStore::AppliedIndex() const {
+  return impl_->AppliedIndex();
+}
+
+const Snapshot *MemKvStore::GetSnapshot() {
+  return impl_->GetSnapshot();
+}
+
+Status MemKvStore::GetSnapshot(uint64_t index, const Snapshot **snapshot) {
+  return impl_->GetSnapshot(index, snapshot);
+}
+
+void MemKvStore::ReleaseSnapshot(const Snapshot *snapshot) {
+  impl_->ReleaseSnapshot(snapshot);
+}
+
+Status MemKvStore::SerializeSnapshot(const Snapshot *snapshot, std::string *data) {
+  return impl_->SerializeSnapshot(snapshot, data);
+}
+
+Status MemKvStore::Restore(const Slice &data, uint64_t index) {
+  DCHECK_GT(index, 0);
+  return impl_->Restore(data, index);
+}
+
+Status MemKvStore::Restore(const Slice &data) {
+  return impl_->Restore(data, 0);
+}
+
+size_t MemKvStore::ApproximateMemoryUsage() const {
+  return impl_->ApproximateMemoryUsage();
+}
+
+Status MemKvStore::CheckWrite(const Slice &path) {
+  return validatePath(path).GetStatus();
+}
+
+Status MemKvStore::CheckWrite(const std::vector<WriteOp> &ops) {
+  for (const WriteOp &op : ops) {
+    RETURN_NOT_OK(op.type == WriteOp::kWrite ? CheckWrite(op.path) : CheckDelete(op.path));
+  }
+  return Status::OK();
+}
+
+Status MemKvStore::CheckDelete(const Slice &path) {
+  std::vector<Slice> pathVec;
+  ASSIGN_IF_OK(validatePath(path), pathVec);
+
+  for (const Slice &seg : pathVec) {
+    if (seg.Len() != 0) {
+      return Status::OK();
+    }
+  }
+  return Status::Make(Error::InvalidArgument, "cannot delete root directory");
+}
+
+StatusWith<std::string> MemKvStore::NormalizePath(const Slice &path) {
+  std::vector<Slice> pathVec;
+  ASSIGN_IF_OK(validatePath(path), pathVec);
+  return "/" + normalizePath(pathVec);
 }
 
 MemKvStore::MemKvStore() : impl_(new Impl) {}
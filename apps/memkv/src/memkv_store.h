@@ -14,22 +14,148 @@
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #include "slice.h"
 #include "status.h"
 
 namespace memkv {
 
+// Abstract handle to particular state of a DB.
+// A Snapshot is an immutable object and can therefore be safely
+// accessed from multiple threads without any external synchronization.
+class Snapshot {
+ public:
+  // The index of the last write visible in the snapshot.
+  virtual uint64_t Index() const = 0;
+
+ protected:
+  virtual ~Snapshot();
+};
+
+// A node returned by List and Scan.
+struct KeyValue {
+  // the full path of the node, e.g "/a/b".
+  std::string path;
+
+  std::string value;
+};
+
+struct ScanOptions {
+  // Only the nodes whose paths are after `start_after` are returned, which is the
+  // last path of the previous page when paginating.
+  // Default: "", from the first node.
+  std::string start_after;
+
+  // The maximum number of nodes returned.
+  // Default: 0, no limit.
+  size_t limit = 0;
+
+  // Reads in the state of the snapshot, so that the pages are consistent.
+  // Default: nullptr, reads the latest state.
+  const Snapshot *snapshot = nullptr;
+};
+
+// An operation in a batch of writes.
+struct WriteOp {
+  enum Type {
+    kWrite,
+    kDelete,
+  };
+
+  Type type;
+  Slice path;
+
+  // ignored by kDelete.
+  Slice value;
+};
+
 // MemKvStore is the internal in-memory storage of memkv. It's thread-safe.
 // A request will first go through DB, after WAL committed, it finally applies
 // in MemKvStore.
+// Writes are serialized, while Get is lock-free and never blocked by writes.
+//
+// The store is multi-versioned: every write is tagged by an index, which is the
+// index of its raft log entry when the write is applied from the replicated log.
+// The state at an applied index can be read as long as a snapshot keeps it.
 class MemKvStore {
  public:
+  // Applies the write of the log entry at `index`.
+  // REQUIRES: `index` > AppliedIndex()
+  Status Write(const Slice &path, const Slice &value, uint64_t index);
+
+  Status Delete(const Slice &path, uint64_t index);
+
+  // Same as above, tagged by AppliedIndex() + 1.
   Status Write(const Slice &path, const Slice &value);
 
   Status Delete(const Slice &path);
 
+  // Applies `ops` in order, all tagged by `index`, so that a snapshot sees either
+  // all of them or none. Nothing is applied if any of them is invalid.
+  // REQUIRES: `index` > AppliedIndex()
+  Status Write(const std::vector<WriteOp> &ops, uint64_t index);
+
+  Status Write(const std::vector<WriteOp> &ops);
+
   Status Get(const Slice &path, std::string *data);
 
+  // Reads `path` in the state of `snapshot`.
+  Status Get(const Slice &path, const Snapshot *snapshot, std::string *data);
+
+  // Lists the children of the directory `path`, ordered by path.
+  // `*more` is set to true if there're nodes left beyond `options.limit`.
+  Status List(const Slice &path, const ScanOptions &options, std::vector<KeyValue> *result,
+              bool *more);
+
+  // Same as List, but returns all the descendants of `path` recursively.
+  Status Scan(const Slice &path, const ScanOptions &options, std::vector<KeyValue> *result,
+              bool *more);
+
+  // The index of the last write.
+  uint64_t AppliedIndex() const;
+
+  // Returns a handle to the current state. Taking a snapshot costs O(1), it keeps
+  // the versions it reads from being freed, until it's released by ReleaseSnapshot.
+  const Snapshot *GetSnapshot();
+
+  // Returns a handle to the state right after the write at `index` was applied.
+  // Versions are freed once no snapshot can read them, so the state at `index` is
+  // available only if `index` is not older than the oldest live snapshot, otherwise
+  // VersionCompacted is returned.
+  Status GetSnapshot(uint64_t index, const Snapshot **snapshot);
+
+  void ReleaseSnapshot(const Snapshot *snapshot);
+
+  // Serializes the state of `snapshot` into `data`, neither reads nor writes
+  // are blocked.
+  Status SerializeSnapshot(const Snapshot *snapshot, std::string *data);
+
+  // Replaces the whole content with `data` produced by SerializeSnapshot, as the
+  // state at `index`.
+  // Concurrent readers may see a mix of the old and the new content.
+  // REQUIRES: `index` > AppliedIndex()
+  Status Restore(const Slice &data, uint64_t index);
+
+  Status Restore(const Slice &data);
+
+  // The bytes of memory allocated for the nodes and the data.
+  size_t ApproximateMemoryUsage() const;
+
+  // Returns the error that Write or Delete on `path` fails with regardless of the
+  // content of the store, so that invalid requests can be rejected before they're
+  // replicated.
+  static Status CheckWrite(const Slice &path);
+
+  static Status CheckWrite(const std::vector<WriteOp> &ops);
+
+  static Status CheckDelete(const Slice &path);
+
+  // Returns the canonical form of `path` by which paths are compared, e.g
+  // "//a/b/" => "/a/b".
+  static StatusWith<std::string> NormalizePath(const Slice &path);
+
   MemKvStore();
 
   ~MemKvStore();
@@ -0,0 +1,123 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <thread>
+
+#include "logging.h"
+#include "memkv_store.h"
+
+#include <benchmark/benchmark.h>
+#include <consensus/base/random.h>
+
+using namespace memkv;
+
+static const int kNumKeys = 100000;
+
+static std::string keyOf(int i) {
+  return fmt::format("/bench/dir{}/key{}", i % 100, i);
+}
+
+static MemKvStore *sharedStore() {
+  static MemKvStore *store = []() {
+    auto s = new MemKvStore;
+    std::string value(100, 'v');
+    for (int i = 0; i < kNumKeys; i++) {
+      FATAL_NOT_OK(s->Write(keyOf(i), value), "Write");
+    }
+    return s;
+  }();
+  return store;
+}
+
+// Concurrent Gets on a store of `kNumKeys` keys, the throughput should scale with
+// the number of threads, since readers take no lock.
+void GetBench(benchmark::State &state) {
+  MemKvStore *store = sharedStore();
+  consensus::Random rnd(state.thread_index + 1);
+
+  std::string value;
+  while (state.KeepRunning()) {
+    FATAL_NOT_OK(store->Get(keyOf(rnd.Uniform(kNumKeys)), &value), "Get");
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Same as GetBench, while a background writer keeps overwriting the keys, like the
+// apply thread of a busy memkv node.
+void GetWhileWritingBench(benchmark::State &state) {
+  MemKvStore *store = sharedStore();
+
+  static std::atomic<bool> stop;
+  static std::thread *writer;
+  if (state.thread_index == 0) {
+    stop = false;
+    writer = new std::thread([store]() {
+      consensus::Random rnd(0);
+      std::string value(100, 'w');
+      while (!stop) {
+        FATAL_NOT_OK(store->Write(keyOf(rnd.Uniform(kNumKeys)), value), "Write");
+      }
+    });
+  }
+
+  consensus::Random rnd(state.thread_index + 1);
+  std::string value;
+  while (state.KeepRunning()) {
+    FATAL_NOT_OK(store->Get(keyOf(rnd.Uniform(kNumKeys)), &value), "Get");
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index == 0) {
+    stop = true;
+    writer->join();
+    delete writer;
+  }
+}
+
+void WriteBench(benchmark::State &state) {
+  MemKvStore store;
+  consensus::Random rnd(0);
+  std::string value(state.range(0), 'v');
+
+  while (state.KeepRunning()) {
+    FATAL_NOT_OK(store.Write(keyOf(rnd.Uniform(kNumKeys)), value), "Write");
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// Fills a store with `kNumKeys` keys of range(0)-byte values, reports the memory
+// used per key.
+void PopulateBench(benchmark::State &state) {
+  std::string value(state.range(0), 'v');
+
+  size_t memoryPerKey = 0;
+  while (state.KeepRunning()) {
+    MemKvStore store;
+    for (int i = 0; i < kNumKeys; i++) {
+      FATAL_NOT_OK(store.Write(keyOf(i), value), "Write");
+    }
+    memoryPerKey = store.ApproximateMemoryUsage() / kNumKeys;
+  }
+  state.SetItemsProcessed(state.iterations() * kNumKeys);
+  state.SetLabel(fmt::format("memory per key: {} bytes", memoryPerKey).c_str());
+}
+
+BENCHMARK(GetBench)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(GetWhileWritingBench)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(WriteBench)->Arg(16)->Arg(1024);
+BENCHMARK(PopulateBench)->Arg(16)->Arg(128)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
+#include <thread>
 #include <unordered_map>
 
 #include "memkv_store.h"
@@ -112,4 +114,296 @@ TEST_F(TestMemKV, DeleteRecursively) {
   ASSERT_OK(kv.Delete("/tmp/xiaomi/ads/pegasus-1"));
   ASSERT_OK(kv.Get("/tmp/xiaomi/ads", &actual));
   ASSERT_ERROR(kv.Get("/tmp/xiaomi/ads/pegasus-1", &actual), Error::NodeNotExist);
-}
\ No newline at end of file
+}
+
+TEST_F(TestMemKV, DeleteKeepsSiblings) {
+  MemKvStore kv;
+  ASSERT_OK(kv.Write("/a/b/c", "1"));
+  ASSERT_OK(kv.Write("/a/b!", "2"));
+  ASSERT_OK(kv.Write("/a/b0", "3"));
+
+  ASSERT_OK(kv.Delete("/a/b"));
+
+  std::string actual;
+  ASSERT_ERROR(kv.Get("/a/b/c", &actual), Error::NodeNotExist);
+  ASSERT_OK(kv.Get("/a/b!", &actual));
+  ASSERT_EQ(actual, "2");
+  ASSERT_OK(kv.Get("/a/b0", &actual));
+  ASSERT_EQ(actual, "3");
+}
+
+// Readers run concurrently with a writer that keeps overwriting and deleting keys,
+// they must always see either a complete value or no value.
+TEST_F(TestMemKV, ConcurrentReadWrite) {
+  MemKvStore kv;
+  const int kKeys = 100;
+  std::atomic<bool> stop(false);
+
+  std::thread writer([&]() {
+    consensus::Random rnd(0);
+    for (int round = 0; round < 200; round++) {
+      for (int i = 0; i < kKeys; i++) {
+        std::string key = fmt::format("/dir{}/key{}", i % 10, i);
+        if (rnd.Uniform(4) == 0) {
+          ASSERT_OK(kv.Delete(key));
+        } else {
+          ASSERT_OK(kv.Write(key, fmt::format("{}:{}", key, round)));
+        }
+      }
+    }
+    stop = true;
+  });
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; r++) {
+    readers.emplace_back([&, r]() {
+      consensus::Random rnd(r + 1);
+      while (!stop) {
+        int i = rnd.Uniform(kKeys);
+        std::string key = fmt::format("/dir{}/key{}", i % 10, i);
+        std::string value;
+        Status s = kv.Get(key, &value);
+        if (s.IsOK()) {
+          ASSERT_EQ(value.substr(0, key.size() + 1), key + ":");
+        } else {
+          ASSERT_ERROR(s, Error::NodeNotExist);
+        }
+      }
+    });
+  }
+
+  writer.join();
+  for (auto &t : readers) {
+    t.join();
+  }
+}
+
+TEST_F(TestMemKV, MemoryReused) {
+  MemKvStore kv;
+  std::string value(100, 'v');
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_OK(kv.Write(fmt::format("/dir/key{}", i), value));
+  }
+  size_t usage = kv.ApproximateMemoryUsage();
+
+  // the memory of deleted nodes is reused by the new ones.
+  for (int round = 0; round < 10; round++) {
+    ASSERT_OK(kv.Delete("/dir"));
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_OK(kv.Write(fmt::format("/dir/key{}", i), value));
+    }
+  }
+  ASSERT_LE(kv.ApproximateMemoryUsage(), usage * 2);
+}
+
+TEST_F(TestMemKV, Snapshot) {
+  MemKvStore kv;
+  ASSERT_OK(kv.Write("/a/b", "1"));
+  ASSERT_OK(kv.Write("/c", "2"));
+
+  const Snapshot *snap = kv.GetSnapshot();
+  ASSERT_OK(kv.Write("/a/b", "3"));
+  ASSERT_OK(kv.Delete("/c"));
+  ASSERT_OK(kv.Write("/d", "4"));
+
+  std::string actual;
+  ASSERT_OK(kv.Get("/a/b", snap, &actual));
+  ASSERT_EQ(actual, "1");
+  ASSERT_OK(kv.Get("/c", snap, &actual));
+  ASSERT_EQ(actual, "2");
+  ASSERT_ERROR(kv.Get("/d", snap, &actual), Error::NodeNotExist);
+
+  ASSERT_OK(kv.Get("/a/b", &actual));
+  ASSERT_EQ(actual, "3");
+  ASSERT_ERROR(kv.Get("/c", &actual), Error::NodeNotExist);
+
+  // restores the state of the snapshot into another store.
+  std::string data;
+  ASSERT_OK(kv.SerializeSnapshot(snap, &data));
+  kv.ReleaseSnapshot(snap);
+
+  MemKvStore restored;
+  ASSERT_OK(restored.Write("/e", "5"));
+  ASSERT_OK(restored.Restore(data));
+  ASSERT_OK(restored.Get("/a/b", &actual));
+  ASSERT_EQ(actual, "1");
+  ASSERT_OK(restored.Get("/c", &actual));
+  ASSERT_EQ(actual, "2");
+  ASSERT_ERROR(restored.Get("/d", &actual), Error::NodeNotExist);
+  ASSERT_ERROR(restored.Get("/e", &actual), Error::NodeNotExist);
+}
+
+// The snapshot is serialized while a writer keeps overwriting, it must see none
+// of the writes made after it's taken.
+TEST_F(TestMemKV, SerializeWhileWriting) {
+  MemKvStore kv;
+  const int kKeys = 5000;
+  for (int i = 0; i < kKeys; i++) {
+    ASSERT_OK(kv.Write(fmt::format("/key{}", i), "old"));
+  }
+
+  const Snapshot *snap = kv.GetSnapshot();
+  std::thread writer([&]() {
+    for (int i = 0; i < kKeys; i++) {
+      ASSERT_OK(kv.Write(fmt::format("/key{}", i), "new"));
+      ASSERT_OK(kv.Delete(fmt::format("/key{}", (i + 1) % kKeys)));
+    }
+  });
+
+  std::string data;
+  ASSERT_OK(kv.SerializeSnapshot(snap, &data));
+  writer.join();
+  kv.ReleaseSnapshot(snap);
+
+  MemKvStore restored;
+  ASSERT_OK(restored.Restore(data));
+  for (int i = 0; i < kKeys; i++) {
+    std::string actual;
+    ASSERT_OK(restored.Get(fmt::format("/key{}", i), &actual));
+    ASSERT_EQ(actual, "old");
+  }
+}
+
+TEST_F(TestMemKV, ReadAtIndex) {
+  MemKvStore kv;
+  ASSERT_OK(kv.Write("/a", "1", 5));
+  ASSERT_OK(kv.Write("/a", "2", 7));
+  ASSERT_EQ(kv.AppliedIndex(), 7);
+
+  // only the latest state is kept without snapshot.
+  const Snapshot *snap;
+  ASSERT_ERROR(kv.GetSnapshot(5, &snap), Error::VersionCompacted);
+  ASSERT_ERROR(kv.GetSnapshot(8, &snap), Error::InvalidArgument);
+
+  const Snapshot *oldest;
+  ASSERT_OK(kv.GetSnapshot(7, &oldest));
+  ASSERT_EQ(oldest->Index(), 7);
+  ASSERT_OK(kv.Write("/a", "3", 9));
+  ASSERT_OK(kv.Delete("/a", 10));
+  ASSERT_OK(kv.Write("/a", "4", 12));
+
+  // every state since the oldest snapshot is readable.
+  std::string actual;
+  for (uint64_t index = 7; index <= 12; index++) {
+    ASSERT_OK(kv.GetSnapshot(index, &snap));
+    Status s = kv.Get("/a", snap, &actual);
+    if (index == 10 || index == 11) {
+      ASSERT_ERROR(s, Error::NodeNotExist);
+    } else {
+      ASSERT_OK(s);
+      ASSERT_EQ(actual, index < 9 ? "2" : index < 10 ? "3" : "4");
+    }
+    kv.ReleaseSnapshot(snap);
+  }
+
+  kv.ReleaseSnapshot(oldest);
+  ASSERT_ERROR(kv.GetSnapshot(9, &snap), Error::VersionCompacted);
+  ASSERT_OK(kv.Get("/a", &actual));
+  ASSERT_EQ(actual, "4");
+}
+
+static std::vector<std::string> pathsOf(const std::vector<KeyValue> &kvs) {
+  std::vector<std::string> paths;
+  for (const auto &kv : kvs) {
+    paths.push_back(kv.path);
+  }
+  return paths;
+}
+
+TEST_F(TestMemKV, List) {
+  MemKvStore kv;
+  ASSERT_OK(kv.Write("/a/b/c", "1"));
+  ASSERT_OK(kv.Write("/a/b!", "2"));
+  ASSERT_OK(kv.Write("/a/b0", "3"));
+  ASSERT_OK(kv.Write("/a/a/d/e", "4"));
+  ASSERT_OK(kv.Write("/z", "5"));
+
+  std::vector<KeyValue> result;
+  bool more;
+  ASSERT_OK(kv.List("/a", ScanOptions(), &result, &more));
+  ASSERT_EQ(pathsOf(result), std::vector<std::string>({"/a/a", "/a/b", "/a/b!", "/a/b0"}));
+  ASSERT_FALSE(more);
+
+  ASSERT_OK(kv.List("/", ScanOptions(), &result, &more));
+  ASSERT_EQ(pathsOf(result), std::vector<std::string>({"/a", "/z"}));
+
+  ASSERT_OK(kv.Scan("/a", ScanOptions(), &result, &more));
+  ASSERT_EQ(pathsOf(result), std::vector<std::string>({"/a/a", "/a/a/d", "/a/a/d/e", "/a/b",
+                                                       "/a/b!", "/a/b/c", "/a/b0"}));
+  ASSERT_EQ(result[2].value, "4");
+
+  ASSERT_ERROR(kv.List("/b", ScanOptions(), &result, &more), Error::NodeNotExist);
+  ASSERT_OK(kv.List("/z", ScanOptions(), &result, &more));
+  ASSERT_TRUE(result.empty());
+}
+
+// Pages of a scan are read in the same snapshot, so they're consistent even if
+// the store is modified between them.
+TEST_F(TestMemKV, ScanPagination) {
+  MemKvStore kv;
+  const int kKeys = 3000;
+  for (int i = 0; i < kKeys; i++) {
+    ASSERT_OK(kv.Write(fmt::format("/dir/key{:04d}", i), std::to_string(i)));
+  }
+
+  ScanOptions options;
+  options.limit = 1000;
+  options.snapshot = kv.GetSnapshot();
+
+  std::vector<std::string> paths;
+  bool more = true;
+  while (more) {
+    std::vector<KeyValue> result;
+    ASSERT_OK(kv.Scan("/dir", options, &result, &more));
+    ASSERT_LE(result.size(), options.limit);
+    for (const auto &e : result) {
+      paths.push_back(e.path);
+    }
+    if (!result.empty()) {
+      options.start_after = result.back().path;
+    }
+
+    ASSERT_OK(kv.Delete(fmt::format("/dir/key{:04d}", paths.size())));
+    ASSERT_OK(kv.Write("/dir/new", ""));
+  }
+  kv.ReleaseSnapshot(options.snapshot);
+
+  ASSERT_EQ(paths.size(), static_cast<size_t>(kKeys));
+  for (int i = 0; i < kKeys; i++) {
+    ASSERT_EQ(paths[i], fmt::format("/dir/key{:04d}", i));
+  }
+}
+
+TEST_F(TestMemKV, WriteBatch) {
+  MemKvStore kv;
+  ASSERT_OK(kv.Write("/a/b", "1", 1));
+  const Snapshot *snap = kv.GetSnapshot();
+
+  std::vector<WriteOp> ops;
+  ops.push_back(WriteOp{WriteOp::kWrite, "/c", "2"});
+  ops.push_back(WriteOp{WriteOp::kDelete, "/a", ""});
+  ops.push_back(WriteOp{WriteOp::kWrite, "/a/d", "3"});
+  ASSERT_OK(kv.Write(ops, 2));
+  ASSERT_EQ(kv.AppliedIndex(), 2);
+
+  std::string actual;
+  ASSERT_OK(kv.Get("/c", &actual));
+  ASSERT_EQ(actual, "2");
+  ASSERT_ERROR(kv.Get("/a/b", &actual), Error::NodeNotExist);
+  ASSERT_OK(kv.Get("/a/d", &actual));
+  ASSERT_EQ(actual, "3");
+
+  // none of the batch is visible in the snapshot taken before.
+  ASSERT_OK(kv.Get("/a/b", snap, &actual));
+  ASSERT_ERROR(kv.Get("/c", snap, &actual), Error::NodeNotExist);
+  ASSERT_ERROR(kv.Get("/a/d", snap, &actual), Error::NodeNotExist);
+  kv.ReleaseSnapshot(snap);
+
+  // nothing is applied if any operation is invalid.
+  ops.clear();
+  ops.push_back(WriteOp{WriteOp::kWrite, "/e", "4"});
+  ops.push_back(WriteOp{WriteOp::kDelete, "/", ""});
+  ASSERT_ERROR(MemKvStore::CheckWrite(ops), Error::InvalidArgument);
+  ASSERT_ERROR(kv.Write(ops, 3), Error::InvalidArgument);
+  ASSERT_ERROR(kv.Get("/e", &actual), Error::NodeNotExist);
+}
@@ -0,0 +1,253 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <new>
+
+#include "arena.h"
+#include "epoch.h"
+#include "slice.h"
+
+#include <consensus/base/random.h>
+#include <silly/disallow_copying.h>
+
+namespace memkv {
+
+// SkipList is an ordered map from byte strings to `Value*`, allowing a single writer
+// and any number of lock-free readers at the same time.
+//
+// Writers (Insert, Remove) must be serialized externally. Readers (Find, Iterator)
+// must hold an Epoch::Guard for as long as they access the nodes: a removed node and
+// its value are retired through Epoch, rather than freed immediately.
+//
+// The value of a node is owned by the node, it's released by the `Disposer` given at
+// construction once the node is freed. To replace it, a writer exchanges `Node::value`
+// and retires the old one.
+//
+// Nodes are allocated from an Arena, each in a single chunk with its key stored
+// inline behind the links.
+//
+// The design follows the skiplist of LevelDB's memtable, plus removal: a node is
+// linked bottom-up and unlinked top-down, so that it's reachable at a level only if
+// it is at the levels below. A reader standing on a removed node can still move
+// forward, since the links of the removed node are left untouched.
+template <typename Value>
+class SkipList {
+  __DISALLOW_COPYING__(SkipList);
+
+ public:
+  struct Node;
+
+  typedef void (*Disposer)(Value *value, Arena *arena);
+
+  // `arena` must outlive the list.
+  SkipList(Arena *arena, Disposer disposer)
+      : arena_(arena),
+        disposer_(disposer),
+        head_(newNode(Slice(), kMaxHeight)),
+        maxHeight_(1),
+        rnd_(0xdeadbeef) {}
+
+  // No reader may be active, and the removed nodes must have been freed by
+  // Epoch::Synchronize.
+  ~SkipList() {
+    Node *x = head_;
+    while (x != nullptr) {
+      Node *next = x->Next(0);
+      deleteNode(x);
+      x = next;
+    }
+  }
+
+  // Returns the node of `key`, or nullptr if not exists.
+  Node *Find(const Slice &key) const {
+    Node *x = findGreaterOrEqual(key, nullptr);
+    if (x != nullptr && x->Key().Compare(key) == 0) {
+      return x;
+    }
+    return nullptr;
+  }
+
+  // Returns the node of `key`, a new node with a null value is inserted if not exists.
+  Node *Insert(const Slice &key) {
+    Node *prev[kMaxHeight];
+    Node *x = findGreaterOrEqual(key, prev);
+    if (x != nullptr && x->Key().Compare(key) == 0) {
+      return x;
+    }
+
+    int height = randomHeight();
+    int maxHeight = maxHeight_.load(std::memory_order_relaxed);
+    if (height > maxHeight) {
+      for (int i = maxHeight; i < height; i++) {
+        prev[i] = head_;
+      }
+      // readers seeing the new height before the new node find nullptr at head_,
+      // and go down to the next level.
+      maxHeight_.store(height, std::memory_order_relaxed);
+    }
+
+    x = newNode(key, height);
+    for (int i = 0; i < height; i++) {
+      x->next_[i].store(prev[i]->Next(i), std::memory_order_relaxed);
+      prev[i]->next_[i].store(x, std::memory_order_release);
+    }
+    return x;
+  }
+
+  // Unlinks the node of `key` and retires it. Returns false if not exists.
+  bool Remove(const Slice &key) {
+    Node *prev[kMaxHeight];
+    Node *x = findGreaterOrEqual(key, prev);
+    if (x == nullptr || x->Key().Compare(key) != 0) {
+      return false;
+    }
+
+    for (int i = x->height_ - 1; i >= 0; i--) {
+      prev[i]->next_[i].store(x->Next(i), std::memory_order_release);
+    }
+    Epoch::Retire([this, x]() { deleteNode(x); });
+    return true;
+  }
+
+  struct Node {
+    Slice Key() const {
+      return Slice(reinterpret_cast<const char *>(&next_[height_]), keyLen_);
+    }
+
+    Node *Next(int level) const {
+      return next_[level].load(std::memory_order_acquire);
+    }
+
+    std::atomic<Value *> value;
+
+   private:
+    friend class SkipList;
+
+    Node(uint32_t keyLen, uint8_t height) : value(nullptr), keyLen_(keyLen), height_(height) {}
+
+    static size_t SizeOf(size_t keyLen, int height) {
+      return sizeof(Node) + sizeof(std::atomic<Node *>) * (height - 1) + keyLen;
+    }
+
+    const uint32_t keyLen_;
+    const uint8_t height_;
+
+    // Array of length `height_`, the key bytes are stored right behind.
+    std::atomic<Node *> next_[1];
+  };
+
+  // Iterates over the nodes in the order of key.
+  // REQUIRES: an Epoch::Guard is held during the lifetime of the iterator.
+  class Iterator {
+   public:
+    explicit Iterator(const SkipList *list) : list_(list), node_(nullptr) {}
+
+    bool Valid() const {
+      return node_ != nullptr;
+    }
+
+    Node *node() const {
+      return node_;
+    }
+
+    void Next() {
+      node_ = node_->Next(0);
+    }
+
+    // Positions at the first node whose key >= `target`.
+    void Seek(const Slice &target) {
+      node_ = list_->findGreaterOrEqual(target, nullptr);
+    }
+
+    void SeekToFirst() {
+      node_ = list_->head_->Next(0);
+    }
+
+   private:
+    const SkipList *list_;
+    Node *node_;
+  };
+
+ private:
+  static const int kMaxHeight = 12;
+
+  Node *newNode(const Slice &key, int height) {
+    char *mem = arena_->Allocate(Node::SizeOf(key.size(), height));
+    Node *x = new (mem) Node(static_cast<uint32_t>(key.size()), static_cast<uint8_t>(height));
+    for (int i = 1; i < height; i++) {
+      new (&x->next_[i]) std::atomic<Node *>(nullptr);
+    }
+    x->next_[0].store(nullptr, std::memory_order_relaxed);
+    memcpy(reinterpret_cast<char *>(&x->next_[height]), key.data(), key.size());
+    return x;
+  }
+
+  void deleteNode(Node *x) {
+    Value *value = x->value.load(std::memory_order_relaxed);
+    if (value != nullptr) {
+      disposer_(value, arena_);
+    }
+    size_t size = Node::SizeOf(x->keyLen_, x->height_);
+    x->~Node();
+    arena_->Free(reinterpret_cast<char *>(x), size);
+  }
+
+  int randomHeight() {
+    // Increase height with probability 1 in kBranching
+    static const unsigned int kBranching = 4;
+    int height = 1;
+    while (height < kMaxHeight && (rnd_.Uniform(kBranching) == 0)) {
+      height++;
+    }
+    return height;
+  }
+
+  // Returns the first node whose key >= `key`, and fills `prev` with the last node
+  // before it at each level if `prev` is not null.
+  Node *findGreaterOrEqual(const Slice &key, Node **prev) const {
+    Node *x = head_;
+    int level = maxHeight_.load(std::memory_order_relaxed) - 1;
+    while (true) {
+      Node *next = x->Next(level);
+      if (next != nullptr && next->Key().Compare(key) < 0) {
+        x = next;
+      } else {
+        if (prev != nullptr) {
+          prev[level] = x;
+        }
+        if (level == 0) {
+          return next;
+        }
+        level--;
+      }
+    }
+  }
+
+ private:
+  Arena *const arena_;
+  const Disposer disposer_;
+
+  Node *const head_;
+
+  std::atomic<int> maxHeight_;
+
+  // only used by the writer.
+  consensus::Random rnd_;
+};
+
+}  // namespace memkv
@@ -26,6 +26,8 @@ class Error {
     InvalidArgument,
     NodeNotExist,
     ConsensusError,
+    VersionCompacted,
+    Unavailable,
   };
 
   static std::string toString(unsigned int code);
@@ -190,6 +190,9 @@ class Env {
   // Delete the named file.
   virtual Status DeleteFile(const Slice &fname) = 0;
 
+  // Rename file src to target. If target exists, it's replaced atomically.
+  virtual Status RenameFile(const Slice &src, const Slice &target) = 0;
+
   // Store in *result the names of the children of the specified directory.
   // The names are relative to "dir".
   // Original contents of *results are dropped.
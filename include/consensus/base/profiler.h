@@ -0,0 +1,91 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "consensus/base/status.h"
+
+#include <silly/disallow_copying.h>
+
+namespace consensus {
+
+struct ProfilerOptions {
+  // the directory the profiles are written to, named "<kind>.<yyyymmdd-hhmmss.mmm>.prof".
+  std::string profile_dir;
+
+  // whether to collect the cpu profiles, which can be viewed by pprof.
+  // Requires the library built WITH_GPERFTOOLS.
+  // Default: false
+  bool cpu_profile;
+
+  // whether to dump the sampled heap at the end of each round.
+  // Requires the library built WITH_GPERFTOOLS, and TCMALLOC_SAMPLE_PARAMETER set
+  // in the environment before the process starts, e.g 524288.
+  // Default: false
+  bool heap_profile;
+
+  // whether to collect the contention of the mutexes, including the std::mutex
+  // guarding the WalCommitObserver, the ReadyFlusher and the RaftTimer, which brpc
+  // intercepts while the profiler runs.
+  // Default: false
+  bool contention_profile;
+
+  // time (in milliseconds) covered by a cpu or contention profile.
+  // Default: 30s
+  uint32_t profile_duration;
+
+  // time (in milliseconds) between the starts of two rounds of profiling.
+  // Default: 10min
+  uint32_t profile_interval;
+
+  // the number of profiles of each kind kept in `profile_dir`, the oldest are
+  // deleted beyond it.
+  // Default: 24
+  uint32_t max_profiles;
+
+  ProfilerOptions();
+
+  Status Validate() const;
+};
+
+// ContinuousProfiler profiles the process periodically in the background, so that
+// a regression under the real load is caught without rebuilding or attaching to
+// the process.
+//
+// The profilers are the same ones behind /hotspots of the brpc server, which serves
+// the on-demand profiles. A round is skipped if a profile of the same kind is
+// being collected on demand.
+class ContinuousProfiler {
+  __DISALLOW_COPYING__(ContinuousProfiler);
+
+ public:
+  // Returns error `NotSupported` if cpu or heap profiling is requested without
+  // gperftools.
+  static StatusWith<ContinuousProfiler *> New(const ProfilerOptions &options);
+
+  // Stops the profiling, the round in progress is cut short.
+  ~ContinuousProfiler();
+
+ private:
+  ContinuousProfiler() = default;
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace consensus
@@ -37,6 +37,8 @@ class Error {
     RuntimeError,
     InvalidArgument,
     WalWriteToNonLeader,
+    NotLeader,
+    TimedOut,
   };
 
   static std::string toString(unsigned int errorCode);
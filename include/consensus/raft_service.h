@@ -14,17 +14,38 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+
 #include <consensus/pb/raft_server.pb.h>
 
 namespace consensus {
 
 class RaftTaskExecutor;
+class ReplicatedLog;
+class SnapshotReceiver;
 
+// RaftServiceImpl serves one or more raft groups, a request is dispatched to its
+// group by the group id it carries. Requests to the groups not served fail with
+// GroupNotFound.
 class RaftServiceImpl : public pb::RaftService {
  public:
-  explicit RaftServiceImpl(RaftTaskExecutor *executor) : executor_(executor) {}
+  // Serves group 0 driven by `executor`.
+  explicit RaftServiceImpl(RaftTaskExecutor *executor);
+
+  // Serves the group of `log`. The service also serves ReadIndex for the followers
+  // of `log`.
+  explicit RaftServiceImpl(ReplicatedLog *log);
+
+  // Serves no group until AddGroup is called.
+  RaftServiceImpl();
 
-  ~RaftServiceImpl() = default;
+  // Serves the group of `log` in addition.
+  // REQUIRES: called before the service is added to a server, and `log` outlives
+  // the service.
+  void AddGroup(ReplicatedLog *log);
+
+  ~RaftServiceImpl();
 
   // RaftService::Step handles each request by calling RawNode::Step. If the request message
   // is invalid, the RaftService will respond with an error code.
@@ -32,11 +53,43 @@ class RaftServiceImpl : public pb::RaftService {
   void Step(google::protobuf::RpcController *controller, const pb::StepRequest *request,
             pb::StepResponse *response, google::protobuf::Closure *done) override;
 
+  // Reports the raft state and the replication progress of the group. Only the state
+  // owned by RawNode is read on the raft thread, the rest is maintained aside by the log.
   void Status(::google::protobuf::RpcController *controller, const pb::StatusRequest *request,
               pb::StatusResponse *response, ::google::protobuf::Closure *done) override;
 
+  // RaftService::StepStream accepts a stream from the leader, every message received
+  // from the stream will be stepped into RawNode in the order of arrival.
+  void StepStream(::google::protobuf::RpcController *controller,
+                  const pb::StepStreamRequest *request, pb::StepStreamResponse *response,
+                  ::google::protobuf::Closure *done) override;
+
+  // RaftService::InstallSnapshot receives a snapshot chunk by chunk, the MsgSnap
+  // carrying the whole snapshot is stepped into RawNode after the last chunk arrives.
+  // Chunks that are out of order or fail the checksum are rejected with the offset
+  // expected, from which the sender resumes.
+  void InstallSnapshot(::google::protobuf::RpcController *controller,
+                       const pb::InstallSnapshotRequest *request,
+                       pb::InstallSnapshotResponse *response,
+                       ::google::protobuf::Closure *done) override;
+
+  // RaftService::ReadIndex confirms the leadership and responds with the read index,
+  // see ReplicatedLog::ReadIndex. It's never forwarded, a non-leader fails the request.
+  void ReadIndex(::google::protobuf::RpcController *controller,
+                 const pb::ReadIndexRequest *request, pb::ReadIndexResponse *response,
+                 ::google::protobuf::Closure *done) override;
+
+ private:
+  struct Group;
+
+  // Returns nullptr if `id` is not served.
+  Group *findGroup(uint64_t id) const;
+
+  void addGroup(uint64_t id, RaftTaskExecutor *executor, ReplicatedLog *log);
+
  private:
-  RaftTaskExecutor *executor_;
+  // read-only once the service starts.
+  std::map<uint64_t, std::unique_ptr<Group>> groups_;
 };
 
 }  // namespace consensus
@@ -32,6 +32,10 @@ class RaftTimer {
   // Thread-safe
   void Register(RaftTaskExecutor* executor);
 
+  // Once it returns, `executor` is no longer accessed by the timer.
+  // Thread-safe
+  void Unregister(RaftTaskExecutor* executor);
+
  private:
   class Impl;
   std::unique_ptr<Impl> impl_;
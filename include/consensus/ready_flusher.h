@@ -30,6 +30,9 @@ class ReadyFlusher {
 
   void Register(ReplicatedLogImpl* log);
 
+  // Once it returns, `log` is no longer accessed by the flusher.
+  void Unregister(ReplicatedLogImpl* log);
+
  private:
   class Impl;
   std::unique_ptr<Impl> impl_;
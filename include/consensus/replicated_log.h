@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <memory>
 
@@ -23,6 +24,8 @@
 #include "consensus/base/task_queue.h"
 #include "consensus/raft_timer.h"
 #include "consensus/ready_flusher.h"
+#include "consensus/rpc/cluster.h"
+#include "consensus/state_machine.h"
 #include "consensus/wal/wal.h"
 
 #include <silly/disallow_copying.h>
@@ -35,25 +38,101 @@ struct ReplicatedLogOptions {
 
   uint64_t id;
 
+  // the raft group the log belongs to, which is the same on every member of the group.
+  // A process hosts many logs of different groups, which share the task queue,
+  // the timer, the flusher and the RaftService, see RaftServiceImpl::AddGroup.
+  // Default: 0
+  uint64_t group_id;
+
+  // whether the node starts an election right away if the group has never elected
+  // a leader, rather than after an election timeout. It's set on a different
+  // member for each group, to spread the leaders of the groups across the nodes.
+  // Default: false
+  bool campaign_on_start;
+
   // time (in milliseconds) of a heartbeat interval.
   uint32_t heartbeat_interval;
 
   // time (in milliseconds) for an election to timeout.
   uint32_t election_timeout;
 
+  // the maximum number of unacknowledged MsgApp batches to each follower.
+  // see rpc::ClusterOptions::max_inflight_appends.
+  uint32_t max_inflight_appends;
+
+  // the maximum number of MsgApp batches queued for each follower.
+  // see rpc::ClusterOptions::max_pending_appends.
+  uint32_t max_pending_appends;
+
+  // compression of messages sent to the followers.
+  // see rpc::ClusterOptions::compress_type, peer_compress_types and min_compress_size.
+  pb::CompressType compress_type;
+  std::map<uint64_t, pb::CompressType> peer_compress_types;
+  size_t min_compress_size;
+
+  // chunk size and rate limit of snapshots sent to the followers.
+  // see rpc::ClusterOptions::snapshot_chunk_size and snapshot_rate_limit.
+  size_t snapshot_chunk_size;
+  uint64_t snapshot_rate_limit;
+
+  // whether ReadIndex is served by the leader lease without confirming the leadership
+  // by heartbeats. yaraft lets a follower vote for a candidate of a higher term at any
+  // time, so with the lease on, a follower refuses such votes within `election_timeout`
+  // after it last heard from the leader, see RaftTaskExecutor::SetVoteGuard. No other
+  // leader can be elected within `election_timeout` since a majority has heard from the
+  // leader, and the lease lasts `election_timeout - lease_clock_drift` since then.
+  // It's safe only if the clocks of the nodes drift apart by less than
+  // `lease_clock_drift` within an election timeout, and all the nodes enable it.
+  // Default: false
+  bool lease_read;
+
+  // time (in milliseconds) of the clock drift bound for the leader lease.
+  // Default: 500
+  uint32_t lease_clock_drift;
+
   // dedicated worker of the raft node.
   // there may have multiple instances sharing the same queue.
-  TaskQueue* taskQueue;
+  // Default: nullptr, the log creates its own.
+  std::shared_ptr<TaskQueue> taskQueue;
 
-  // the global timer
-  RaftTimer* timer;
+  // the global timer, may be shared by multiple instances.
+  // Default: nullptr, the log creates its own.
+  std::shared_ptr<RaftTimer> timer;
 
-  // the global ready flusher
-  ReadyFlusher* flusher;
+  // the global ready flusher, may be shared by multiple instances.
+  // Default: nullptr, the log creates its own.
+  std::shared_ptr<ReadyFlusher> flusher;
+
+  // the cluster that messages to the peers are passed through. The log takes the ownership.
+  // Default: nullptr, a brpc-based cluster connecting to `initial_cluster` is created.
+  rpc::Cluster* cluster;
 
   wal::WriteAheadLog* wal;
   yaraft::MemoryStorage* memstore;
 
+  // the application that committed entries are applied to. It's not owned by the log.
+  // If it's set, a write completes after it's applied to the state machine of the
+  // leader, otherwise once it's committed.
+  // Default: nullptr
+  StateMachine* state_machine;
+
+  // the number of applied entries between two snapshots of the state machine, after
+  // each snapshot the log is compacted. 0 disables snapshots.
+  // see StateMachine::TakeSnapshot.
+  // Default: 0
+  uint64_t snapshot_threshold;
+
+  // the number of entries kept behind a snapshot when the log is compacted.
+  // Default: 1024
+  uint64_t snapshot_retained_entries;
+
+  // one in every `trace_sample_every` writes is traced through the stages of the
+  // pipeline, the latencies of each stage are exported as bvars prefixed by
+  // "consensus_write_node<id>_group<group_id>". 0 disables tracing.
+  // see WriteTracer.
+  // Default: 0
+  uint32_t trace_sample_every;
+
   ReplicatedLogOptions();
 
   Status Validate() const;
@@ -74,14 +153,49 @@ class ReplicatedLog {
   // Returns error `WalWriteToNonLeader` if the current node is not leader.
   Status Write(const Slice& log);
 
-  // Asynchronously write a slice of log into storage, the call will returns immediately
-  // with a SimpleChannel that's used to wait for the commit of this write.
-  SimpleChannel<Status> AsyncWrite(const Slice& log);
+  typedef std::function<void(const Status&)> WriteCallback;
+
+  // Asynchronously write a slice of log, `callback` is invoked with the result of
+  // the write once it completes, the same result that Write returns. `log` is copied
+  // before the call returns.
+  // The callback runs on an internal thread of the log, it must not block.
+  void AsyncWrite(const Slice& log, WriteCallback callback);
+
+  // Returns an index that covers every write completed before the call. A read on the
+  // state machine is linearizable once the state machine has applied this index,
+  // see WaitApplied.
+  //
+  // The leadership is confirmed by the next round of heartbeats, concurrent calls share
+  // the same round, so a call takes up to `heartbeat_interval` but never touches
+  // the log. With `lease_read`, a leader holding the lease returns immediately.
+  //
+  // A follower requests the read index from the leader through RaftService::ReadIndex,
+  // so that reads can be served by every replica.
+  // Returns error `NotLeader` if no leader is known or the leader fails to serve, or
+  // `IllegalState` if the leader has yet to commit an entry in its term.
+  StatusWith<uint64_t> ReadIndex();
+
+  // Blocks until the state machine has applied the entry at `index`, for at most
+  // `timeout_ms` milliseconds.
+  // Returns error `NotSupported` if there's no state machine, `TimedOut` if the entry
+  // isn't applied in time, e.g the node falls behind the leader, or `IllegalState` if
+  // the log is being destroyed.
+  Status WaitApplied(uint64_t index, uint32_t timeout_ms);
+
+  // Reads the entries in [lo, hi) from the log, at most `max_size` bytes but at least
+  // one entry. Entries after the commit index may be read, they can be overwritten
+  // by a new leader.
+  // Returns error `LogCompacted` if `lo` has been compacted by a snapshot, or
+  // `OutOfBound` if `hi` is beyond the last index.
+  Status Entries(uint64_t lo, uint64_t hi, uint64_t max_size,
+                 std::vector<yaraft::pb::Entry>* entries);
 
   RaftTaskExecutor* RaftTaskExecutorInstance() const;
 
   uint64_t Id() const;
 
+  uint64_t GroupId() const;
+
   ~ReplicatedLog();
 
  private:
@@ -89,6 +203,7 @@ class ReplicatedLog {
 
  private:
   friend class ReplicatedLogTest;
+  friend class RaftServiceImpl;
 
   friend class ReplicatedLogImpl;
   std::unique_ptr<ReplicatedLogImpl> impl_;
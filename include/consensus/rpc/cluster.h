@@ -14,22 +14,98 @@
 
 #pragma once
 
+#include <functional>
+#include <map>
 #include <vector>
 
 #include "consensus/base/status.h"
+#include "consensus/pb/raft_server.pb.h"
 
 #include <yaraft/pb/raftpb.pb.h>
 
 namespace consensus {
 namespace rpc {
 
+struct ClusterOptions {
+  // id -> IP
+  std::map<uint64_t, std::string> initial_cluster;
+
+  // The raft group the messages belong to, carried by every request to the peers.
+  // Default: 0
+  uint64_t group_id;
+
+  // The maximum number of MsgApp batches sent to a peer that haven't yet been
+  // acknowledged. Further appends are queued until acks come back.
+  // Default: 32
+  uint32_t max_inflight_appends;
+
+  // The maximum number of MsgApp batches queued for a peer once its inflight window
+  // is full. Appends beyond the limit are dropped, raft will resend them after the
+  // follower rejects the next append.
+  // Default: 1024
+  uint32_t max_pending_appends;
+
+  // The compression requested for messages sent to peers. Whether it's applied is
+  // negotiated with each peer when the stream to it is established.
+  // Compression runs on the thread passing the messages, never on the raft thread.
+  // Default: COMPRESS_NONE
+  pb::CompressType compress_type;
+
+  // id -> compression, overrides `compress_type` for specific peers, e.g to compress
+  // only the traffic to replicas in remote datacenters.
+  std::map<uint64_t, pb::CompressType> peer_compress_types;
+
+  // Messages smaller than this are sent uncompressed.
+  // Default: 4096
+  size_t min_compress_size;
+
+  // Snapshots are sent to peers in chunks of this size.
+  // Default: 1MB
+  size_t snapshot_chunk_size;
+
+  // The maximum bytes per second of snapshot data sent to each peer, 0 means unlimited.
+  // Default: 64MB
+  uint64_t snapshot_rate_limit;
+
+  // Informed of the result of every snapshot sent to a peer, on the thread sending it.
+  // `failed` is true if the peer is unable to install the snapshot.
+  // Default: null
+  std::function<void(uint64_t to, bool failed)> snapshot_reporter;
+
+  ClusterOptions();
+};
+
+// The connection to a peer.
+struct PeerStatus {
+  // MsgApp batches sent but not yet acknowledged.
+  uint32_t inflight_appends;
+
+  // messages queued until the stream is established, or the inflight window opens.
+  uint32_t pending_messages;
+
+  PeerStatus() : inflight_appends(0), pending_messages(0) {}
+};
+
 class Cluster {
  public:
   virtual ~Cluster() = default;
 
   virtual Status Pass(std::vector<yaraft::pb::Message>& mails) = 0;
 
-  static Cluster* Default(const std::map<uint64_t, std::string>& initialCluster);
+  // Requests a read index from `leader` through RaftService::ReadIndex, blocks until
+  // it responds.
+  // Returns error `NotSupported` if the cluster doesn't serve it.
+  virtual StatusWith<uint64_t> ReadIndex(uint64_t leader) {
+    return Status::Make(Error::NotSupported, "Cluster::ReadIndex");
+  }
+
+  // Returns the status of the connection to each peer, empty if the cluster doesn't
+  // track it.
+  virtual std::map<uint64_t, PeerStatus> PeerStatuses() const {
+    return std::map<uint64_t, PeerStatus>();
+  }
+
+  static Cluster* Default(const ClusterOptions& options);
 };
 
 }  // namespace rpc
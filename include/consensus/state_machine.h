@@ -0,0 +1,68 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "consensus/base/status.h"
+
+#include <yaraft/pb/raftpb.pb.h>
+
+namespace consensus {
+
+// StateMachineSnapshot is a point-in-time image of a state machine, it's unaffected
+// by the entries applied after it's taken.
+class StateMachineSnapshot {
+ public:
+  virtual ~StateMachineSnapshot() = default;
+
+  // Serializes the image into `data`, which is the data of the raft snapshot that
+  // ApplySnapshot receives on other nodes.
+  // It's called on a background thread while the state machine keeps applying.
+  virtual Status Serialize(std::string* data) = 0;
+};
+
+// StateMachine is the application built on a ReplicatedLog. Every node, leader or
+// follower, applies the committed entries to its state machine in the order of log.
+//
+// All the methods are called on a dedicated apply thread, one at a time, so an
+// implementation needs no synchronization against itself. But it should be
+// thread-safe to readers from other threads.
+class StateMachine {
+ public:
+  virtual ~StateMachine() = default;
+
+  // Applies a batch of committed entries, ordered by index. The batch directly
+  // follows the previous one.
+  // Entries with empty data are no-ops appended by newly-elected leaders, they
+  // should be skipped.
+  virtual void Apply(const std::vector<yaraft::pb::Entry>& entries) = 0;
+
+  // Replaces the whole state with the snapshot received from the leader.
+  // The entries applied next directly follow the snapshot.
+  virtual void ApplySnapshot(const yaraft::pb::Snapshot& snapshot) {}
+
+  // Takes a snapshot of the state, including every entry applied so far. The log
+  // before the snapshot can then be compacted.
+  // It's called between two batches, so it should be cheap, e.g a copy-on-write
+  // image, leaving the work to StateMachineSnapshot::Serialize.
+  // Returns nullptr if snapshots are not supported.
+  virtual StateMachineSnapshot* TakeSnapshot() {
+    return nullptr;
+  }
+};
+
+}  // namespace consensus
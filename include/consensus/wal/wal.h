@@ -41,6 +41,16 @@ class WriteAheadLogOptions {
   WriteAheadLogOptions();
 };
 
+struct WalUsage {
+  // the number of log segments.
+  size_t segment_num;
+
+  // the total size of the log segments in bytes.
+  uint64_t bytes;
+
+  WalUsage() : segment_num(0), bytes(0) {}
+};
+
 class WriteAheadLog;
 using WriteAheadLogUPtr = std::unique_ptr<WriteAheadLog>;
 
@@ -63,6 +73,12 @@ class WriteAheadLog {
     return Write(PBEntryVec(), hs);
   }
 
+  // Save a snapshot received from the leader, along with the raft state. The snapshot
+  // replaces the log before it, recovery starts from the latest saved snapshot.
+  // The snapshot is durable once it returns.
+  virtual Status SaveSnapshot(const yaraft::pb::Snapshot& snap,
+                              const yaraft::pb::HardState* hs) = 0;
+
   virtual Status Sync() = 0;
 
   virtual Status Close() = 0;
@@ -72,6 +88,12 @@ class WriteAheadLog {
   // Abandon the unused logs.
   virtual Status GC(CompactionHint* hint) = 0;
 
+  // Unlike the others, it's safe to call concurrently with Write.
+  // Default: empty usage, for the implementations not tracking it.
+  virtual WalUsage Usage() const {
+    return WalUsage();
+  }
+
   // Default implementation of WAL.
   static Status Default(const WriteAheadLogOptions& options, WriteAheadLogUPtr* wal,
                         yaraft::MemStoreUptr* memstore);
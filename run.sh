@@ -52,13 +52,23 @@ function run_test() {
     unit_test coding_test
     unit_test background_worker_test
     unit_test random_test
+    unit_test profiler_test
 
     unit_test log_writer_test
     unit_test log_manager_test
 
+    unit_test message_codec_test
+    unit_test raft_client_test
+    unit_test loopback_cluster_test
+
     unit_test raft_service_test
     unit_test raft_timer_test
     unit_test raft_task_executor_test
+    unit_test apply_worker_test
+    unit_test read_indexer_test
+    unit_test write_tracer_test
+    unit_test log_metrics_test
+    unit_test snapshotter_test
     # unit_test replicated_log_test
 }
 
@@ -0,0 +1,175 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "base/background_worker.h"
+#include "base/logging.h"
+
+#include "apply_worker.h"
+
+namespace consensus {
+
+class ApplyWorker::Impl {
+ public:
+  Impl(StateMachine *stateMachine, std::function<void(uint64_t)> onApplied)
+      : stateMachine_(stateMachine),
+        onApplied_(std::move(onApplied)),
+        appliedIndex_(0),
+        stopped_(false) {
+    FATAL_NOT_OK(worker_.StartLoop(std::bind(&Impl::applyRound, this)),
+                 "ApplyWorker: failed to start apply thread");
+  }
+
+  ~Impl() {
+    {
+      std::lock_guard<std::mutex> g(mu_);
+      stopped_ = true;
+    }
+    appliedCond_.notify_all();
+    cond_.notify_all();
+    FATAL_NOT_OK(worker_.Stop(), "ApplyWorker: failed to stop apply thread");
+  }
+
+  void Submit(std::vector<yaraft::pb::Entry> entries) {
+    std::lock_guard<std::mutex> g(mu_);
+    Task task;
+    task.entries = std::move(entries);
+    tasks_.push_back(std::move(task));
+    cond_.notify_one();
+  }
+
+  void SubmitSnapshot(const yaraft::pb::Snapshot &snapshot) {
+    std::lock_guard<std::mutex> g(mu_);
+    Task task;
+    task.snapshot.reset(new yaraft::pb::Snapshot(snapshot));
+    tasks_.push_back(std::move(task));
+    cond_.notify_one();
+  }
+
+  uint64_t AppliedIndex() const {
+    return appliedIndex_.load();
+  }
+
+  Status WaitApplied(uint64_t index, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mu_);
+    appliedCond_.wait_for(lock, timeout,
+                          [&]() { return stopped_ || appliedIndex_.load() >= index; });
+    if (appliedIndex_.load() >= index) {
+      return Status::OK();
+    }
+    if (stopped_) {
+      return FMT_Status(IllegalState, "ApplyWorker is stopped before applying {}", index);
+    }
+    return FMT_Status(TimedOut, "ApplyWorker: {} is not applied in {}ms, applied: {}", index,
+                      timeout.count(), appliedIndex_.load());
+  }
+
+ private:
+  struct Task {
+    std::unique_ptr<yaraft::pb::Snapshot> snapshot;
+    std::vector<yaraft::pb::Entry> entries;
+  };
+
+  void applyRound() {
+    std::deque<Task> tasks;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cond_.wait_for(lock, std::chrono::milliseconds(10), [&]() { return !tasks_.empty(); });
+      tasks.swap(tasks_);
+    }
+    if (tasks.empty()) {
+      return;
+    }
+
+    // consecutive entries are merged into one batch, a snapshot breaks the batch.
+    std::vector<yaraft::pb::Entry> batch;
+    for (auto &task : tasks) {
+      if (task.snapshot) {
+        applyBatch(&batch);
+
+        stateMachine_->ApplySnapshot(*task.snapshot);
+        setApplied(task.snapshot->metadata().index());
+        continue;
+      }
+
+      if (batch.empty()) {
+        batch.swap(task.entries);
+      } else {
+        batch.insert(batch.end(), std::make_move_iterator(task.entries.begin()),
+                     std::make_move_iterator(task.entries.end()));
+      }
+    }
+    applyBatch(&batch);
+  }
+
+  void applyBatch(std::vector<yaraft::pb::Entry> *batch) {
+    if (batch->empty()) {
+      return;
+    }
+
+    stateMachine_->Apply(*batch);
+    setApplied(batch->back().index());
+    batch->clear();
+  }
+
+  void setApplied(uint64_t index) {
+    {
+      std::lock_guard<std::mutex> g(mu_);
+      appliedIndex_.store(index);
+    }
+    appliedCond_.notify_all();
+    onApplied_(index);
+  }
+
+ private:
+  StateMachine *stateMachine_;
+  std::function<void(uint64_t)> onApplied_;
+
+  std::atomic<uint64_t> appliedIndex_;
+  bool stopped_;
+
+  std::mutex mu_;
+  std::condition_variable cond_;
+  std::condition_variable appliedCond_;
+  std::deque<Task> tasks_;
+
+  BackgroundWorker worker_;
+};
+
+ApplyWorker::ApplyWorker(StateMachine *stateMachine, std::function<void(uint64_t)> onApplied)
+    : impl_(new Impl(stateMachine, std::move(onApplied))) {}
+
+ApplyWorker::~ApplyWorker() = default;
+
+void ApplyWorker::Submit(std::vector<yaraft::pb::Entry> entries) {
+  impl_->Submit(std::move(entries));
+}
+
+void ApplyWorker::SubmitSnapshot(const yaraft::pb::Snapshot &snapshot) {
+  impl_->SubmitSnapshot(snapshot);
+}
+
+uint64_t ApplyWorker::AppliedIndex() const {
+  return impl_->AppliedIndex();
+}
+
+Status ApplyWorker::WaitApplied(uint64_t index, std::chrono::milliseconds timeout) {
+  return impl_->WaitApplied(index, timeout);
+}
+
+}  // namespace consensus
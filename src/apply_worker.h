@@ -0,0 +1,63 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "state_machine.h"
+
+#include <silly/disallow_copying.h>
+
+namespace consensus {
+
+// ApplyWorker applies committed entries to a StateMachine on its own thread, so that
+// neither the persistence of the log nor the raft thread waits for the application.
+// Entries submitted while the state machine is busy are applied together as the
+// next batch.
+//
+// Thread-Safe
+class ApplyWorker {
+  __DISALLOW_COPYING__(ApplyWorker);
+
+ public:
+  // `onApplied` is called on the apply thread after each batch, with the index of
+  // the last applied entry.
+  ApplyWorker(StateMachine* stateMachine, std::function<void(uint64_t)> onApplied);
+
+  // Entries not yet applied are discarded, the callers of WaitApplied are woken up.
+  ~ApplyWorker();
+
+  // REQUIRES: `entries` directly follow the ones submitted previously.
+  void Submit(std::vector<yaraft::pb::Entry> entries);
+
+  // The snapshot is applied in order with the entries.
+  void SubmitSnapshot(const yaraft::pb::Snapshot& snapshot);
+
+  // The index of the last entry applied to the state machine.
+  uint64_t AppliedIndex() const;
+
+  // Blocks until the entry at `index` is applied, for at most `timeout`.
+  // Returns error `TimedOut` if the entry isn't applied in time, or `IllegalState` if
+  // the worker is stopped.
+  Status WaitApplied(uint64_t index, std::chrono::milliseconds timeout);
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace consensus
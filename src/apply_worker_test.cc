@@ -0,0 +1,100 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "apply_worker.h"
+#include "base/simple_channel.h"
+#include "base/testing.h"
+
+#include <yaraft/pb_utils.h>
+
+using namespace consensus;
+
+class RecordingStateMachine : public StateMachine {
+ public:
+  void Apply(const std::vector<yaraft::pb::Entry> &entries) override {
+    for (const auto &e : entries) {
+      applied.push_back(e.index());
+    }
+  }
+
+  void ApplySnapshot(const yaraft::pb::Snapshot &snapshot) override {
+    applied.clear();
+    snapshotIndex = snapshot.metadata().index();
+  }
+
+  std::vector<uint64_t> applied;
+  uint64_t snapshotIndex = 0;
+};
+
+class ApplyWorkerTest : public BaseTest {};
+
+TEST_F(ApplyWorkerTest, ApplyInOrder) {
+  RecordingStateMachine sm;
+  Barrier barrier;
+  ApplyWorker worker(&sm, [&](uint64_t index) {
+    if (index == 100) {
+      barrier.Signal();
+    }
+  });
+
+  for (uint64_t i = 1; i <= 100; i += 10) {
+    std::vector<yaraft::pb::Entry> entries;
+    for (uint64_t k = i; k < i + 10; k++) {
+      entries.push_back(yaraft::PBEntry().Index(k).Term(1).v);
+    }
+    worker.Submit(std::move(entries));
+  }
+  barrier.Wait();
+
+  ASSERT_EQ(worker.AppliedIndex(), 100);
+  ASSERT_EQ(sm.applied.size(), 100);
+  for (uint64_t i = 0; i < 100; i++) {
+    ASSERT_EQ(sm.applied[i], i + 1);
+  }
+}
+
+TEST_F(ApplyWorkerTest, Snapshot) {
+  RecordingStateMachine sm;
+  Barrier barrier;
+  ApplyWorker worker(&sm, [&](uint64_t index) {
+    if (index == 12) {
+      barrier.Signal();
+    }
+  });
+
+  worker.Submit({yaraft::PBEntry().Index(1).Term(1).v});
+
+  yaraft::pb::Snapshot snap;
+  snap.mutable_metadata()->set_index(10);
+  snap.mutable_metadata()->set_term(2);
+  worker.SubmitSnapshot(snap);
+
+  worker.Submit({yaraft::PBEntry().Index(11).Term(2).v, yaraft::PBEntry().Index(12).Term(2).v});
+  barrier.Wait();
+
+  ASSERT_EQ(sm.snapshotIndex, 10);
+  ASSERT_EQ(sm.applied, std::vector<uint64_t>({11, 12}));
+}
+
+TEST_F(ApplyWorkerTest, WaitApplied) {
+  RecordingStateMachine sm;
+  ApplyWorker worker(&sm, [](uint64_t index) {});
+
+  worker.Submit({yaraft::PBEntry().Index(1).Term(1).v, yaraft::PBEntry().Index(2).Term(1).v});
+  ASSERT_OK(worker.WaitApplied(2, std::chrono::milliseconds(5000)));
+
+  Status s = worker.WaitApplied(3, std::chrono::milliseconds(50));
+  ASSERT_EQ(s.Code(), Error::TimedOut);
+  ASSERT_EQ(worker.AppliedIndex(), 2);
+}
@@ -317,6 +317,13 @@ class PosixEnv final : public Env {
     return Status::OK();
   }
 
+  Status RenameFile(const Slice& src, const Slice& target) override {
+    boost::system::error_code code;
+    boost::filesystem::rename(src.data(), target.data(), code);
+    RETURN_BOOST_EC(code);
+    return Status::OK();
+  }
+
   Status GetChildren(const std::string& dir, std::vector<std::string>* result) override {
     boost::system::error_code code;
     bool isDir = boost::filesystem::is_directory(dir, code);
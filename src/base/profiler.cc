@@ -0,0 +1,231 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+#include "base/env.h"
+#include "base/logging.h"
+#include "base/profiler.h"
+
+#include <bthread/mutex.h>
+#include <fmt/format.h>
+
+#ifdef CONSENSUS_WITH_GPERFTOOLS
+#include <gperftools/malloc_extension.h>
+#include <gperftools/profiler.h>
+#endif
+
+namespace consensus {
+
+class ContinuousProfiler::Impl {
+ public:
+  explicit Impl(const ProfilerOptions &options) : options_(options), stopped_(false) {}
+
+  void Start() {
+    thread_ = std::thread([this]() {
+      while (true) {
+        auto start = std::chrono::steady_clock::now();
+        profileRound();
+        if (!sleepUntil(start + std::chrono::milliseconds(options_.profile_interval))) {
+          return;
+        }
+      }
+    });
+  }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> g(mu_);
+      stopped_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+  }
+
+ private:
+  void profileRound() {
+    std::string suffix = timestamp() + ".prof";
+
+    bool cpu = false;
+#ifdef CONSENSUS_WITH_GPERFTOOLS
+    if (options_.cpu_profile) {
+      cpu = ProfilerStart(path("cpu." + suffix).c_str());
+      if (!cpu) {
+        LOG(WARNING) << "ContinuousProfiler: cpu profiler is busy, skip this round";
+      }
+    }
+#endif
+
+    bool contention = false;
+    if (options_.contention_profile) {
+      contention = bthread::ContentionProfilerStart(path("contention." + suffix).c_str());
+      if (!contention) {
+        LOG(WARNING) << "ContinuousProfiler: contention profiler is busy, skip this round";
+      }
+    }
+
+    if (cpu || contention) {
+      sleepUntil(std::chrono::steady_clock::now() +
+                 std::chrono::milliseconds(options_.profile_duration));
+    }
+
+#ifdef CONSENSUS_WITH_GPERFTOOLS
+    if (cpu) {
+      ProfilerStop();
+    }
+    if (options_.heap_profile) {
+      dumpHeap(path("heap." + suffix));
+    }
+#endif
+    if (contention) {
+      bthread::ContentionProfilerStop();
+    }
+
+    for (const char *kind : {"cpu.", "heap.", "contention."}) {
+      removeOldProfiles(kind);
+    }
+  }
+
+#ifdef CONSENSUS_WITH_GPERFTOOLS
+  void dumpHeap(const std::string &fname) {
+    std::string sample;
+    MallocExtension::instance()->GetHeapSample(&sample);
+
+    auto sw = Env::Default()->NewWritableFile(fname);
+    if (!sw.IsOK()) {
+      LOG(WARNING) << "ContinuousProfiler: " << sw.GetStatus();
+      return;
+    }
+    std::unique_ptr<WritableFile> file(sw.GetValue());
+    Status s = file->Append(sample);
+    if (s.IsOK()) {
+      s = file->Close();
+    }
+    if (!s.IsOK()) {
+      LOG(WARNING) << "ContinuousProfiler: failed to dump heap to " << fname << ": " << s;
+    }
+  }
+#endif
+
+  // The names sort by time, the oldest come first.
+  void removeOldProfiles(const std::string &kind) {
+    std::vector<std::string> children;
+    Status s = Env::Default()->GetChildren(options_.profile_dir, &children);
+    if (!s.IsOK()) {
+      LOG(WARNING) << "ContinuousProfiler: " << s;
+      return;
+    }
+
+    std::vector<std::string> profiles;
+    for (const auto &c : children) {
+      if (c.compare(0, kind.size(), kind) == 0) {
+        profiles.push_back(c);
+      }
+    }
+    if (profiles.size() <= options_.max_profiles) {
+      return;
+    }
+
+    std::sort(profiles.begin(), profiles.end());
+    for (size_t i = 0; i + options_.max_profiles < profiles.size(); i++) {
+      s = Env::Default()->DeleteFile(path(profiles[i]));
+      if (!s.IsOK()) {
+        LOG(WARNING) << "ContinuousProfiler: " << s;
+      }
+    }
+  }
+
+  // Returns false if the profiler is stopped before `deadline`.
+  bool sleepUntil(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mu_);
+    return !cond_.wait_until(lock, deadline, [this]() { return stopped_; });
+  }
+
+  std::string path(const std::string &fname) const {
+    return options_.profile_dir + "/" + fname;
+  }
+
+  static std::string timestamp() {
+    auto now = std::chrono::system_clock::now();
+    time_t secs = std::chrono::system_clock::to_time_t(now);
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      now.time_since_epoch()).count() % 1000;
+
+    struct tm t;
+    localtime_r(&secs, &t);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y%m%d-%H%M%S", &t);
+    return fmt::format("{}.{:03d}", buf, millis);
+  }
+
+ private:
+  const ProfilerOptions options_;
+
+  std::mutex mu_;
+  std::condition_variable cond_;
+  bool stopped_;
+
+  std::thread thread_;
+};
+
+StatusWith<ContinuousProfiler *> ContinuousProfiler::New(const ProfilerOptions &options) {
+  RETURN_NOT_OK(options.Validate());
+#ifndef CONSENSUS_WITH_GPERFTOOLS
+  if (options.cpu_profile || options.heap_profile) {
+    return FMT_Status(NotSupported,
+                      "cpu and heap profiling require the library built WITH_GPERFTOOLS");
+  }
+#endif
+  RETURN_NOT_OK(Env::Default()->CreateDirIfMissing(options.profile_dir));
+
+  auto profiler = new ContinuousProfiler;
+  profiler->impl_.reset(new Impl(options));
+  profiler->impl_->Start();
+  return profiler;
+}
+
+ContinuousProfiler::~ContinuousProfiler() {
+  impl_->Stop();
+}
+
+ProfilerOptions::ProfilerOptions()
+    : cpu_profile(false),
+      heap_profile(false),
+      contention_profile(false),
+      profile_duration(30 * 1000),
+      profile_interval(10 * 60 * 1000),
+      max_profiles(24) {}
+
+Status ProfilerOptions::Validate() const {
+  if (profile_dir.empty()) {
+    return FMT_Status(BadConfig, "ProfilerOptions::profile_dir should not be empty");
+  }
+  if (profile_duration == 0 || profile_interval < profile_duration) {
+    return FMT_Status(BadConfig,
+                      "ProfilerOptions::profile_interval ({}) should be no less than "
+                      "profile_duration ({}), which should be positive",
+                      profile_interval, profile_duration);
+  }
+  if (max_profiles == 0) {
+    return FMT_Status(BadConfig, "ProfilerOptions::max_profiles should be positive");
+  }
+  return Status::OK();
+}
+
+}  // namespace consensus
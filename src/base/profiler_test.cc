@@ -0,0 +1,70 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "base/env.h"
+#include "base/profiler.h"
+#include "base/testing.h"
+
+using namespace consensus;
+
+class ProfilerTest : public BaseTest {};
+
+TEST_F(ProfilerTest, Validate) {
+  ProfilerOptions options;
+  ASSERT_EQ(options.Validate().Code(), Error::BadConfig);
+
+  options.profile_dir = GetTestDir();
+  ASSERT_OK(options.Validate());
+
+  options.profile_interval = options.profile_duration - 1;
+  ASSERT_EQ(options.Validate().Code(), Error::BadConfig);
+}
+
+// This test verifies that only the latest `max_profiles` profiles are kept.
+TEST_F(ProfilerTest, RemoveOldProfiles) {
+  TestDirGuard g(CreateTestDirGuard());
+
+  std::vector<std::string> old = {"contention.20170101-000000.000.prof",
+                                  "contention.20170101-000001.000.prof",
+                                  "contention.20170101-000002.000.prof"};
+  for (const auto &f : old) {
+    delete OpenFileForWrite(GetTestDir() + "/" + f);
+  }
+
+  ProfilerOptions options;
+  options.profile_dir = GetTestDir();
+  options.contention_profile = true;
+  options.profile_duration = 10;
+  options.profile_interval = 10 * 1000;
+  options.max_profiles = 2;
+  // the first round runs at once, and completes even if it's cut short.
+  ContinuousProfiler *profiler;
+  ASSIGN_IF_ASSERT_OK(ContinuousProfiler::New(options), profiler);
+  delete profiler;
+
+  std::vector<std::string> children;
+  ASSERT_OK(Env::Default()->GetChildren(GetTestDir(), &children));
+  std::vector<std::string> profiles;
+  for (const auto &c : children) {
+    if (c.find("contention.") == 0) {
+      profiles.push_back(c);
+    }
+  }
+  std::sort(profiles.begin(), profiles.end());
+  ASSERT_EQ(profiles.size(), 2);
+  ASSERT_NE(profiles[0], old[0]);
+  ASSERT_NE(profiles[0], old[1]);
+}
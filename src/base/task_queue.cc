@@ -17,13 +17,19 @@
 #include "base/logging.h"
 #include "concurrentqueue/blockingconcurrentqueue.h"
 
+#include <bvar/bvar.h>
+
 namespace consensus {
 
+// the number of tasks waiting in all the queues of the process.
+static bvar::Adder<int64_t> g_task_queue_depth("consensus_task_queue_depth");
+
 class TaskQueue::Impl {
   using Runnable = std::function<void()>;
 
  public:
   void Enqueue(Runnable task) {
+    g_task_queue_depth << 1;
     queue_.enqueue(task);
   }
 
@@ -31,6 +37,7 @@ class TaskQueue::Impl {
     FATAL_NOT_OK(worker_.StartLoop([&]() {
       Runnable task;
       if (queue_.wait_dequeue_timed(task, std::chrono::milliseconds(50))) {
+        g_task_queue_depth << -1;
         task();
       }
     }),
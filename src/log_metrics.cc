@@ -0,0 +1,185 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <map>
+
+#include "log_metrics.h"
+
+#include <bvar/bvar.h>
+#include <fmt/format.h>
+
+namespace consensus {
+
+class LogMetrics::Impl {
+ public:
+  Impl(const std::string &prefix, const std::vector<uint64_t> &peers)
+      : readySecond_(prefix + "_ready_second", &readies_),
+        inflightWrites_(prefix + "_inflight_writes", &Impl::getInflightWrites, this),
+        commitIndex_(prefix + "_commit_index", &Impl::getCommitIndex, this) {
+    for (uint64_t id : peers) {
+      std::unique_ptr<Follower> f(new Follower);
+      f->impl = this;
+      f->id = id;
+      f->lag.reset(new bvar::PassiveStatus<uint64_t>(
+          fmt::format("{}_follower{}_commit_lag", prefix, id), &Impl::getCommitLag, f.get()));
+      followers_[id] = std::move(f);
+    }
+  }
+
+  void OnProposed(uint64_t index) {
+    lastProposed_.store(index, std::memory_order_relaxed);
+  }
+
+  void OnMessageStepped(const yaraft::pb::Message &msg) {
+    if (msg.type() != yaraft::pb::MsgAppResp || msg.reject()) {
+      return;
+    }
+    auto it = followers_.find(msg.from());
+    if (it != followers_.end()) {
+      it->second->match.store(msg.index(), std::memory_order_relaxed);
+    }
+  }
+
+  void OnMessagesSent(const std::vector<yaraft::pb::Message> &msgs) {
+    for (const auto &m : msgs) {
+      if (m.type() != yaraft::pb::MsgApp) {
+        continue;
+      }
+      auto it = followers_.find(m.to());
+      if (it == followers_.end()) {
+        continue;
+      }
+      uint64_t last = m.entries_size() > 0 ? m.entries(m.entries_size() - 1).index() : m.index();
+      it->second->next.store(last + 1, std::memory_order_relaxed);
+    }
+  }
+
+  void OnReady(bool isLeader, uint64_t commitIndex) {
+    readies_ << 1;
+    isLeader_.store(isLeader, std::memory_order_relaxed);
+    if (commitIndex > 0) {
+      committed_.store(commitIndex, std::memory_order_relaxed);
+    }
+  }
+
+  uint64_t InflightWrites() const {
+    uint64_t proposed = lastProposed_.load(std::memory_order_relaxed);
+    uint64_t committed = committed_.load(std::memory_order_relaxed);
+    return proposed > committed ? proposed - committed : 0;
+  }
+
+  uint64_t CommitIndex() const {
+    return committed_.load(std::memory_order_relaxed);
+  }
+
+  std::vector<FollowerProgress> Followers() const {
+    std::vector<FollowerProgress> progress;
+    if (!isLeader_.load(std::memory_order_relaxed)) {
+      return progress;
+    }
+    for (const auto &e : followers_) {
+      FollowerProgress p;
+      p.id = e.first;
+      p.match = e.second->match.load(std::memory_order_relaxed);
+      p.next = e.second->next.load(std::memory_order_relaxed);
+      progress.push_back(p);
+    }
+    return progress;
+  }
+
+  uint64_t CommitLag(uint64_t peer) const {
+    auto it = followers_.find(peer);
+    if (it == followers_.end() || !isLeader_.load(std::memory_order_relaxed)) {
+      return 0;
+    }
+    uint64_t match = it->second->match.load(std::memory_order_relaxed);
+    uint64_t committed = committed_.load(std::memory_order_relaxed);
+    return committed > match ? committed - match : 0;
+  }
+
+ private:
+  struct Follower {
+    Impl *impl;
+    uint64_t id;
+    std::atomic<uint64_t> match{0};
+    std::atomic<uint64_t> next{0};
+    std::unique_ptr<bvar::PassiveStatus<uint64_t>> lag;
+  };
+
+  static uint64_t getInflightWrites(void *arg) {
+    return static_cast<Impl *>(arg)->InflightWrites();
+  }
+
+  static uint64_t getCommitIndex(void *arg) {
+    return static_cast<Impl *>(arg)->CommitIndex();
+  }
+
+  static uint64_t getCommitLag(void *arg) {
+    auto f = static_cast<Follower *>(arg);
+    return f->impl->CommitLag(f->id);
+  }
+
+ private:
+  std::atomic<uint64_t> lastProposed_{0};
+  std::atomic<uint64_t> committed_{0};
+  std::atomic<bool> isLeader_{false};
+
+  // the followers are fixed after construction, no lock is needed.
+  std::map<uint64_t, std::unique_ptr<Follower>> followers_;
+
+  bvar::Adder<int64_t> readies_;
+  bvar::PerSecond<bvar::Adder<int64_t>> readySecond_;
+  bvar::PassiveStatus<uint64_t> inflightWrites_;
+  bvar::PassiveStatus<uint64_t> commitIndex_;
+};
+
+LogMetrics::LogMetrics(const std::string &prefix, const std::vector<uint64_t> &peers)
+    : impl_(new Impl(prefix, peers)) {}
+
+LogMetrics::~LogMetrics() = default;
+
+void LogMetrics::OnProposed(uint64_t index) {
+  impl_->OnProposed(index);
+}
+
+void LogMetrics::OnMessageStepped(const yaraft::pb::Message &msg) {
+  impl_->OnMessageStepped(msg);
+}
+
+void LogMetrics::OnMessagesSent(const std::vector<yaraft::pb::Message> &msgs) {
+  impl_->OnMessagesSent(msgs);
+}
+
+void LogMetrics::OnReady(bool isLeader, uint64_t commitIndex) {
+  impl_->OnReady(isLeader, commitIndex);
+}
+
+uint64_t LogMetrics::InflightWrites() const {
+  return impl_->InflightWrites();
+}
+
+uint64_t LogMetrics::CommitIndex() const {
+  return impl_->CommitIndex();
+}
+
+std::vector<LogMetrics::FollowerProgress> LogMetrics::Followers() const {
+  return impl_->Followers();
+}
+
+uint64_t LogMetrics::CommitLag(uint64_t peer) const {
+  return impl_->CommitLag(peer);
+}
+
+}  // namespace consensus
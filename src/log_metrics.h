@@ -0,0 +1,90 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <silly/disallow_copying.h>
+#include <yaraft/pb/raftpb.pb.h>
+
+namespace consensus {
+
+// LogMetrics exports the state of a ReplicatedLog as bvars named "<prefix>_<metric>",
+// see /vars of the brpc server:
+//
+//   ready_second:              the rate of Readies flushed.
+//   inflight_writes:           the entries proposed by this node but not yet committed.
+//   commit_index:              the last committed index.
+//   follower<id>_commit_lag:   how far the log of a follower falls behind the commit
+//                              index, only the leader reports it.
+//
+// The metrics of the components shared by the logs, e.g the WAL and the TaskQueue,
+// are process-wide, prefixed by "consensus_".
+//
+// Thread-Safe
+class LogMetrics {
+  __DISALLOW_COPYING__(LogMetrics);
+
+ public:
+  // `peers` are the members of the cluster besides this node.
+  LogMetrics(const std::string &prefix, const std::vector<uint64_t> &peers);
+
+  ~LogMetrics();
+
+  // This node proposed the entry at `index`.
+  // ONLY the raft thread is allowed to call this function.
+  void OnProposed(uint64_t index);
+
+  // Tracks the progress of the followers from their MsgAppResp.
+  // ONLY the raft thread is allowed to call this function.
+  void OnMessageStepped(const yaraft::pb::Message &msg);
+
+  // Tracks the entries sent to the followers by MsgApp.
+  // ONLY the flusher thread is allowed to call this function.
+  void OnMessagesSent(const std::vector<yaraft::pb::Message> &msgs);
+
+  // A Ready is flushed, `commitIndex` is 0 if it doesn't advance the commit index.
+  // ONLY the flusher thread is allowed to call this function.
+  void OnReady(bool isLeader, uint64_t commitIndex);
+
+  uint64_t InflightWrites() const;
+
+  uint64_t CommitIndex() const;
+
+  // Returns 0 if this node isn't the leader.
+  uint64_t CommitLag(uint64_t peer) const;
+
+  struct FollowerProgress {
+    uint64_t id;
+
+    // the last index the follower has acknowledged.
+    uint64_t match;
+
+    // the index after the last entry sent to the follower.
+    uint64_t next;
+  };
+
+  // Returns empty if this node isn't the leader. The progress may be left by an
+  // earlier term, until the follower responds to the current leader.
+  std::vector<FollowerProgress> Followers() const;
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace consensus
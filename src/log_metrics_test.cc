@@ -0,0 +1,95 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/testing.h"
+#include "log_metrics.h"
+
+using namespace consensus;
+
+static yaraft::pb::Message appResp(uint64_t from, uint64_t index, bool reject = false) {
+  yaraft::pb::Message m;
+  m.set_type(yaraft::pb::MsgAppResp);
+  m.set_from(from);
+  m.set_index(index);
+  m.set_reject(reject);
+  return m;
+}
+
+TEST(LogMetricsTest, InflightWrites) {
+  LogMetrics metrics("log_metrics_test_inflight", {2, 3});
+  ASSERT_EQ(metrics.InflightWrites(), 0);
+
+  metrics.OnProposed(5);
+  ASSERT_EQ(metrics.InflightWrites(), 5);
+
+  metrics.OnReady(true, 3);
+  ASSERT_EQ(metrics.InflightWrites(), 2);
+
+  // a Ready not advancing the commit index.
+  metrics.OnReady(true, 0);
+  ASSERT_EQ(metrics.InflightWrites(), 2);
+
+  metrics.OnReady(true, 5);
+  ASSERT_EQ(metrics.InflightWrites(), 0);
+}
+
+static yaraft::pb::Message app(uint64_t to, uint64_t index, uint64_t numEntries) {
+  yaraft::pb::Message m;
+  m.set_type(yaraft::pb::MsgApp);
+  m.set_to(to);
+  m.set_index(index);
+  for (uint64_t i = 1; i <= numEntries; i++) {
+    m.add_entries()->set_index(index + i);
+  }
+  return m;
+}
+
+TEST(LogMetricsTest, Followers) {
+  LogMetrics metrics("log_metrics_test_followers", {2, 3});
+  ASSERT_TRUE(metrics.Followers().empty());
+
+  metrics.OnReady(true, 0);
+  metrics.OnMessagesSent({app(2, 5, 3), app(3, 5, 0)});
+  metrics.OnMessageStepped(appResp(2, 5));
+
+  auto followers = metrics.Followers();
+  ASSERT_EQ(followers.size(), 2);
+  ASSERT_EQ(followers[0].id, 2);
+  ASSERT_EQ(followers[0].match, 5);
+  ASSERT_EQ(followers[0].next, 9);
+  ASSERT_EQ(followers[1].id, 3);
+  ASSERT_EQ(followers[1].match, 0);
+  ASSERT_EQ(followers[1].next, 6);
+}
+
+TEST(LogMetricsTest, CommitLag) {
+  LogMetrics metrics("log_metrics_test_commit_lag", {2, 3});
+  metrics.OnReady(true, 10);
+  ASSERT_EQ(metrics.CommitLag(2), 10);
+
+  metrics.OnMessageStepped(appResp(2, 8));
+  metrics.OnMessageStepped(appResp(3, 10));
+  ASSERT_EQ(metrics.CommitLag(2), 2);
+  ASSERT_EQ(metrics.CommitLag(3), 0);
+
+  // rejections and unknown peers are ignored.
+  metrics.OnMessageStepped(appResp(2, 4, true));
+  metrics.OnMessageStepped(appResp(4, 1));
+  ASSERT_EQ(metrics.CommitLag(2), 2);
+  ASSERT_EQ(metrics.CommitLag(4), 0);
+
+  // only the leader reports the lag.
+  metrics.OnReady(false, 0);
+  ASSERT_EQ(metrics.CommitLag(2), 0);
+}
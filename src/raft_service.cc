@@ -12,13 +12,22 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <map>
+#include <mutex>
+
 #include "raft_service.h"
 #include "raft_task_executor.h"
 #include "raft_timer.h"
+#include "replicated_log_impl.h"
 
 #include "base/logging.h"
 #include "base/simple_channel.h"
+#include "rpc/message_codec.h"
 
+#include <brpc/closure_guard.h>
+#include <brpc/controller.h>
+#include <brpc/stream.h>
+#include <butil/iobuf.h>
 #include <yaraft/pb_utils.h>
 
 namespace consensus {
@@ -35,17 +44,94 @@ static pb::StatusCode yaraftErrorCodeToRpcStatusCode(yaraft::Error::ErrorCodes c
   }
 }
 
+// StepStreamHandler steps the messages received from a stream into RawNode.
+// Each MsgApp is acked back through the stream once it has been stepped, so that the
+// leader can release a slot of its inflight window.
+// The handler deletes itself once the stream is closed.
+class StepStreamHandler : public brpc::StreamInputHandler {
+ public:
+  explicit StepStreamHandler(RaftTaskExecutor *executor) : executor_(executor) {}
+
+  int on_received_messages(brpc::StreamId id, butil::IOBuf *const messages[],
+                           size_t size) override {
+    for (size_t i = 0; i < size; i++) {
+      auto msg = std::make_shared<yaraft::pb::Message>();
+      Status s = rpc::DecodeMessage(messages[i], msg.get());
+      if (UNLIKELY(!s.IsOK())) {
+        LOG(ERROR) << "StepStreamHandler: unable to decode message: " << s.ToString();
+        continue;
+      }
+
+      // the executor runs tasks sequentially, so the order of messages is preserved.
+      RaftTaskExecutor *executor = executor_;
+      executor_->Submit([id, msg, executor](yaraft::RawNode *node) {
+        auto s = executor->Step(node, *msg);
+        if (UNLIKELY(!s.IsOK())) {
+          LOG(WARNING) << "StepStreamHandler: RawNode::Step failed: " << s.ToString();
+        }
+        if (msg->type() == yaraft::pb::MsgApp) {
+          ackAppend(id, *msg);
+        }
+      });
+    }
+    return 0;
+  }
+
+  void on_idle_timeout(brpc::StreamId id) override {}
+
+  void on_closed(brpc::StreamId id) override {
+    delete this;
+  }
+
+ private:
+  static void ackAppend(brpc::StreamId id, const yaraft::pb::Message &msg) {
+    pb::StepStreamAck ack;
+    if (msg.entries_size() > 0) {
+      ack.set_index(msg.entries(msg.entries_size() - 1).index());
+    } else {
+      ack.set_index(msg.index());
+    }
+
+    butil::IOBuf buf;
+    butil::IOBufAsZeroCopyOutputStream wrapper(&buf);
+    ack.SerializeToZeroCopyStream(&wrapper);
+
+    // the stream may have been closed, in which case the leader no longer waits for
+    // this ack.
+    brpc::StreamWrite(id, buf);
+  }
+
+ private:
+  RaftTaskExecutor *executor_;
+};
+
+struct RaftServiceImpl::Group {
+  RaftTaskExecutor *executor;
+
+  // nullptr if ReadIndex is not served, neither is the status beyond RawNode.
+  ReplicatedLog *log;
+
+  std::unique_ptr<SnapshotReceiver> snapshotReceiver;
+};
+
 void RaftServiceImpl::Step(google::protobuf::RpcController *controller,
                            const pb::StepRequest *request, pb::StepResponse *response,
                            google::protobuf::Closure *done) {
   yaraft::pb::Message *msg = const_cast<pb::StepRequest *>(request)->mutable_message();
 
+  Group *group = findGroup(request->group());
+  if (!group) {
+    response->set_code(pb::GroupNotFound);
+    done->Run();
+    return;
+  }
   response->set_code(pb::OK);
 
+  RaftTaskExecutor *executor = group->executor;
   Barrier barrier;
-  executor_->Submit(std::bind(
+  executor->Submit(std::bind(
       [&](yaraft::RawNode *node) {
-        auto s = node->Step(*msg);
+        auto s = executor->Step(node, *msg);
         if (UNLIKELY(!s.IsOK())) {
           response->set_code(yaraftErrorCodeToRpcStatusCode(s.Code()));
         }
@@ -57,11 +143,150 @@ void RaftServiceImpl::Step(google::protobuf::RpcController *controller,
   done->Run();
 }
 
+// SnapshotReceiver assembles the snapshots being transferred to this node, one for
+// each sender.
+class SnapshotReceiver {
+ public:
+  explicit SnapshotReceiver(RaftTaskExecutor *executor) : executor_(executor) {}
+
+  void Receive(const pb::InstallSnapshotRequest &request, const butil::IOBuf &chunk,
+               pb::InstallSnapshotResponse *response) {
+    std::lock_guard<std::mutex> g(mu_);
+
+    Transfer &t = transfers_[request.from()];
+    if (t.term != request.term() || t.index != request.index()) {
+      // a new snapshot supersedes the incomplete one.
+      t.term = request.term();
+      t.index = request.index();
+      t.data.clear();
+    }
+
+    if (request.offset() != t.data.size()) {
+      FMT_LOG(WARNING, "SnapshotReceiver: chunk from {} out of order [offset: {}, expected: {}]",
+              request.from(), request.offset(), t.data.size());
+      response->set_code(pb::SnapshotChunkRejected);
+      response->set_next_offset(t.data.size());
+      return;
+    }
+    if (rpc::ChecksumIOBuf(chunk) != request.checksum()) {
+      FMT_LOG(WARNING, "SnapshotReceiver: chunk from {} corrupted [offset: {}]", request.from(),
+              request.offset());
+      response->set_code(pb::SnapshotChunkRejected);
+      response->set_next_offset(t.data.size());
+      return;
+    }
+
+    t.data.append(chunk);
+    response->set_code(pb::OK);
+    response->set_next_offset(t.data.size());
+
+    if (request.has_message()) {
+      auto msg = std::make_shared<yaraft::pb::Message>(request.message());
+      msg->mutable_snapshot()->set_data(t.data.to_string());
+      transfers_.erase(request.from());
+
+      FMT_LOG(INFO, "SnapshotReceiver: received snapshot [term: {}, index: {}, size: {}] from {}",
+              request.term(), request.index(), msg->snapshot().data().size(), request.from());
+      RaftTaskExecutor *executor = executor_;
+      executor_->Submit([msg, executor](yaraft::RawNode *node) {
+        auto s = executor->Step(node, *msg);
+        if (UNLIKELY(!s.IsOK())) {
+          LOG(WARNING) << "SnapshotReceiver: RawNode::Step failed: " << s.ToString();
+        }
+      });
+    }
+  }
+
+ private:
+  struct Transfer {
+    uint64_t term;
+    uint64_t index;
+    butil::IOBuf data;
+
+    Transfer() : term(0), index(0) {}
+  };
+
+  RaftTaskExecutor *executor_;
+
+  std::mutex mu_;
+  std::map<uint64_t, Transfer> transfers_;
+};
+
+RaftServiceImpl::RaftServiceImpl(RaftTaskExecutor *executor) {
+  addGroup(0, executor, nullptr);
+}
+
+RaftServiceImpl::RaftServiceImpl(ReplicatedLog *log) {
+  AddGroup(log);
+}
+
+RaftServiceImpl::RaftServiceImpl() = default;
+
+void RaftServiceImpl::AddGroup(ReplicatedLog *log) {
+  addGroup(log->GroupId(), log->RaftTaskExecutorInstance(), log);
+}
+
+void RaftServiceImpl::addGroup(uint64_t id, RaftTaskExecutor *executor, ReplicatedLog *log) {
+  std::unique_ptr<Group> &group = groups_[id];
+  if (group) {
+    LOG(FATAL) << "RaftServiceImpl: group " << id << " is added twice";
+  }
+  group.reset(new Group);
+  group->executor = executor;
+  group->log = log;
+  group->snapshotReceiver.reset(new SnapshotReceiver(executor));
+}
+
+RaftServiceImpl::Group *RaftServiceImpl::findGroup(uint64_t id) const {
+  auto it = groups_.find(id);
+  return it == groups_.end() ? nullptr : it->second.get();
+}
+
+void RaftServiceImpl::ReadIndex(::google::protobuf::RpcController *controller,
+                                const pb::ReadIndexRequest *request,
+                                pb::ReadIndexResponse *response,
+                                ::google::protobuf::Closure *done) {
+  brpc::ClosureGuard doneGuard(done);
+
+  Group *group = findGroup(request->group());
+  if (!group) {
+    response->set_code(pb::GroupNotFound);
+    response->set_message(fmt::format("group {} is not served by this node", request->group()));
+    return;
+  }
+  if (!group->log) {
+    response->set_code(pb::ReadIndexFailed);
+    response->set_message("ReadIndex is not served by this node");
+    return;
+  }
+
+  StatusWith<uint64_t> sw = group->log->impl_->ReadIndex();
+  if (!sw.IsOK()) {
+    response->set_code(pb::ReadIndexFailed);
+    response->set_message(sw.GetStatus().ToString());
+    return;
+  }
+  response->set_code(pb::OK);
+  response->set_read_index(sw.GetValue());
+}
+
+RaftServiceImpl::~RaftServiceImpl() = default;
+
 void RaftServiceImpl::Status(::google::protobuf::RpcController *controller,
                              const pb::StatusRequest *request, pb::StatusResponse *response,
                              ::google::protobuf::Closure *done) {
+  brpc::ClosureGuard doneGuard(done);
+  auto cntl = static_cast<brpc::Controller *>(controller);
+
+  Group *group = findGroup(request->group());
+  if (!group) {
+    cntl->SetFailed(fmt::format("group {} is not served by this node", request->group()));
+    return;
+  }
+
+  // only what RawNode owns is read on the raft thread.
   Barrier barrier;
-  executor_->Submit(std::bind(
+  group->executor->Submit(std::bind(
       [&](yaraft::RawNode *node) {
         response->set_leader(node->LeaderHint());
         response->set_raftindex(node->LastIndex());
@@ -72,7 +297,53 @@ void RaftServiceImpl::Status(::google::protobuf::RpcController *controller,
       std::placeholders::_1));
   barrier.Wait();
 
-  done->Run();
+  if (group->log) {
+    group->log->impl_->GetStatus(response);
+  }
+}
+
+void RaftServiceImpl::StepStream(::google::protobuf::RpcController *controller,
+                                 const pb::StepStreamRequest *request,
+                                 pb::StepStreamResponse *response,
+                                 ::google::protobuf::Closure *done) {
+  brpc::ClosureGuard doneGuard(done);
+  auto cntl = static_cast<brpc::Controller *>(controller);
+
+  Group *group = findGroup(request->group());
+  if (!group) {
+    response->set_code(pb::GroupNotFound);
+    return;
+  }
+
+  auto handler = new StepStreamHandler(group->executor);
+  brpc::StreamOptions options;
+  options.handler = handler;
+
+  brpc::StreamId stream;
+  if (brpc::StreamAccept(&stream, *cntl, &options) != 0) {
+    delete handler;
+    cntl->SetFailed("failed to accept stream");
+    return;
+  }
+  response->set_code(pb::OK);
+
+  // Frames of every CompressType are decodable, any known compression requested is accepted.
+  response->set_compress_type(request->compress_type());
+}
+
+void RaftServiceImpl::InstallSnapshot(::google::protobuf::RpcController *controller,
+                                      const pb::InstallSnapshotRequest *request,
+                                      pb::InstallSnapshotResponse *response,
+                                      ::google::protobuf::Closure *done) {
+  brpc::ClosureGuard doneGuard(done);
+  auto cntl = static_cast<brpc::Controller *>(controller);
+
+  Group *group = findGroup(request->group());
+  if (!group) {
+    response->set_code(pb::GroupNotFound);
+    return;
+  }
+  group->snapshotReceiver->Receive(*request, cntl->request_attachment(), response);
 }
 
 }  // namespace consensus
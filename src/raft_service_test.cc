@@ -12,8 +12,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "base/simple_channel.h"
 #include "raft_service.h"
 #include "raft_task_executor_test.h"
+#include "rpc/message_codec.h"
+
+#include <brpc/controller.h>
 
 using namespace consensus;
 
@@ -43,4 +47,78 @@ TEST_F(RaftServiceTest, Step) {
   done = google::protobuf::NewCallback([]() {});
   service.Step(nullptr, &request, &response, done);
   ASSERT_EQ(response.code(), pb::StepPeerNotFound);
-}
\ No newline at end of file
+}
+
+TEST_F(RaftServiceTest, InstallSnapshot) {
+  conf_->id = 2;
+  yaraft::RawNode node(conf_);
+  RaftTaskExecutor executor(&node, taskQueue_);
+  RaftServiceImpl service(&executor);
+
+  std::string data(1000, 'a');
+
+  auto installChunk = [&](uint64_t offset, size_t len, bool last, uint32_t checksum = 0) {
+    brpc::Controller cntl;
+    cntl.request_attachment().append(data.data() + offset, len);
+
+    pb::InstallSnapshotRequest request;
+    request.set_from(1);
+    request.set_term(2);
+    request.set_index(10);
+    request.set_offset(offset);
+    request.set_checksum(checksum ? checksum : rpc::ChecksumIOBuf(cntl.request_attachment()));
+    if (last) {
+      auto msg = request.mutable_message();
+      msg->set_type(yaraft::pb::MsgSnap);
+      msg->set_from(1);
+      msg->set_to(2);
+      msg->set_term(2);
+      msg->mutable_snapshot()->mutable_metadata()->set_term(2);
+      msg->mutable_snapshot()->mutable_metadata()->set_index(10);
+    }
+
+    pb::InstallSnapshotResponse response;
+    service.InstallSnapshot(&cntl, &request, &response, google::protobuf::NewCallback([]() {}));
+    return response;
+  };
+
+  // out of order
+  auto resp = installChunk(500, 500, true);
+  ASSERT_EQ(resp.code(), pb::SnapshotChunkRejected);
+  ASSERT_EQ(resp.next_offset(), 0);
+
+  resp = installChunk(0, 500, false);
+  ASSERT_EQ(resp.code(), pb::OK);
+  ASSERT_EQ(resp.next_offset(), 500);
+
+  // corrupted
+  resp = installChunk(500, 500, true, 12345);
+  ASSERT_EQ(resp.code(), pb::SnapshotChunkRejected);
+  ASSERT_EQ(resp.next_offset(), 500);
+
+  resp = installChunk(500, 500, true);
+  ASSERT_EQ(resp.code(), pb::OK);
+  ASSERT_EQ(resp.next_offset(), 1000);
+
+  // the MsgSnap has been stepped.
+  Barrier barrier;
+  uint64_t term = 0;
+  executor.Submit([&](yaraft::RawNode *n) {
+    term = n->CurrentTerm();
+    barrier.Signal();
+  });
+  barrier.Wait();
+  ASSERT_EQ(term, 2);
+}
+
+TEST_F(RaftServiceTest, ReadIndexNotServed) {
+  yaraft::RawNode node(conf_);
+  RaftTaskExecutor executor(&node, taskQueue_);
+  RaftServiceImpl service(&executor);
+
+  pb::ReadIndexRequest request;
+  pb::ReadIndexResponse response;
+  auto done = google::protobuf::NewCallback([]() {});
+  service.ReadIndex(nullptr, &request, &response, done);
+  ASSERT_EQ(response.code(), pb::ReadIndexFailed);
+}
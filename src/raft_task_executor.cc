@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "base/logging.h"
 #include "base/simple_channel.h"
 
 #include "raft_task_executor.h"
@@ -29,4 +30,46 @@ yaraft::Ready *RaftTaskExecutor::GetReady() {
   return rd;
 }
 
+void RaftTaskExecutor::ReportSnapshot(yaraft::RawNode *node, uint64_t to, bool failed) {
+  yaraft::pb::Message msg;
+  msg.set_type(yaraft::pb::MsgSnapStatus);
+  msg.set_from(to);
+  msg.set_to(node->Id());
+  msg.set_reject(failed);
+
+  yaraft::Status s = node->Step(msg);
+  if (UNLIKELY(!s.IsOK())) {
+    FMT_LOG(WARNING, "RaftTaskExecutor: failed to report snapshot status of {}: {}", to,
+            s.ToString());
+  }
+}
+
+bool RaftTaskExecutor::refuseVote(yaraft::RawNode *node, const yaraft::pb::Message &msg) const {
+  if (voteGuard_.count() == 0 || msg.type() != yaraft::pb::MsgVote) {
+    return false;
+  }
+  if (msg.term() <= node->CurrentTerm() || node->IsLeader() || node->LeaderHint() == 0) {
+    return false;
+  }
+  return std::chrono::steady_clock::now() - leaderHeardAt_ < voteGuard_;
+}
+
+void RaftTaskExecutor::recordLeaderHeard(yaraft::RawNode *node,
+                                         const yaraft::pb::Message &msg) {
+  if (voteGuard_.count() == 0) {
+    return;
+  }
+  switch (msg.type()) {
+    case yaraft::pb::MsgApp:
+    case yaraft::pb::MsgHeartbeat:
+    case yaraft::pb::MsgSnap:
+      if (msg.from() == node->LeaderHint()) {
+        leaderHeardAt_ = std::chrono::steady_clock::now();
+      }
+      break;
+    default:
+      break;
+  }
+}
+
 }  // namespace consensus
\ No newline at end of file
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <chrono>
+
 #include "base/task_queue.h"
 
 #include <yaraft/raw_node.h>
@@ -27,7 +29,12 @@ namespace consensus {
 //
 class RaftTaskExecutor {
  public:
-  RaftTaskExecutor(yaraft::RawNode* node, TaskQueue* taskQueue) : node_(node), queue_(taskQueue) {}
+  RaftTaskExecutor(yaraft::RawNode* node, TaskQueue* taskQueue)
+      : node_(node), queue_(taskQueue), voteGuard_(0) {}
+
+  // The queue may be shared with other executors.
+  RaftTaskExecutor(yaraft::RawNode* node, std::shared_ptr<TaskQueue> taskQueue)
+      : node_(node), queue_(std::move(taskQueue)), voteGuard_(0) {}
 
   typedef std::function<void(yaraft::RawNode* node)> RaftTask;
 
@@ -35,11 +42,62 @@ class RaftTaskExecutor {
     queue_->Enqueue(std::bind(task, node_));
   }
 
+  typedef std::function<void(const yaraft::pb::Message& msg)> StepObserver;
+
+  // Steps a message received from a peer into RawNode, the observer is informed if
+  // the message is accepted. A vote request refused by the vote guard is dropped.
+  // ONLY allowed to be called within a RaftTask.
+  yaraft::Status Step(yaraft::RawNode* node, yaraft::pb::Message& msg) {
+    if (refuseVote(node, msg)) {
+      // as if the request is lost, the candidate campaigns again after its election timeout.
+      return yaraft::Status::OK();
+    }
+
+    yaraft::Status s = node->Step(msg);
+    if (s.IsOK()) {
+      recordLeaderHeard(node, msg);
+      if (observer_) {
+        observer_(msg);
+      }
+    }
+    return s;
+  }
+
+  // The observer runs in the raft thread. It must be set before any message is stepped.
+  void SetStepObserver(StepObserver observer) {
+    observer_ = std::move(observer);
+  }
+
+  // With the vote guard, a follower refuses the vote requests of higher terms within
+  // `window` after it last heard from its leader, like the CheckQuorum of etcd/raft.
+  // Once a majority has heard from the leader, no other node can be elected within
+  // `window`, which the leader lease relies on. Zero disables the guard.
+  // It must be set before any message is stepped.
+  void SetVoteGuard(std::chrono::milliseconds window) {
+    voteGuard_ = window;
+  }
+
+  // Informs RawNode of the result of a snapshot sent to peer `to` by stepping a
+  // MsgSnapStatus, like RawNode.ReportSnapshot of etcd/raft. The leader resumes
+  // replicating to the peer, or probes it and sends another snapshot if `failed`.
+  // ONLY allowed to be called within a RaftTask.
+  void ReportSnapshot(yaraft::RawNode* node, uint64_t to, bool failed);
+
   yaraft::Ready* GetReady();
 
+ private:
+  bool refuseVote(yaraft::RawNode* node, const yaraft::pb::Message& msg) const;
+
+  void recordLeaderHeard(yaraft::RawNode* node, const yaraft::pb::Message& msg);
+
  private:
   yaraft::RawNode* node_;
   std::shared_ptr<TaskQueue> queue_;
+  StepObserver observer_;
+
+  std::chrono::milliseconds voteGuard_;
+  // the last time a message from the leader is stepped.
+  std::chrono::steady_clock::time_point leaderHeardAt_;
 };
 
 }  // namespace consensus
\ No newline at end of file
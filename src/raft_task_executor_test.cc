@@ -51,4 +51,38 @@ TEST_F(RaftTaskExecutorTest, TasksInSequence) {
 
   ASSERT_EQ(s.length(), 300);
   ASSERT_EQ(s, std::string(300, 'a'));
-}
\ No newline at end of file
+}
+
+// This test verifies that a follower with the vote guard refuses to vote for a
+// candidate of a higher term after it has just heard from the leader.
+TEST_F(RaftTaskExecutorTest, VoteGuard) {
+  yaraft::RawNode node(conf_);
+  RaftTaskExecutor executor(&node, taskQueue_);
+  executor.SetVoteGuard(std::chrono::milliseconds(60 * 1000));
+
+  uint64_t leader, term;
+  Barrier barrier;
+  executor.Submit([&](yaraft::RawNode *n) {
+    yaraft::pb::Message heartbeat;
+    heartbeat.set_type(yaraft::pb::MsgHeartbeat);
+    heartbeat.set_from(2);
+    heartbeat.set_to(1);
+    heartbeat.set_term(2);
+    executor.Step(n, heartbeat);
+
+    yaraft::pb::Message vote;
+    vote.set_type(yaraft::pb::MsgVote);
+    vote.set_from(3);
+    vote.set_to(1);
+    vote.set_term(3);
+    executor.Step(n, vote);
+
+    leader = n->LeaderHint();
+    term = n->CurrentTerm();
+    barrier.Signal();
+  });
+  barrier.Wait();
+
+  ASSERT_EQ(leader, 2);
+  ASSERT_EQ(term, 2);
+}
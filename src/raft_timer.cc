@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <future>
 
 #include "raft_task_executor.h"
@@ -23,9 +24,15 @@
 
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/strand.hpp>
+#include <butil/time.h>
+#include <bvar/bvar.h>
 
 namespace consensus {
 
+// time (in microseconds) to tick all the registered logs in a round, which grows as
+// the raft thread gets busy.
+static bvar::LatencyRecorder g_timer_round("consensus_raft_timer_round");
+
 // Timeout granularity of timer in milli-seconds.
 static uint32_t kTimerGranularity = 100;
 
@@ -48,6 +55,7 @@ class RaftTimer::Impl {
       timer_.expires_from_now(boost::posix_time::milliseconds(kTimerGranularity));
       timer_.wait();
 
+      int64_t start = butil::cpuwide_time_us();
       std::lock_guard<std::mutex> g(mu_);
       for (auto& executor : executors_) {
         Barrier channel;
@@ -59,6 +67,7 @@ class RaftTimer::Impl {
         });
         channel.Wait();
       }
+      g_timer_round << butil::cpuwide_time_us() - start;
     });
   }
 
@@ -67,6 +76,12 @@ class RaftTimer::Impl {
     executors_.push_back(executor);
   }
 
+  void Unregister(RaftTaskExecutor* executor) {
+    std::lock_guard<std::mutex> g(mu_);
+    executors_.erase(std::remove(executors_.begin(), executors_.end(), executor),
+                     executors_.end());
+  }
+
  private:
   std::vector<RaftTaskExecutor*> executors_;
   std::mutex mu_;
@@ -89,4 +104,8 @@ void RaftTimer::Register(RaftTaskExecutor* executor) {
   impl_->Register(executor);
 }
 
+void RaftTimer::Unregister(RaftTaskExecutor* executor) {
+  impl_->Unregister(executor);
+}
+
 }  // namespace consensus
@@ -0,0 +1,304 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <mutex>
+
+#include "base/logging.h"
+
+#include "read_indexer.h"
+
+namespace consensus {
+
+class ReadIndexer::Impl {
+ public:
+  Impl(std::vector<uint64_t> peers, std::chrono::milliseconds lease)
+      : peers_(std::move(peers)), lease_(lease), term_(0) {
+    resetCounters();
+  }
+
+  void Request(uint64_t term, uint64_t commitIndex, ReadIndexCallback callback) {
+    std::vector<Completion> completions;
+    {
+      std::lock_guard<std::mutex> g(mu_);
+      resetTermIfNecessary(term, &completions);
+
+      if (rounds_.empty() || rounds_.back().started) {
+        Round round;
+        round.term = term;
+        round.sent = sent_;
+        rounds_.push_back(std::move(round));
+      }
+
+      Round &round = rounds_.back();
+      round.readIndex = std::max(round.readIndex, commitIndex);
+      round.callbacks.push_back(std::move(callback));
+
+      // a single-node cluster confirms by itself.
+      confirmRounds(&completions);
+    }
+    complete(&completions);
+  }
+
+  void OnMessagesSent(const std::vector<yaraft::pb::Message> &msgs) {
+    std::vector<Completion> completions;
+    const TimePoint now = Clock::now();
+    {
+      std::lock_guard<std::mutex> g(mu_);
+      for (const auto &m : msgs) {
+        if (m.type() != yaraft::pb::MsgHeartbeat || m.term() < term_) {
+          continue;
+        }
+        resetTermIfNecessary(m.term(), &completions);
+
+        auto it = sent_.find(m.to());
+        if (it != sent_.end()) {
+          it->second++;
+          if (lease_.count() > 0) {
+            recordSendTime(m.to(), now);
+          }
+
+          // any heartbeat sent afterwards is too late for the requests in the
+          // current round to be joined by new ones.
+          if (!rounds_.empty()) {
+            rounds_.back().started = true;
+          }
+        }
+      }
+    }
+    complete(&completions);
+  }
+
+  void OnMessageStepped(const yaraft::pb::Message &msg) {
+    std::vector<Completion> completions;
+    {
+      std::lock_guard<std::mutex> g(mu_);
+      if (msg.term() > term_) {
+        // a leader steps down once it sees a higher term.
+        resetTermIfNecessary(msg.term(), &completions);
+      } else if (msg.type() == yaraft::pb::MsgHeartbeatResp && msg.term() == term_) {
+        auto it = acked_.find(msg.from());
+        if (it != acked_.end()) {
+          it->second++;
+          if (lease_.count() > 0) {
+            recordAck(msg.from());
+          }
+          confirmRounds(&completions);
+        }
+      }
+    }
+    complete(&completions);
+  }
+
+  bool InLease(uint64_t term) {
+    if (lease_.count() == 0) {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> g(mu_);
+    if (term != term_) {
+      return false;
+    }
+    if (peers_.empty()) {
+      return true;
+    }
+
+    // the latest time by which a majority, including the leader itself, has heard
+    // from the leader. The followers among them refuse to vote for another node within
+    // an election timeout after that (see RaftTaskExecutor::SetVoteGuard), and `lease_`
+    // is shorter than an election timeout by the clock drift bound.
+    std::vector<TimePoint> heard;
+    for (uint64_t p : peers_) {
+      heard.push_back(heardAt_[p]);
+    }
+    size_t quorum = (peers_.size() + 1) / 2 + 1;
+    std::sort(heard.begin(), heard.end(), std::greater<TimePoint>());
+    TimePoint start = heard[quorum - 2];
+    if (start == TimePoint()) {
+      return false;
+    }
+    return Clock::now() < start + lease_;
+  }
+
+ private:
+  typedef std::map<uint64_t, uint64_t> CountMap;
+  typedef std::chrono::steady_clock Clock;
+  typedef Clock::time_point TimePoint;
+
+  // The send times of the heartbeats not yet acked by a peer.
+  struct SendTimes {
+    std::deque<TimePoint> times;
+
+    // the number of responses to ignore, for the send times dropped on overflow.
+    uint64_t skipped;
+
+    SendTimes() : skipped(0) {}
+  };
+
+  // A peer that never responds would otherwise accumulate the send times forever.
+  static const size_t kMaxUnackedHeartbeats = 1024;
+  struct Round {
+    uint64_t term;
+    uint64_t readIndex;
+
+    // the numbers of heartbeats sent to each peer when the round began.
+    CountMap sent;
+
+    // whether a heartbeat has been sent since the round began.
+    bool started;
+
+    std::vector<ReadIndexCallback> callbacks;
+
+    Round() : term(0), readIndex(0), started(false) {}
+  };
+
+  struct Completion {
+    Status status;
+    uint64_t readIndex;
+    std::vector<ReadIndexCallback> callbacks;
+  };
+
+  // REQUIRES: mu_ held
+  void resetTermIfNecessary(uint64_t term, std::vector<Completion> *completions) {
+    if (term == term_) {
+      return;
+    }
+
+    for (auto &round : rounds_) {
+      Completion c;
+      c.status = FMT_Status(NotLeader, "leadership of term {} is lost, now in term {}",
+                            round.term, term);
+      c.readIndex = 0;
+      c.callbacks = std::move(round.callbacks);
+      completions->push_back(std::move(c));
+    }
+    rounds_.clear();
+
+    term_ = term;
+    resetCounters();
+  }
+
+  // REQUIRES: mu_ held
+  void resetCounters() {
+    for (uint64_t p : peers_) {
+      sent_[p] = 0;
+      acked_[p] = 0;
+      sendTimes_[p] = SendTimes();
+      heardAt_[p] = TimePoint();
+    }
+  }
+
+  // REQUIRES: mu_ held
+  void recordSendTime(uint64_t peer, TimePoint now) {
+    SendTimes &st = sendTimes_[peer];
+    if (st.times.size() >= kMaxUnackedHeartbeats) {
+      // ignoring responses only shortens the lease.
+      st.skipped += st.times.size();
+      st.times.clear();
+    }
+    st.times.push_back(now);
+  }
+
+  // REQUIRES: mu_ held
+  void recordAck(uint64_t peer) {
+    SendTimes &st = sendTimes_[peer];
+    if (st.skipped > 0) {
+      st.skipped--;
+      return;
+    }
+    if (st.times.empty()) {
+      return;
+    }
+    heardAt_[peer] = st.times.front();
+    st.times.pop_front();
+  }
+
+  // REQUIRES: mu_ held
+  void confirmRounds(std::vector<Completion> *completions) {
+    size_t quorum = (peers_.size() + 1) / 2 + 1;
+
+    while (!rounds_.empty()) {
+      Round &round = rounds_.front();
+
+      size_t confirmed = 1;  // the leader itself
+      for (uint64_t p : peers_) {
+        if (acked_[p] > round.sent[p]) {
+          confirmed++;
+        }
+      }
+      // rounds are ordered by the time they began, if the earliest is
+      // unconfirmed, so are the later ones.
+      if (confirmed < quorum) {
+        return;
+      }
+
+      Completion c;
+      c.status = Status::OK();
+      c.readIndex = round.readIndex;
+      c.callbacks = std::move(round.callbacks);
+      completions->push_back(std::move(c));
+      rounds_.pop_front();
+    }
+  }
+
+  // The callbacks are invoked out of the lock.
+  static void complete(std::vector<Completion> *completions) {
+    for (auto &c : *completions) {
+      for (auto &cb : c.callbacks) {
+        cb(c.status, c.readIndex);
+      }
+    }
+  }
+
+ private:
+  const std::vector<uint64_t> peers_;
+  const std::chrono::milliseconds lease_;
+
+  std::mutex mu_;
+
+  // the term that the counters are for.
+  uint64_t term_;
+  CountMap sent_;
+  CountMap acked_;
+
+  std::map<uint64_t, SendTimes> sendTimes_;
+  std::map<uint64_t, TimePoint> heardAt_;
+
+  std::deque<Round> rounds_;
+};
+
+ReadIndexer::ReadIndexer(std::vector<uint64_t> peers, std::chrono::milliseconds lease)
+    : impl_(new Impl(std::move(peers), lease)) {}
+
+ReadIndexer::~ReadIndexer() = default;
+
+void ReadIndexer::Request(uint64_t term, uint64_t commitIndex, ReadIndexCallback callback) {
+  impl_->Request(term, commitIndex, std::move(callback));
+}
+
+void ReadIndexer::OnMessagesSent(const std::vector<yaraft::pb::Message> &msgs) {
+  impl_->OnMessagesSent(msgs);
+}
+
+void ReadIndexer::OnMessageStepped(const yaraft::pb::Message &msg) {
+  impl_->OnMessageStepped(msg);
+}
+
+bool ReadIndexer::InLease(uint64_t term) {
+  return impl_->InLease(term);
+}
+
+}  // namespace consensus
@@ -0,0 +1,87 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "base/status.h"
+
+#include <silly/disallow_copying.h>
+#include <yaraft/pb/raftpb.pb.h>
+
+namespace consensus {
+
+// ReadIndexer confirms the leadership of a leader for ReadIndex requests.
+//
+// A ReadIndex request is served with the committed index at the time it arrives,
+// once the leader has confirmed it's still the leader after that time. Confirmation
+// is piggybacked on heartbeats: the indexer counts the heartbeats sent to and the
+// responses received from each peer in the current term. The request is confirmed
+// when a majority, counting the leader itself, has responded more times than the
+// leader had sent heartbeats to it when the request arrived, which means at least
+// one of the responses answers a heartbeat sent afterwards.
+//
+// Requests arriving before the next heartbeat is sent share the same round of
+// confirmation, so concurrent reads cost a single heartbeat round altogether.
+//
+// The same counters maintain a leader lease. The n-th response from a peer answers
+// its n-th heartbeat or a later one, so the peer has heard from the leader no
+// earlier than the time that heartbeat was sent. Once a majority has, no other node
+// can be elected within `lease` after that time, provided that the followers refuse
+// to vote within an election timeout after hearing from the leader, and `lease` is
+// shorter than that.
+//
+// Thread-Safe
+class ReadIndexer {
+  __DISALLOW_COPYING__(ReadIndexer);
+
+ public:
+  typedef std::function<void(const Status& status, uint64_t readIndex)> ReadIndexCallback;
+
+  // `peers` are the members of the cluster besides this node.
+  // `lease` is how long the leadership holds after a majority has heard from the
+  // leader, zero disables the lease.
+  explicit ReadIndexer(std::vector<uint64_t> peers,
+                       std::chrono::milliseconds lease = std::chrono::milliseconds(0));
+
+  ~ReadIndexer();
+
+  // Requests a read index of `commitIndex` on behalf of the leader of `term`.
+  // `callback` is called once the leadership is confirmed, or with an error if the
+  // leader has moved to a new term.
+  // ONLY the raft thread is allowed to call this function.
+  void Request(uint64_t term, uint64_t commitIndex, ReadIndexCallback callback);
+
+  // Counts the heartbeats among the messages about to be sent.
+  // ONLY the flusher thread is allowed to call this function.
+  void OnMessagesSent(const std::vector<yaraft::pb::Message>& msgs);
+
+  // Counts the heartbeat responses, and fails the pending requests once a higher
+  // term is seen.
+  // ONLY the raft thread is allowed to call this function.
+  void OnMessageStepped(const yaraft::pb::Message& msg);
+
+  // Returns true if the leader of `term` holds the lease at this moment.
+  bool InLease(uint64_t term);
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace consensus
@@ -0,0 +1,163 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <thread>
+
+#include "base/testing.h"
+#include "read_indexer.h"
+
+using namespace consensus;
+
+static yaraft::pb::Message heartbeat(uint64_t to, uint64_t term) {
+  yaraft::pb::Message m;
+  m.set_type(yaraft::pb::MsgHeartbeat);
+  m.set_from(1);
+  m.set_to(to);
+  m.set_term(term);
+  return m;
+}
+
+static yaraft::pb::Message heartbeatResp(uint64_t from, uint64_t term) {
+  yaraft::pb::Message m;
+  m.set_type(yaraft::pb::MsgHeartbeatResp);
+  m.set_from(from);
+  m.set_to(1);
+  m.set_term(term);
+  return m;
+}
+
+struct ReadResult {
+  bool done = false;
+  Status status;
+  uint64_t index = 0;
+
+  ReadIndexer::ReadIndexCallback Callback() {
+    return [this](const Status &s, uint64_t readIndex) {
+      done = true;
+      status = s;
+      index = readIndex;
+    };
+  }
+};
+
+class ReadIndexerTest : public BaseTest {};
+
+TEST_F(ReadIndexerTest, SingleNode) {
+  ReadIndexer indexer({});
+
+  ReadResult r;
+  indexer.Request(1, 5, r.Callback());
+  ASSERT_TRUE(r.done);
+  ASSERT_OK(r.status);
+  ASSERT_EQ(r.index, 5);
+}
+
+TEST_F(ReadIndexerTest, ConfirmedByMajority) {
+  ReadIndexer indexer({2, 3});
+
+  // the response to a heartbeat sent before the request confirms nothing.
+  indexer.OnMessagesSent({heartbeat(2, 1), heartbeat(3, 1)});
+  ReadResult r1;
+  indexer.Request(1, 5, r1.Callback());
+  indexer.OnMessageStepped(heartbeatResp(2, 1));
+  ASSERT_FALSE(r1.done);
+
+  // requests before the next heartbeat share the same round.
+  ReadResult r2;
+  indexer.Request(1, 6, r2.Callback());
+
+  indexer.OnMessagesSent({heartbeat(2, 1), heartbeat(3, 1)});
+  ReadResult r3;
+  indexer.Request(1, 7, r3.Callback());
+
+  indexer.OnMessageStepped(heartbeatResp(2, 1));
+  ASSERT_TRUE(r1.done);
+  ASSERT_TRUE(r2.done);
+  ASSERT_OK(r1.status);
+  ASSERT_EQ(r1.index, 6);
+  ASSERT_EQ(r2.index, 6);
+  ASSERT_FALSE(r3.done);
+
+  indexer.OnMessagesSent({heartbeat(2, 1), heartbeat(3, 1)});
+  indexer.OnMessageStepped(heartbeatResp(3, 1));
+  ASSERT_FALSE(r3.done);
+  indexer.OnMessageStepped(heartbeatResp(3, 1));
+  ASSERT_TRUE(r3.done);
+  ASSERT_EQ(r3.index, 7);
+}
+
+TEST_F(ReadIndexerTest, TermChanged) {
+  ReadIndexer indexer({2, 3});
+
+  ReadResult r;
+  indexer.Request(1, 5, r.Callback());
+  indexer.OnMessagesSent({heartbeat(2, 1), heartbeat(3, 1)});
+
+  yaraft::pb::Message vote;
+  vote.set_type(yaraft::pb::MsgVote);
+  vote.set_from(2);
+  vote.set_to(1);
+  vote.set_term(2);
+  indexer.OnMessageStepped(vote);
+
+  ASSERT_TRUE(r.done);
+  ASSERT_EQ(r.status.Code(), Error::NotLeader);
+
+  // responses from the stale term are ignored.
+  ReadResult r2;
+  indexer.Request(2, 8, r2.Callback());
+  indexer.OnMessagesSent({heartbeat(2, 2), heartbeat(3, 2)});
+  indexer.OnMessageStepped(heartbeatResp(2, 1));
+  ASSERT_FALSE(r2.done);
+  indexer.OnMessageStepped(heartbeatResp(2, 2));
+  ASSERT_TRUE(r2.done);
+  ASSERT_OK(r2.status);
+  ASSERT_EQ(r2.index, 8);
+}
+
+TEST_F(ReadIndexerTest, Lease) {
+  ReadIndexer indexer({2, 3, 4, 5}, std::chrono::milliseconds(200));
+  ASSERT_FALSE(indexer.InLease(1));
+
+  indexer.OnMessagesSent({heartbeat(2, 1), heartbeat(3, 1), heartbeat(4, 1)});
+  indexer.OnMessageStepped(heartbeatResp(2, 1));
+  ASSERT_FALSE(indexer.InLease(1));
+  indexer.OnMessageStepped(heartbeatResp(3, 1));
+  ASSERT_TRUE(indexer.InLease(1));
+  ASSERT_FALSE(indexer.InLease(2));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  ASSERT_FALSE(indexer.InLease(1));
+
+  // renewed by the next round of heartbeats.
+  indexer.OnMessagesSent({heartbeat(2, 1), heartbeat(3, 1)});
+  indexer.OnMessageStepped(heartbeatResp(2, 1));
+  indexer.OnMessageStepped(heartbeatResp(4, 1));
+  ASSERT_FALSE(indexer.InLease(1));  // peer 4 acked the heartbeat of the expired lease.
+  indexer.OnMessageStepped(heartbeatResp(3, 1));
+  ASSERT_TRUE(indexer.InLease(1));
+
+  // lost once a higher term is seen.
+  indexer.OnMessageStepped(heartbeatResp(2, 2));
+  ASSERT_FALSE(indexer.InLease(1));
+  ASSERT_FALSE(indexer.InLease(2));
+}
+
+TEST_F(ReadIndexerTest, LeaseDisabled) {
+  ReadIndexer indexer({2, 3});
+  indexer.OnMessagesSent({heartbeat(2, 1), heartbeat(3, 1)});
+  indexer.OnMessageStepped(heartbeatResp(2, 1));
+  indexer.OnMessageStepped(heartbeatResp(3, 1));
+  ASSERT_FALSE(indexer.InLease(1));
+}
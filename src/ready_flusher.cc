@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+
 #include "base/background_worker.h"
 
 #include "raft_task_executor.h"
@@ -19,9 +21,20 @@
 #include "replicated_log_impl.h"
 
 #include <boost/thread/latch.hpp>
+#include <butil/time.h>
+#include <bvar/bvar.h>
 
 namespace consensus {
 
+// time (in microseconds) to flush a Ready, whose qps is the rate of Readies of all
+// the logs in the process.
+static bvar::LatencyRecorder g_ready_flush("consensus_ready_flush");
+
+// the number of entries in a Ready.
+static bvar::IntRecorder g_ready_entries;
+static bvar::Window<bvar::IntRecorder> g_ready_entries_window("consensus_ready_entries",
+                                                              &g_ready_entries, 10);
+
 class ReadyFlusher::Impl {
  public:
   Impl() = default;
@@ -31,6 +44,11 @@ class ReadyFlusher::Impl {
     logs_.push_back(log);
   }
 
+  void Unregister(ReplicatedLogImpl *log) {
+    std::lock_guard<std::mutex> g(mu_);
+    logs_.erase(std::remove(logs_.begin(), logs_.end(), log), logs_.end());
+  }
+
   void Start() {
     FATAL_NOT_OK(worker_.StartLoop(std::bind(&Impl::flushRound, this)),
                  "ReadyFlusher::Impl::Start");
@@ -42,15 +60,13 @@ class ReadyFlusher::Impl {
 
  private:
   void flushRound() {
-    mu_.lock();
-    std::vector<ReplicatedLogImpl *> logs = logs_;
-    mu_.unlock();
-
-    if (logs.empty()) {
+    // held during the round, so that an unregistered log is never flushed.
+    std::lock_guard<std::mutex> g(mu_);
+    if (logs_.empty()) {
       return;
     }
 
-    for (auto rl : logs) {
+    for (auto rl : logs_) {
       yaraft::Ready *rd = rl->executor_->GetReady();
       if (rd) {
         std::async(std::bind(&Impl::flushReady, this, rl, rd));
@@ -61,14 +77,27 @@ class ReadyFlusher::Impl {
   void flushReady(ReplicatedLogImpl *rl, yaraft::Ready *rd) {
     yaraft::pb::HardState *hs = nullptr;
     std::unique_ptr<yaraft::Ready> g(rd);
+    int64_t start = butil::cpuwide_time_us();
+    g_ready_entries << static_cast<int64_t>(rd->entries.size());
+
+    WriteTracer *tracer = rl->tracer_.get();
+    auto trace = [tracer, rd](WriteTracer::Stage stage) {
+      if (tracer && !rd->entries.empty()) {
+        tracer->Record(stage, rd->entries.front().index(), rd->entries.back().index());
+      }
+    };
+    trace(WriteTracer::kReady);
 
     // the leader can write to its disk in parallel with replicating to the followers and them
     // writing to their disks.
     // For more details, check raft thesis 10.2.1
     if (rd->currentLeader == rl->Id()) {
       if (!rd->messages.empty()) {
+        rl->readIndexer_->OnMessagesSent(rd->messages);
+        rl->metrics_->OnMessagesSent(rd->messages);
         rl->cluster_->Pass(rd->messages);
         rd->messages.clear();
+        trace(WriteTracer::kSend);
       }
     }
 
@@ -76,19 +105,51 @@ class ReadyFlusher::Impl {
       hs = rd->hardState.get();
     }
 
+    // A snapshot from the leader replaces the log before it. It's persisted before being
+    // applied, so that a restarted follower recovers from it.
+    if (rd->snapshot) {
+      FATAL_NOT_OK(rl->wal_->SaveSnapshot(*rd->snapshot, hs), "Wal::SaveSnapshot");
+      FATAL_NOT_OK(rl->memstore_->ApplySnapshot(*rd->snapshot), "MemoryStorage::ApplySnapshot");
+      if (rl->applier_) {
+        rl->applier_->SubmitSnapshot(*rd->snapshot);
+      }
+    }
+
     if (!rd->entries.empty()) {
       FATAL_NOT_OK(rl->wal_->Write(rd->entries, hs), "Wal::Write");
+      trace(WriteTracer::kWal);
     } else {
       FATAL_NOT_OK(rl->wal_->Write(hs), "Wal::Write");
     }
 
-    // committedIndex has changed
+    // states have already been persisted.
+    rd->Advance(rl->memstore_);
+
+    uint64_t commit = 0;
     if (rd->hardState && rd->hardState->has_commit()) {
-      rl->walCommitObserver_->Notify(rd->hardState->commit());
+      commit = rd->hardState->commit();
     }
+    rl->metrics_->OnReady(rd->currentLeader == rl->Id(), commit);
 
-    // states have already been persisted.
-    rd->Advance(rl->memstore_);
+    // committedIndex has changed
+    if (commit > 0) {
+      rl->committedIndex_.store(commit);
+      if (tracer) {
+        tracer->Record(WriteTracer::kCommit, 0, commit);
+      }
+      if (!rl->applier_) {
+        if (tracer) {
+          tracer->Record(WriteTracer::kApply, 0, commit);
+        }
+        rl->walCommitObserver_->Notify(commit);
+      }
+    }
+
+    // the application runs on its own thread, writers are notified after that.
+    if (rl->applier_ && !rd->committedEntries.empty()) {
+      rl->applier_->Submit(std::move(rd->committedEntries));
+      rd->committedEntries.clear();
+    }
 
     // followers should respond only after state persisted
     if (rd->currentLeader != rl->Id()) {
@@ -97,6 +158,8 @@ class ReadyFlusher::Impl {
         rd->messages.clear();
       }
     }
+
+    g_ready_flush << butil::cpuwide_time_us() - start;
   }
 
  private:
@@ -110,6 +173,10 @@ void ReadyFlusher::Register(ReplicatedLogImpl *log) {
   impl_->Register(log);
 }
 
+void ReadyFlusher::Unregister(ReplicatedLogImpl *log) {
+  impl_->Unregister(log);
+}
+
 ReadyFlusher::ReadyFlusher() : impl_(new Impl) {
   impl_->Start();
 }
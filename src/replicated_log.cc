@@ -23,7 +23,8 @@ namespace consensus {
 
 Status ReplicatedLog::Write(const Slice &log) {
   Status s;
-  SimpleChannel<Status> chan = impl_->AsyncWrite(log);
+  SimpleChannel<Status> chan;
+  impl_->AsyncWrite(log, [&chan](const Status &result) { chan <<= result; });
   chan >>= s;
   return s;
 }
@@ -32,20 +33,54 @@ StatusWith<ReplicatedLog *> ReplicatedLog::New(const ReplicatedLogOptions &optio
   return ReplicatedLogImpl::New(options);
 }
 
+StatusWith<uint64_t> ReplicatedLog::ReadIndex() {
+  uint64_t leader = 0;
+  StatusWith<uint64_t> sw = impl_->ReadIndex(&leader);
+  if (sw.IsOK() || sw.GetStatus().Code() != Error::NotLeader) {
+    return sw;
+  }
+  if (leader == 0 || leader == impl_->Id()) {
+    return sw;
+  }
+
+  // a follower obtains the read index from the leader.
+  return impl_->cluster_->ReadIndex(leader);
+}
+
+Status ReplicatedLog::WaitApplied(uint64_t index, uint32_t timeout_ms) {
+  if (!impl_->applier_) {
+    return Status::Make(Error::NotSupported, "ReplicatedLog::WaitApplied: no state machine");
+  }
+  return impl_->applier_->WaitApplied(index, std::chrono::milliseconds(timeout_ms));
+}
+
+Status ReplicatedLog::Entries(uint64_t lo, uint64_t hi, uint64_t max_size,
+                              std::vector<yaraft::pb::Entry> *entries) {
+  if (lo >= hi) {
+    entries->clear();
+    return Status::OK();
+  }
+  return impl_->Entries(lo, hi, max_size, entries);
+}
+
 RaftTaskExecutor *ReplicatedLog::RaftTaskExecutorInstance() const {
   return impl_->executor_.get();
 }
 
 ReplicatedLog::~ReplicatedLog() {}
 
-SimpleChannel<Status> ReplicatedLog::AsyncWrite(const Slice &log) {
-  return impl_->AsyncWrite(log);
+void ReplicatedLog::AsyncWrite(const Slice &log, WriteCallback callback) {
+  impl_->AsyncWrite(log, std::move(callback));
 }
 
 uint64_t ReplicatedLog::Id() const {
   return impl_->Id();
 }
 
+uint64_t ReplicatedLog::GroupId() const {
+  return impl_->groupId_;
+}
+
 Status ReplicatedLogOptions::Validate() const {
 #define ConfigNotNull(var) \
   if ((var) == nullptr)    \
@@ -54,16 +89,35 @@ Status ReplicatedLogOptions::Validate() const {
 
   // memstore is allowed to be null, when no log exists.
 
+  if (lease_read && lease_clock_drift >= election_timeout) {
+    return FMT_Status(BadConfig,
+                      "ReplicatedLogOptions::lease_clock_drift ({}) should be less than "
+                      "election_timeout ({})",
+                      lease_clock_drift, election_timeout);
+  }
+
   return Status::OK();
 }
 
 ReplicatedLogOptions::ReplicatedLogOptions()
-    : heartbeat_interval(100),
+    : group_id(0),
+      campaign_on_start(false),
+      heartbeat_interval(100),
       election_timeout(10 * 1000),
-      taskQueue(nullptr),
-      flusher(nullptr),
-      timer(nullptr),
+      max_inflight_appends(32),
+      max_pending_appends(1024),
+      compress_type(pb::COMPRESS_NONE),
+      min_compress_size(4096),
+      snapshot_chunk_size(1024 * 1024),
+      snapshot_rate_limit(64 * 1024 * 1024),
+      lease_read(false),
+      lease_clock_drift(500),
+      cluster(nullptr),
       wal(nullptr),
-      memstore(nullptr) {}
+      memstore(nullptr),
+      state_machine(nullptr),
+      snapshot_threshold(0),
+      snapshot_retained_entries(1024),
+      trace_sample_every(0) {}
 
 }  // namespace consensus
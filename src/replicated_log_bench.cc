@@ -0,0 +1,223 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "base/logging.h"
+#include "base/testing.h"
+#include "rpc/loopback_cluster.h"
+
+#include "replicated_log.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace consensus;
+
+// BenchCluster is a set of raft groups, each of which has a replica on every node.
+// The groups on a node share a TaskQueue, a RaftTimer and a ReadyFlusher like a
+// multi-raft process, and the nodes talk through LoopbackNetworks.
+class BenchCluster {
+ public:
+  BenchCluster(int numNodes, int numGroups) : dir_("/tmp/consensus-replicated-log-bench") {
+    std::map<uint64_t, std::string> initialCluster;
+    for (int n = 1; n <= numNodes; n++) {
+      // the addresses are unused by the loopback network.
+      initialCluster[n] = fmt::format("127.0.0.1:{}", 12320 + n);
+    }
+
+    std::vector<std::shared_ptr<TaskQueue>> taskQueues;
+    std::vector<std::shared_ptr<RaftTimer>> timers;
+    std::vector<std::shared_ptr<ReadyFlusher>> flushers;
+    for (int n = 0; n < numNodes; n++) {
+      taskQueues.push_back(std::make_shared<TaskQueue>());
+      timers.push_back(std::make_shared<RaftTimer>());
+      flushers.push_back(std::make_shared<ReadyFlusher>());
+    }
+
+    for (int g = 0; g < numGroups; g++) {
+      networks_.emplace_back(new rpc::LoopbackNetwork(rpc::LoopbackNetworkOptions()));
+      for (int n = 1; n <= numNodes; n++) {
+        std::string walDir = fmt::format("{}/group{}-node{}", dir_.GetTestDir(), g, n);
+        FATAL_NOT_OK(Env::Default()->CreateDirIfMissing(walDir), walDir);
+        yaraft::MemStoreUptr memstore;
+        wals_.push_back(wal::TEST_CreateWalStore(walDir, &memstore));
+
+        ReplicatedLogOptions options;
+        options.id = n;
+        options.group_id = g;
+        options.initial_cluster = initialCluster;
+        options.heartbeat_interval = 10;
+        options.election_timeout = 100;
+        options.campaign_on_start = (g % numNodes) + 1 == n;
+        options.taskQueue = taskQueues[n - 1];
+        options.timer = timers[n - 1];
+        options.flusher = flushers[n - 1];
+        options.cluster = networks_.back()->NewCluster();
+        options.wal = wals_.back().get();
+        options.memstore = memstore.release();
+
+        auto sw = ReplicatedLog::New(options);
+        FATAL_NOT_OK(sw.GetStatus(), "ReplicatedLog::New");
+        logs_.emplace_back(sw.GetValue());
+        networks_.back()->Register(n, logs_.back()->RaftTaskExecutorInstance());
+      }
+
+      leaders_.push_back(waitForLeader(g, numNodes));
+    }
+  }
+
+  ~BenchCluster() {
+    // the logs go first, since they use the wals and the networks.
+    logs_.clear();
+  }
+
+  // The leader of group `g`.
+  ReplicatedLog *Leader(int g) const {
+    return leaders_[g];
+  }
+
+ private:
+  ReplicatedLog *waitForLeader(int g, int numNodes) {
+    while (true) {
+      for (int n = 0; n < numNodes; n++) {
+        ReplicatedLog *log = logs_[g * numNodes + n].get();
+        if (log->Write("").IsOK()) {
+          return log;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+ private:
+  TestDirectoryHelper dir_;
+  std::vector<std::unique_ptr<rpc::LoopbackNetwork>> networks_;
+  std::vector<wal::WriteAheadLogUPtr> wals_;
+  std::vector<std::unique_ptr<ReplicatedLog>> logs_;
+  std::vector<ReplicatedLog *> leaders_;
+};
+
+// The cluster shared by the threads of a benchmark, it's set up by thread 0 before
+// the threads start running, and torn down after they all finish.
+static BenchCluster *sharedCluster;
+
+static void setUp(benchmark::State &state, int numNodes, int numGroups) {
+  if (state.thread_index == 0) {
+    sharedCluster = new BenchCluster(numNodes, numGroups);
+  }
+}
+
+static void tearDown(benchmark::State &state) {
+  if (state.thread_index == 0) {
+    delete sharedCluster;
+    sharedCluster = nullptr;
+  }
+}
+
+// Synchronous writes of range(1)-byte entries to a cluster of range(0) nodes, each
+// thread waits for its write to commit before the next. The time per iteration is
+// the latency of a write.
+void WriteBench(benchmark::State &state) {
+  setUp(state, state.range(0), 1);
+  std::string data(state.range(1), 'a');
+
+  while (state.KeepRunning()) {
+    FATAL_NOT_OK(sharedCluster->Leader(0)->Write(data), "ReplicatedLog::Write");
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * data.size());
+  tearDown(state);
+}
+
+// Asynchronous writes of range(1)-byte entries to a cluster of range(0) nodes, with
+// up to range(2) writes in flight.
+void AsyncWriteBench(benchmark::State &state) {
+  setUp(state, state.range(0), 1);
+  std::string data(state.range(1), 'a');
+  const int64_t window = state.range(2);
+
+  std::mutex mu;
+  std::condition_variable cv;
+  int64_t inflight = 0;
+  auto done = [&](const Status &s) {
+    FATAL_NOT_OK(s, "ReplicatedLog::AsyncWrite");
+    std::lock_guard<std::mutex> g(mu);
+    inflight--;
+    cv.notify_one();
+  };
+
+  while (state.KeepRunning()) {
+    {
+      std::unique_lock<std::mutex> l(mu);
+      cv.wait(l, [&]() { return inflight < window; });
+      inflight++;
+    }
+    sharedCluster->Leader(0)->AsyncWrite(data, done);
+  }
+
+  {
+    std::unique_lock<std::mutex> l(mu);
+    cv.wait(l, [&]() { return inflight == 0; });
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * data.size());
+  tearDown(state);
+}
+
+// Synchronous writes of 1KB entries to range(1) groups over range(0) nodes, the
+// groups on a node share the TaskQueue and the ReadyFlusher. Thread i writes to
+// group i % range(1).
+void MultiGroupWriteBench(benchmark::State &state) {
+  setUp(state, state.range(0), state.range(1));
+  std::string data(1024, 'a');
+  int group = state.thread_index % state.range(1);
+
+  while (state.KeepRunning()) {
+    FATAL_NOT_OK(sharedCluster->Leader(group)->Write(data), "ReplicatedLog::Write");
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * data.size());
+  tearDown(state);
+}
+
+BENCHMARK(WriteBench)
+    ->Args({1, 100})
+    ->Args({1, 4096})
+    ->Args({3, 100})
+    ->Args({3, 4096})
+    ->Args({3, 65536})
+    ->ThreadRange(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(AsyncWriteBench)
+    ->Args({1, 100, 64})
+    ->Args({3, 100, 1})
+    ->Args({3, 100, 64})
+    ->Args({3, 100, 1024})
+    ->Args({3, 4096, 64})
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(MultiGroupWriteBench)
+    ->Args({3, 1})
+    ->Args({3, 4})
+    ->Args({3, 16})
+    ->Threads(16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
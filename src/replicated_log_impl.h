@@ -19,12 +19,17 @@
 #include "rpc/peer.h"
 #include "wal/wal.h"
 
+#include "apply_worker.h"
+#include "log_metrics.h"
 #include "raft_service.h"
 #include "raft_task_executor.h"
 #include "raft_timer.h"
+#include "read_indexer.h"
 #include "ready_flusher.h"
 #include "replicated_log.h"
+#include "snapshotter.h"
 #include "wal_commit_observer.h"
+#include "write_tracer.h"
 
 #include <yaraft/conf.h>
 
@@ -38,8 +43,11 @@ class ReplicatedLogImpl {
     // The construction order is:
     // - RawNode
     // - RaftTaskExecutor (depends on RawNode)
+    // - LogMetrics, ReadIndexer (depends on RaftTaskExecutor)
     // - RaftTimer, (depends on RaftTaskExecutor)
-    // - ReadyFlusher (depends on WalCommitObserver, WAL, RPC)
+    // - Snapshotter (depends on RaftTaskExecutor)
+    // - ApplyWorker (depends on WalCommitObserver, Snapshotter)
+    // - ReadyFlusher (depends on WalCommitObserver, ApplyWorker, WAL, RPC)
     // - ReplicatedLog
     ReplicatedLogOptions options = oldOptions;
     RETURN_NOT_OK(options.Validate());
@@ -60,28 +68,129 @@ class ReplicatedLogImpl {
     }
     impl->node_.reset(new yaraft::RawNode(conf));
 
+    impl->groupId_ = options.group_id;
+
     // -- RaftTaskExecutor --
-    TaskQueue *taskQueue = options.taskQueue;
+    std::shared_ptr<TaskQueue> taskQueue = options.taskQueue;
     if (!taskQueue) {
-      taskQueue = new TaskQueue;
+      taskQueue = std::make_shared<TaskQueue>();
     }
     impl->executor_.reset(new RaftTaskExecutor(impl->node_.get(), taskQueue));
 
+    // -- ReadIndexer --
+    std::vector<uint64_t> peers;
+    for (const auto &e : options.initial_cluster) {
+      if (e.first != options.id) {
+        peers.push_back(e.first);
+      }
+    }
+    std::chrono::milliseconds lease(0);
+    if (options.lease_read) {
+      lease = std::chrono::milliseconds(options.election_timeout - options.lease_clock_drift);
+      // no other leader is elected before the lease expires, as the followers refuse
+      // to vote within an election timeout after they heard from the leader.
+      impl->executor_->SetVoteGuard(std::chrono::milliseconds(options.election_timeout));
+    }
+    impl->metrics_.reset(new LogMetrics(
+        fmt::format("consensus_node{}_group{}", options.id, options.group_id), peers));
+    impl->readIndexer_.reset(new ReadIndexer(std::move(peers), lease));
+    ReadIndexer *readIndexer = impl->readIndexer_.get();
+    LogMetrics *metrics = impl->metrics_.get();
+    impl->executor_->SetStepObserver([readIndexer, metrics](const yaraft::pb::Message &m) {
+      readIndexer->OnMessageStepped(m);
+      metrics->OnMessageStepped(m);
+    });
+
     // -- RaftTimer --
-    impl->timer_.reset(options.timer);
+    impl->timer_ = options.timer;
     if (!impl->timer_) {
-      impl->timer_.reset(new RaftTimer);
+      impl->timer_ = std::make_shared<RaftTimer>();
     }
     impl->timer_->Register(impl->executor_.get());
 
+    if (options.campaign_on_start) {
+      // elapses an election timeout at once, ticks are at least 1ms apart.
+      uint32_t ticks = 2 * options.election_timeout;
+      impl->executor_->Submit([ticks](yaraft::RawNode *node) {
+        if (node->CurrentTerm() != 0) {
+          // the group has elected before.
+          return;
+        }
+        for (uint32_t i = 0; i < ticks; i++) {
+          node->Tick();
+        }
+      });
+    }
+
+    impl->walCommitObserver_.reset(new WalCommitObserver);
+
+    if (options.trace_sample_every > 0) {
+      impl->tracer_.reset(new WriteTracer(
+          fmt::format("consensus_write_node{}_group{}", options.id, options.group_id),
+          options.trace_sample_every));
+    }
+
+    // -- Snapshotter --
+    if (options.state_machine && options.snapshot_threshold > 0) {
+      SnapshotterOptions snapOptions;
+      snapOptions.threshold = options.snapshot_threshold;
+      snapOptions.retained_entries = options.snapshot_retained_entries;
+      for (const auto &e : options.initial_cluster) {
+        snapOptions.conf_state.add_nodes(e.first);
+      }
+      impl->snapshotter_.reset(new Snapshotter(options.state_machine, impl->executor_.get(),
+                                               options.memstore, snapOptions));
+    }
+
+    // -- ApplyWorker --
+    if (options.state_machine) {
+      WalCommitObserver *observer = impl->walCommitObserver_.get();
+      Snapshotter *snapshotter = impl->snapshotter_.get();
+      WriteTracer *tracer = impl->tracer_.get();
+      impl->applier_.reset(
+          new ApplyWorker(options.state_machine, [observer, snapshotter, tracer](uint64_t index) {
+            if (tracer) {
+              tracer->Record(WriteTracer::kApply, 0, index);
+            }
+            observer->Notify(index);
+            if (snapshotter) {
+              snapshotter->OnApplied(index);
+            }
+          }));
+
+      // the snapshot recovered from the WAL is restored before any entry is applied.
+      auto sw = options.memstore->Snapshot();
+      if (sw.IsOK() && sw.GetValue().metadata().index() > 0) {
+        impl->applier_->SubmitSnapshot(sw.GetValue());
+      }
+    }
+
     // -- ReadyFlusher --
     impl->wal_ = options.wal;
-    impl->walCommitObserver_.reset(new WalCommitObserver);
     impl->memstore_ = options.memstore;
-    impl->cluster_.reset(rpc::Cluster::Default(options.initial_cluster));
-    impl->flusher_.reset(options.flusher);
+    impl->cluster_.reset(options.cluster);
+    if (!impl->cluster_) {
+      rpc::ClusterOptions clusterOptions;
+      clusterOptions.initial_cluster = options.initial_cluster;
+      clusterOptions.group_id = options.group_id;
+      clusterOptions.max_inflight_appends = options.max_inflight_appends;
+      clusterOptions.max_pending_appends = options.max_pending_appends;
+      clusterOptions.compress_type = options.compress_type;
+      clusterOptions.peer_compress_types = options.peer_compress_types;
+      clusterOptions.min_compress_size = options.min_compress_size;
+      clusterOptions.snapshot_chunk_size = options.snapshot_chunk_size;
+      clusterOptions.snapshot_rate_limit = options.snapshot_rate_limit;
+      RaftTaskExecutor *executor = impl->executor_.get();
+      clusterOptions.snapshot_reporter = [executor](uint64_t to, bool failed) {
+        executor->Submit([executor, to, failed](yaraft::RawNode *node) {
+          executor->ReportSnapshot(node, to, failed);
+        });
+      };
+      impl->cluster_.reset(rpc::Cluster::Default(clusterOptions));
+    }
+    impl->flusher_ = options.flusher;
     if (!impl->flusher_) {
-      impl->flusher_.reset(new ReadyFlusher);
+      impl->flusher_ = std::make_shared<ReadyFlusher>();
     }
     impl->flusher_->Register(impl);
 
@@ -90,47 +199,188 @@ class ReplicatedLogImpl {
     return rl;
   }
 
-  ~ReplicatedLogImpl() = default;
+  ~ReplicatedLogImpl() {
+    // the timer and the flusher may be shared, and outlive the log.
+    timer_->Unregister(executor_.get());
+    flusher_->Unregister(this);
 
-  SimpleChannel<Status> AsyncWrite(const Slice &log) {
-    SimpleChannel<Status> channel;
+    // the snapshot senders stop reporting to the executor.
+    cluster_.reset();
 
-    executor_->Submit([&](yaraft::RawNode *node) {
-      uint64_t id = Id();
+    // so may the task queue, the pending tasks of this log are drained.
+    Barrier barrier;
+    executor_->Submit([&](yaraft::RawNode *) { barrier.Signal(); });
+    barrier.Wait();
+  }
+
+  void AsyncWrite(const Slice &log, ReplicatedLog::WriteCallback callback) {
+    auto data = std::make_shared<std::string>(log.ToString());
+    int64_t submitTime = tracer_ ? tracer_->Sample() : 0;
+
+    executor_->Submit([this, data, callback, submitTime](yaraft::RawNode *node) {
       if (!node->IsLeader()) {
-        channel <<=
-            FMT_Status(WalWriteToNonLeader, "writing to a non-leader node, [id: {}, leader: {}]",
-                       id, node->LeaderHint());
+        callback(FMT_Status(WalWriteToNonLeader,
+                            "writing to a non-leader node, [id: {}, leader: {}]", Id(),
+                            node->LeaderHint()));
         return;
       }
 
-      yaraft::Status s = node->Propose(log);
+      yaraft::Status s = node->Propose(*data);
       if (UNLIKELY(!s.IsOK())) {
-        channel <<= Status::Make(Error::YARaftError, s.ToString());
+        callback(Status::Make(Error::YARaftError, s.ToString()));
         return;
       }
 
-      // listening for the committedIndex to forward to the newly-appended log.
       uint64_t newIndex = node->LastIndex();
-      walCommitObserver_->Register(std::make_pair(newIndex, newIndex), &channel);
+      metrics_->OnProposed(newIndex);
+      if (submitTime) {
+        tracer_->OnProposed(newIndex, submitTime);
+      }
+      walCommitObserver_->Register(std::make_pair(newIndex, newIndex), callback);
     });
+  }
+
+  // Serves ReadIndex as the leader. `leaderHint`, if not null, is set to the
+  // leader known by this node.
+  StatusWith<uint64_t> ReadIndex(uint64_t *leaderHint = nullptr) {
+    Status status;
+    uint64_t readIndex = 0;
+    SimpleChannel<Status> channel;
+
+    executor_->Submit([&](yaraft::RawNode *node) {
+      if (leaderHint) {
+        *leaderHint = node->LeaderHint();
+      }
+      if (!node->IsLeader()) {
+        channel <<= FMT_Status(NotLeader, "read index from a non-leader node, [id: {}, leader: {}]",
+                               Id(), node->LeaderHint());
+        return;
+      }
 
-    return channel;
+      // The commit index of a leader is up-to-date only after it commits an entry of
+      // its own term. It's read from the flusher, which has seen every commit a
+      // completed write depends on.
+      uint64_t commitIndex = committedIndex_.load();
+      auto sw = memstore_->Term(commitIndex);
+      if (!sw.IsOK() || sw.GetValue() != node->CurrentTerm()) {
+        channel <<= FMT_Status(IllegalState, "leader has not committed an entry in term {}",
+                               node->CurrentTerm());
+        return;
+      }
+
+      if (readIndexer_->InLease(node->CurrentTerm())) {
+        readIndex = commitIndex;
+        channel <<= Status::OK();
+        return;
+      }
+
+      readIndexer_->Request(node->CurrentTerm(), commitIndex,
+                            [&](const Status &s, uint64_t index) {
+                              readIndex = index;
+                              channel <<= s;
+                            });
+    });
+
+    channel >>= status;
+    if (!status.IsOK()) {
+      return status;
+    }
+    return readIndex;
+  }
+
+  Status Entries(uint64_t lo, uint64_t hi, uint64_t maxSize,
+                 std::vector<yaraft::pb::Entry> *entries) {
+    Status status;
+    SimpleChannel<Status> channel;
+
+    // MemoryStorage does its own locking. The read runs on the raft thread only to be
+    // ordered against the compaction by the Snapshotter, which runs there too, so that
+    // the range checked below isn't compacted before it's read. The flusher thread
+    // may still append entries or apply a snapshot from the leader in between, in
+    // which case MemoryStorage::Entries reports the error.
+    executor_->Submit([&](yaraft::RawNode *node) {
+      if (lo < memstore_->FirstIndex()) {
+        channel <<= FMT_Status(LogCompacted, "entry {} is compacted, first index: {}", lo,
+                               memstore_->FirstIndex());
+        return;
+      }
+      if (hi > memstore_->LastIndex() + 1) {
+        channel <<= FMT_Status(OutOfBound, "entry {} is beyond the last index {}", hi - 1,
+                               memstore_->LastIndex());
+        return;
+      }
+
+      auto sw = memstore_->Entries(lo, hi, maxSize);
+      if (!sw.IsOK()) {
+        channel <<= Status::Make(Error::YARaftError, sw.GetStatus().ToString());
+        return;
+      }
+      *entries = std::move(sw.GetValue());
+      channel <<= Status::OK();
+    });
+
+    channel >>= status;
+    return status;
   }
 
   uint64_t Id() const {
     return node_->Id();
   }
 
+  // Fills the status maintained out of the raft thread, so that it's collected
+  // without waiting for the raft thread.
+  void GetStatus(pb::StatusResponse *response) const {
+    uint64_t commit = committedIndex_.load();
+    response->set_raftcommit(commit);
+    response->set_raftapplied(applier_ ? applier_->AppliedIndex() : commit);
+    response->set_pendingproposals(metrics_->InflightWrites());
+
+    wal::WalUsage usage = wal_->Usage();
+    response->set_walsegments(usage.segment_num);
+    response->set_walbytes(usage.bytes);
+
+    std::map<uint64_t, rpc::PeerStatus> peers = cluster_->PeerStatuses();
+    for (const auto &p : metrics_->Followers()) {
+      pb::FollowerStatus *f = response->add_followers();
+      f->set_id(p.id);
+      f->set_matchindex(p.match);
+      f->set_nextindex(p.next);
+      auto it = peers.find(p.id);
+      if (it != peers.end()) {
+        f->set_inflightappends(it->second.inflight_appends);
+        f->set_pendingmessages(it->second.pending_messages);
+      }
+    }
+  }
+
  private:
   friend class ReadyFlusher;
 
   std::unique_ptr<yaraft::RawNode> node_;
 
+  uint64_t groupId_;
+
   std::unique_ptr<RaftTaskExecutor> executor_;
 
+  std::unique_ptr<ReadIndexer> readIndexer_;
+
+  std::unique_ptr<LogMetrics> metrics_;
+
+  // the last committed index the flusher has seen.
+  std::atomic<uint64_t> committedIndex_{0};
+
   std::unique_ptr<WalCommitObserver> walCommitObserver_;
 
+  // null if tracing is disabled. It's destroyed after the applier that uses it.
+  std::unique_ptr<WriteTracer> tracer_;
+
+  // null if there's no state machine, or snapshot is disabled.
+  // It's destroyed after the applier that feeds it.
+  std::unique_ptr<Snapshotter> snapshotter_;
+
+  // null if there's no state machine.
+  std::unique_ptr<ApplyWorker> applier_;
+
   std::unique_ptr<rpc::Cluster> cluster_;
 
   std::shared_ptr<RaftTimer> timer_;
@@ -17,14 +17,28 @@
 namespace consensus {
 namespace rpc {
 
-Cluster *Cluster::Default(const std::map<uint64_t, std::string> &initialCluster) {
+Cluster *Cluster::Default(const ClusterOptions &options) {
   std::map<uint64_t, Peer *> peerMap;
-  for (const auto &e : initialCluster) {
-    peerMap[e.first] = new Peer(e.second);
+  for (const auto &e : options.initial_cluster) {
+    ClusterOptions peerOptions = options;
+    auto it = options.peer_compress_types.find(e.first);
+    if (it != options.peer_compress_types.end()) {
+      peerOptions.compress_type = it->second;
+    }
+    peerMap[e.first] = new Peer(e.second, peerOptions);
   }
   auto p = new PeerManager(std::move(peerMap));
   return p;
 }
 
+ClusterOptions::ClusterOptions()
+    : group_id(0),
+      max_inflight_appends(32),
+      max_pending_appends(1024),
+      compress_type(pb::COMPRESS_NONE),
+      min_compress_size(4096),
+      snapshot_chunk_size(1024 * 1024),
+      snapshot_rate_limit(64 * 1024 * 1024) {}
+
 }  // namespace rpc
 }  // namespace consensus
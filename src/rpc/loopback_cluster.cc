@@ -0,0 +1,267 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <set>
+
+#include "base/background_worker.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "raft_task_executor.h"
+#include "rpc/loopback_cluster.h"
+
+namespace consensus {
+namespace rpc {
+
+class LoopbackCluster : public Cluster {
+ public:
+  explicit LoopbackCluster(LoopbackNetwork *network) : network_(network) {}
+
+  Status Pass(std::vector<yaraft::pb::Message> &mails) override {
+    network_->send(mails);
+    return Status::OK();
+  }
+
+ private:
+  LoopbackNetwork *network_;
+};
+
+class LoopbackNetwork::Impl {
+  using Clock = std::chrono::steady_clock;
+
+  // the delivery thread wakes up at least once in every interval to check if it's stopped.
+  static constexpr std::chrono::milliseconds kPollInterval{10};
+
+ public:
+  explicit Impl(const LoopbackNetworkOptions &options)
+      : options_(options), rnd_(options.seed), seq_(0), delivered_(0), dropped_(0) {
+    FATAL_NOT_OK(worker_.StartLoop(std::bind(&Impl::deliverLoop, this)),
+                 "LoopbackNetwork: failed to start delivery thread");
+  }
+
+  ~Impl() {
+    cond_.notify_all();
+    FATAL_NOT_OK(worker_.Stop(), "LoopbackNetwork: failed to stop delivery thread");
+  }
+
+  void Register(uint64_t id, RaftTaskExecutor *executor) {
+    std::lock_guard<std::mutex> g(mu_);
+    executors_[id] = executor;
+  }
+
+  void Unregister(uint64_t id) {
+    std::lock_guard<std::mutex> g(mu_);
+    executors_.erase(id);
+  }
+
+  void Partition(uint64_t a, uint64_t b) {
+    std::lock_guard<std::mutex> g(mu_);
+    cutLinks_.insert(std::make_pair(a, b));
+    cutLinks_.insert(std::make_pair(b, a));
+  }
+
+  void Isolate(uint64_t id) {
+    std::lock_guard<std::mutex> g(mu_);
+    isolated_.insert(id);
+  }
+
+  void Heal() {
+    std::lock_guard<std::mutex> g(mu_);
+    cutLinks_.clear();
+    isolated_.clear();
+  }
+
+  uint64_t DeliveredCount() const {
+    std::lock_guard<std::mutex> g(mu_);
+    return delivered_;
+  }
+
+  uint64_t DroppedCount() const {
+    std::lock_guard<std::mutex> g(mu_);
+    return dropped_;
+  }
+
+  void Send(std::vector<yaraft::pb::Message> &mails) {
+    std::lock_guard<std::mutex> g(mu_);
+    auto now = Clock::now();
+
+    for (auto &m : mails) {
+      if (isCut(m.from(), m.to()) || shouldDrop()) {
+        dropped_++;
+        continue;
+      }
+
+      Delivery d;
+      d.seq = seq_++;
+      d.from = m.from();
+      d.to = m.to();
+
+      // Messages on the same link queue up for transmission, so a large MsgApp
+      // delays everything sent after it.
+      Clock::time_point sentAt = now;
+      if (options_.bandwidth > 0) {
+        auto &linkFree = linkFreeAt_[std::make_pair(d.from, d.to)];
+        auto txTime = std::chrono::microseconds(static_cast<uint64_t>(m.ByteSizeLong()) * 1000000 /
+                                                options_.bandwidth);
+        sentAt = std::max(now, linkFree) + txTime;
+        linkFree = sentAt;
+      }
+      d.deliverAt = sentAt + options_.latency;
+
+      d.msg = std::make_shared<yaraft::pb::Message>();
+      d.msg->Swap(&m);
+      queue_.push(std::move(d));
+    }
+    cond_.notify_one();
+  }
+
+ private:
+  struct Delivery {
+    Clock::time_point deliverAt;
+    uint64_t seq;
+    uint64_t from;
+    uint64_t to;
+    std::shared_ptr<yaraft::pb::Message> msg;
+  };
+
+  // orders the deliveries by time, and by the order they were sent if the time is equal,
+  // so that a link never reorders messages.
+  struct DeliverLater {
+    bool operator()(const Delivery &a, const Delivery &b) const {
+      if (a.deliverAt != b.deliverAt) {
+        return a.deliverAt > b.deliverAt;
+      }
+      return a.seq > b.seq;
+    }
+  };
+
+  void deliverLoop() {
+    std::unique_lock<std::mutex> lock(mu_);
+
+    auto deadline = Clock::now() + kPollInterval;
+    if (!queue_.empty()) {
+      deadline = std::min(deadline, queue_.top().deliverAt);
+    }
+    cond_.wait_until(lock, deadline);
+
+    auto now = Clock::now();
+    while (!queue_.empty() && queue_.top().deliverAt <= now) {
+      Delivery d = queue_.top();
+      queue_.pop();
+
+      // partitions made after the message was sent apply as well.
+      auto it = executors_.find(d.to);
+      if (it == executors_.end() || isCut(d.from, d.to)) {
+        dropped_++;
+        continue;
+      }
+
+      delivered_++;
+      auto msg = d.msg;
+      RaftTaskExecutor *executor = it->second;
+      executor->Submit([msg, executor](yaraft::RawNode *node) {
+        auto s = executor->Step(node, *msg);
+        if (UNLIKELY(!s.IsOK())) {
+          LOG(WARNING) << "LoopbackNetwork: RawNode::Step failed: " << s.ToString();
+        }
+      });
+    }
+  }
+
+  // REQUIRES: mu_ held
+  bool isCut(uint64_t from, uint64_t to) const {
+    return isolated_.count(from) || isolated_.count(to) ||
+           cutLinks_.count(std::make_pair(from, to));
+  }
+
+  // REQUIRES: mu_ held
+  bool shouldDrop() {
+    if (options_.drop_rate <= 0) {
+      return false;
+    }
+    return rnd_.Uniform(1000000) < static_cast<uint32_t>(options_.drop_rate * 1000000);
+  }
+
+ private:
+  const LoopbackNetworkOptions options_;
+
+  mutable std::mutex mu_;
+  std::condition_variable cond_;
+
+  std::map<uint64_t, RaftTaskExecutor *> executors_;
+  std::set<std::pair<uint64_t, uint64_t>> cutLinks_;
+  std::set<uint64_t> isolated_;
+  std::map<std::pair<uint64_t, uint64_t>, Clock::time_point> linkFreeAt_;
+
+  std::priority_queue<Delivery, std::vector<Delivery>, DeliverLater> queue_;
+
+  Random rnd_;
+  uint64_t seq_;
+  uint64_t delivered_;
+  uint64_t dropped_;
+
+  BackgroundWorker worker_;
+};
+
+constexpr std::chrono::milliseconds LoopbackNetwork::Impl::kPollInterval;
+
+LoopbackNetworkOptions::LoopbackNetworkOptions()
+    : latency(0), bandwidth(0), drop_rate(0), seed(0) {}
+
+LoopbackNetwork::LoopbackNetwork(const LoopbackNetworkOptions &options)
+    : impl_(new Impl(options)) {}
+
+LoopbackNetwork::~LoopbackNetwork() = default;
+
+void LoopbackNetwork::Register(uint64_t id, RaftTaskExecutor *executor) {
+  impl_->Register(id, executor);
+}
+
+void LoopbackNetwork::Unregister(uint64_t id) {
+  impl_->Unregister(id);
+}
+
+Cluster *LoopbackNetwork::NewCluster() {
+  return new LoopbackCluster(this);
+}
+
+void LoopbackNetwork::Partition(uint64_t a, uint64_t b) {
+  impl_->Partition(a, b);
+}
+
+void LoopbackNetwork::Isolate(uint64_t id) {
+  impl_->Isolate(id);
+}
+
+void LoopbackNetwork::Heal() {
+  impl_->Heal();
+}
+
+uint64_t LoopbackNetwork::DeliveredCount() const {
+  return impl_->DeliveredCount();
+}
+
+uint64_t LoopbackNetwork::DroppedCount() const {
+  return impl_->DroppedCount();
+}
+
+void LoopbackNetwork::send(std::vector<yaraft::pb::Message> &mails) {
+  impl_->Send(mails);
+}
+
+}  // namespace rpc
+}  // namespace consensus
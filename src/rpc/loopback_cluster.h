@@ -0,0 +1,114 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+
+#include "rpc/cluster.h"
+
+#include <silly/disallow_copying.h>
+
+namespace consensus {
+
+class RaftTaskExecutor;
+
+namespace rpc {
+
+struct LoopbackNetworkOptions {
+  // one-way delay of every message.
+  // Default: 0
+  std::chrono::microseconds latency;
+
+  // bytes per second of each directed link, messages on the same link are
+  // transmitted one after another. 0 means unlimited.
+  // Default: 0
+  uint64_t bandwidth;
+
+  // probability in [0, 1] that a message is dropped.
+  // Default: 0
+  double drop_rate;
+
+  // seed of the random generator that decides which messages to drop, a fixed seed
+  // gives the same drops for the same sequence of messages.
+  // Default: 0
+  uint32_t seed;
+
+  LoopbackNetworkOptions();
+};
+
+// LoopbackNetwork connects raft nodes living in the same process. Messages passed to
+// the clusters created by NewCluster are stepped directly into the receiver's
+// RaftTaskExecutor, after the injected latency and transmission delay.
+// It's intended for tests and benchmarks of multiple nodes in a single binary.
+//
+// Usage:
+//
+//    LoopbackNetwork network(options);
+//    for (uint64_t id : {1, 2, 3}) {
+//      logOptions.cluster = network.NewCluster();
+//      ...
+//      ReplicatedLog* log = ReplicatedLog::New(logOptions).GetValue();
+//      network.Register(id, log->RaftTaskExecutorInstance());
+//    }
+//
+// Thread-Safe
+class LoopbackNetwork {
+  __DISALLOW_COPYING__(LoopbackNetwork);
+
+ public:
+  explicit LoopbackNetwork(const LoopbackNetworkOptions& options);
+
+  // Undelivered messages are discarded.
+  // The network must outlive all the clusters it created.
+  ~LoopbackNetwork();
+
+  // Messages to node `id` are delivered to `executor`. Messages to unregistered
+  // nodes are dropped.
+  void Register(uint64_t id, RaftTaskExecutor* executor);
+
+  void Unregister(uint64_t id);
+
+  // Returns a cluster which sends messages through this network.
+  // The caller takes the ownership.
+  Cluster* NewCluster();
+
+  // Cuts the links between node `a` and `b`, in both directions.
+  void Partition(uint64_t a, uint64_t b);
+
+  // Cuts the links between node `id` and all the other nodes.
+  void Isolate(uint64_t id);
+
+  // Restores all the links.
+  void Heal();
+
+  // The number of messages delivered to receivers.
+  uint64_t DeliveredCount() const;
+
+  // The number of messages dropped, either randomly or by partitions.
+  uint64_t DroppedCount() const;
+
+ private:
+  friend class LoopbackCluster;
+
+  void send(std::vector<yaraft::pb::Message>& mails);
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace rpc
+}  // namespace consensus
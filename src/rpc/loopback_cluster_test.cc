@@ -0,0 +1,120 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "raft_task_executor_test.h"
+#include "base/simple_channel.h"
+#include "rpc/loopback_cluster.h"
+
+using namespace consensus;
+using namespace consensus::rpc;
+
+class LoopbackClusterTest : public RaftTaskExecutorTest {
+ public:
+  // Passes a heartbeat from node 1 to node 2 through `network`.
+  static void passHeartbeat(LoopbackNetwork *network) {
+    std::unique_ptr<Cluster> cluster(network->NewCluster());
+
+    std::vector<yaraft::pb::Message> mails(1);
+    mails[0].set_type(yaraft::pb::MsgHeartbeat);
+    mails[0].set_from(1);
+    mails[0].set_to(2);
+    mails[0].set_term(1);
+    ASSERT_OK(cluster->Pass(mails));
+  }
+
+  // Waits at most 2 seconds until `count` messages are either delivered or dropped.
+  static void waitForMessages(LoopbackNetwork *network, uint64_t count) {
+    for (int i = 0; i < 2000; i++) {
+      if (network->DeliveredCount() + network->DroppedCount() >= count) {
+        return;
+      }
+      usleep(1000);
+    }
+  }
+};
+
+TEST_F(LoopbackClusterTest, Deliver) {
+  conf_->id = 2;
+  yaraft::RawNode node(conf_);
+  RaftTaskExecutor executor(&node, taskQueue_);
+
+  LoopbackNetwork network(LoopbackNetworkOptions{});
+  network.Register(2, &executor);
+
+  passHeartbeat(&network);
+  waitForMessages(&network, 1);
+  ASSERT_EQ(network.DeliveredCount(), 1);
+
+  Barrier barrier;
+  uint64_t term = 0;
+  executor.Submit([&](yaraft::RawNode *n) {
+    term = n->CurrentTerm();
+    barrier.Signal();
+  });
+  barrier.Wait();
+  ASSERT_EQ(term, 1);
+}
+
+TEST_F(LoopbackClusterTest, PartitionAndHeal) {
+  conf_->id = 2;
+  yaraft::RawNode node(conf_);
+  RaftTaskExecutor executor(&node, taskQueue_);
+
+  LoopbackNetwork network(LoopbackNetworkOptions{});
+  network.Register(2, &executor);
+
+  network.Partition(1, 2);
+  passHeartbeat(&network);
+  ASSERT_EQ(network.DroppedCount(), 1);
+
+  network.Heal();
+  network.Isolate(1);
+  passHeartbeat(&network);
+  ASSERT_EQ(network.DroppedCount(), 2);
+
+  network.Heal();
+  passHeartbeat(&network);
+  waitForMessages(&network, 3);
+  ASSERT_EQ(network.DeliveredCount(), 1);
+}
+
+TEST_F(LoopbackClusterTest, DropAll) {
+  LoopbackNetworkOptions options;
+  options.drop_rate = 1;
+  LoopbackNetwork network(options);
+
+  for (int i = 0; i < 10; i++) {
+    passHeartbeat(&network);
+  }
+  ASSERT_EQ(network.DroppedCount(), 10);
+  ASSERT_EQ(network.DeliveredCount(), 0);
+}
+
+TEST_F(LoopbackClusterTest, Latency) {
+  conf_->id = 2;
+  yaraft::RawNode node(conf_);
+  RaftTaskExecutor executor(&node, taskQueue_);
+
+  LoopbackNetworkOptions options;
+  options.latency = std::chrono::milliseconds(200);
+  LoopbackNetwork network(options);
+  network.Register(2, &executor);
+
+  passHeartbeat(&network);
+  usleep(50 * 1000);
+  ASSERT_EQ(network.DeliveredCount(), 0);
+
+  waitForMessages(&network, 1);
+  ASSERT_EQ(network.DeliveredCount(), 1);
+}
@@ -0,0 +1,190 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <mutex>
+#include <unordered_map>
+
+#include "base/coding.h"
+#include "base/logging.h"
+#include "rpc/message_codec.h"
+
+#include <boost/crc.hpp>
+#include <brpc/policy/gzip_compress.h>
+#include <brpc/policy/snappy_compress.h>
+
+namespace consensus {
+namespace rpc {
+
+static bool compress(pb::CompressType type, const butil::IOBuf &in, butil::IOBuf *out) {
+  switch (type) {
+    case pb::COMPRESS_SNAPPY:
+      return brpc::policy::SnappyCompress(in, out);
+    case pb::COMPRESS_ZLIB:
+      return brpc::policy::ZlibCompress(in, out, nullptr);
+    default:
+      return false;
+  }
+}
+
+static bool decompress(pb::CompressType type, const butil::IOBuf &in, butil::IOBuf *out) {
+  switch (type) {
+    case pb::COMPRESS_SNAPPY:
+      return brpc::policy::SnappyDecompress(in, out);
+    case pb::COMPRESS_ZLIB:
+      return brpc::policy::ZlibDecompress(in, out);
+    default:
+      return false;
+  }
+}
+
+// The payloads referenced by IOBufs, keyed by their data. IOBuf::append_user_data
+// takes a plain function as the deleter, which is only passed the data, so the
+// string owning it is looked up here.
+static std::mutex g_payloads_mu;
+static std::unordered_map<const void *, std::string *> g_payloads;
+
+static void deletePayload(void *data) {
+  std::string *p;
+  {
+    std::lock_guard<std::mutex> g(g_payloads_mu);
+    auto it = g_payloads.find(data);
+    DCHECK(it != g_payloads.end());
+    p = it->second;
+    g_payloads.erase(it);
+  }
+  delete p;
+}
+
+static void encodeBody(yaraft::pb::Message *msg, butil::IOBuf *buf) {
+  std::vector<std::string *> payloads;
+  payloads.reserve(msg->entries_size());
+  for (auto &e : *msg->mutable_entries()) {
+    payloads.push_back(e.release_data());
+  }
+
+  std::string header;
+  PutVarint32(&header, static_cast<uint32_t>(msg->ByteSizeLong()));
+  msg->AppendToString(&header);
+  for (const std::string *p : payloads) {
+    PutVarint32(&header, static_cast<uint32_t>(p ? p->size() : 0));
+  }
+
+  char headerLen[4];
+  EncodeFixed32(headerLen, static_cast<uint32_t>(header.size()));
+  buf->append(headerLen, sizeof(headerLen));
+  buf->append(header);
+
+  for (std::string *p : payloads) {
+    if (p == nullptr) {
+      continue;
+    }
+    if (p->size() >= kZeroCopyPayloadSize) {
+      // the string is released along with the last IOBuf referencing its data.
+      {
+        std::lock_guard<std::mutex> g(g_payloads_mu);
+        g_payloads[&(*p)[0]] = p;
+      }
+      buf->append_user_data(&(*p)[0], p->size(), &deletePayload);
+    } else {
+      buf->append(*p);
+      delete p;
+    }
+  }
+}
+
+void EncodeMessage(yaraft::pb::Message *msg, butil::IOBuf *buf, pb::CompressType compressType,
+                   size_t minCompressSize) {
+  butil::IOBuf body;
+  encodeBody(msg, &body);
+
+  if (compressType != pb::COMPRESS_NONE && body.size() >= minCompressSize) {
+    butil::IOBuf compressed;
+    if (compress(compressType, body, &compressed) && compressed.size() < body.size()) {
+      buf->push_back(static_cast<char>(compressType));
+      buf->append(compressed);
+      return;
+    }
+  }
+
+  buf->push_back(static_cast<char>(pb::COMPRESS_NONE));
+  buf->append(body);
+}
+
+static Status decodeBody(butil::IOBuf *buf, yaraft::pb::Message *msg);
+
+Status DecodeMessage(butil::IOBuf *buf, yaraft::pb::Message *msg) {
+  char type;
+  if (UNLIKELY(buf->cut1(&type) != 0)) {
+    return Status::Make(Error::Corruption, "bad message frame: empty frame");
+  }
+  auto compressType = static_cast<pb::CompressType>(type);
+  if (compressType == pb::COMPRESS_NONE) {
+    return decodeBody(buf, msg);
+  }
+
+  butil::IOBuf body;
+  if (UNLIKELY(!decompress(compressType, *buf, &body))) {
+    return FMT_Status(Corruption, "bad message frame: unable to decompress body of type {}",
+                      static_cast<int>(type));
+  }
+  buf->clear();
+  return decodeBody(&body, msg);
+}
+
+static Status decodeBody(butil::IOBuf *buf, yaraft::pb::Message *msg) {
+  char headerLenBuf[4];
+  if (UNLIKELY(buf->cutn(headerLenBuf, sizeof(headerLenBuf)) != sizeof(headerLenBuf))) {
+    return Status::Make(Error::Corruption, "bad message frame: missing header length");
+  }
+  uint32_t headerLen = DecodeFixed32(headerLenBuf);
+
+  std::string header;
+  if (UNLIKELY(buf->cutn(&header, headerLen) != headerLen)) {
+    return Status::Make(Error::Corruption, "bad message frame: truncated header");
+  }
+
+  Slice input(header);
+  uint32_t metaLen;
+  if (UNLIKELY(!GetVarint32(&input, &metaLen) || input.size() < metaLen)) {
+    return Status::Make(Error::Corruption, "bad message frame: bad meta length");
+  }
+  if (UNLIKELY(!msg->ParseFromArray(input.data(), metaLen))) {
+    return Status::Make(Error::Corruption, "bad message frame: unable to parse meta");
+  }
+  input.Skip(metaLen);
+
+  for (auto &e : *msg->mutable_entries()) {
+    uint32_t size;
+    if (UNLIKELY(!GetVarint32(&input, &size))) {
+      return Status::Make(Error::Corruption, "bad message frame: bad payload size");
+    }
+    if (UNLIKELY(buf->cutn(e.mutable_data(), size) != size)) {
+      return FMT_Status(Corruption, "bad message frame: truncated payload of entry {}",
+                        e.index());
+    }
+  }
+  return Status::OK();
+}
+
+uint32_t ChecksumIOBuf(const butil::IOBuf &buf) {
+  boost::crc_32_type crc;
+  for (size_t i = 0; i < buf.backing_block_num(); i++) {
+    auto block = buf.backing_block(i);
+    crc.process_bytes(block.data(), block.size());
+  }
+  return static_cast<uint32_t>(crc.checksum());
+}
+
+}  // namespace rpc
+}  // namespace consensus
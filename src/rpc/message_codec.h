@@ -0,0 +1,57 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "base/status.h"
+#include "pb/raft_server.pb.h"
+
+#include <butil/iobuf.h>
+#include <yaraft/pb/raftpb.pb.h>
+
+namespace consensus {
+namespace rpc {
+
+//  Format of an encoded raft message:
+//
+//  Frame := CompressType Body
+//  Body := HeaderLength Header Payload*
+//  Header := Varint32(MetaLength) Meta Varint32(PayloadSize)*
+//
+//  CompressType -> 1 byte, the pb::CompressType that Body is compressed with
+//  HeaderLength -> 4 bytes, length of Header
+//  Meta         -> the serialized yaraft.pb.Message, with the data of every entry moved out
+//  PayloadSize  -> size of each entry's data, in the order of entries
+//  Payload      -> data of each entry
+//
+// Payloads equal to or larger than kZeroCopyPayloadSize are referenced by the IOBuf
+// instead of being copied into it, unless the body is compressed.
+
+constexpr static size_t kZeroCopyPayloadSize = 4096;
+
+// Encodes `msg` into `buf`. The data of entries are moved out of `msg`, so it
+// shouldn't be used afterwards.
+// The body is compressed with `compressType` if it's at least `minCompressSize` bytes.
+// It's left uncompressed if compression doesn't make it smaller.
+void EncodeMessage(yaraft::pb::Message* msg, butil::IOBuf* buf,
+                   pb::CompressType compressType = pb::COMPRESS_NONE, size_t minCompressSize = 0);
+
+// Decodes a frame encoded by EncodeMessage. `buf` is consumed.
+Status DecodeMessage(butil::IOBuf* buf, yaraft::pb::Message* msg);
+
+// Returns the CRC32 of the data in `buf`.
+uint32_t ChecksumIOBuf(const butil::IOBuf& buf);
+
+}  // namespace rpc
+}  // namespace consensus
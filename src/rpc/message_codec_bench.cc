@@ -0,0 +1,128 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/logging.h"
+#include "rpc/message_codec.h"
+
+#include <benchmark/benchmark.h>
+#include <yaraft/pb_utils.h>
+
+using namespace consensus;
+using namespace consensus::rpc;
+
+static yaraft::pb::Message makeAppend(size_t per_size, int num_entries) {
+  std::string data(per_size, 'a');
+  yaraft::pb::Message msg;
+  msg.set_type(yaraft::pb::MsgApp);
+  msg.set_to(2);
+  msg.set_from(1);
+  for (int i = 0; i < num_entries; i++) {
+    *msg.add_entries() = yaraft::PBEntry().Index(i + 1).Term(1).Data(data).v;
+  }
+  return msg;
+}
+
+// The path taken before messages were encoded by EncodeMessage: the message is
+// copied out of Ready, serialized into an IOBuf, and parsed on the receiver.
+void SerializeCopyBench(benchmark::State& state) {
+  size_t per_size = state.range(0);
+  int num_entries = state.range(1);
+  yaraft::pb::Message msg = makeAppend(per_size, num_entries);
+
+  while (state.KeepRunning()) {
+    yaraft::pb::Message copied(msg);
+
+    butil::IOBuf buf;
+    butil::IOBufAsZeroCopyOutputStream output(&buf);
+    CHECK(copied.SerializeToZeroCopyStream(&output));
+
+    yaraft::pb::Message received;
+    butil::IOBufAsZeroCopyInputStream input(buf);
+    CHECK(received.ParseFromZeroCopyStream(&input));
+  }
+
+  state.SetBytesProcessed(state.iterations() * per_size * num_entries);
+}
+
+// The message is swapped out of Ready, its payloads are moved into the IOBuf and
+// decoded on the receiver.
+void ZeroCopyEncodeBench(benchmark::State& state) {
+  size_t per_size = state.range(0);
+  int num_entries = state.range(1);
+  yaraft::pb::Message msg = makeAppend(per_size, num_entries);
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    yaraft::pb::Message ready(msg);
+    state.ResumeTiming();
+
+    yaraft::pb::Message swapped;
+    swapped.Swap(&ready);
+
+    butil::IOBuf buf;
+    EncodeMessage(&swapped, &buf);
+
+    yaraft::pb::Message received;
+    FATAL_NOT_OK(DecodeMessage(&buf, &received), "DecodeMessage");
+  }
+
+  state.SetBytesProcessed(state.iterations() * per_size * num_entries);
+}
+
+// Same as ZeroCopyEncodeBench, but the frame is compressed with pb::CompressType range(2).
+// The payloads are highly compressible.
+void CompressedEncodeBench(benchmark::State& state) {
+  size_t per_size = state.range(0);
+  int num_entries = state.range(1);
+  auto compressType = static_cast<pb::CompressType>(state.range(2));
+  yaraft::pb::Message msg = makeAppend(per_size, num_entries);
+
+  size_t wireBytes = 0;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    yaraft::pb::Message ready(msg);
+    state.ResumeTiming();
+
+    butil::IOBuf buf;
+    EncodeMessage(&ready, &buf, compressType);
+    wireBytes = buf.size();
+
+    yaraft::pb::Message received;
+    FATAL_NOT_OK(DecodeMessage(&buf, &received), "DecodeMessage");
+  }
+
+  state.SetBytesProcessed(state.iterations() * per_size * num_entries);
+  state.SetLabel(fmt::format("wire bytes: {}", wireBytes).c_str());
+}
+
+BENCHMARK(SerializeCopyBench)
+    ->Args({1024, 64})
+    ->Args({64 * 1024, 1})
+    ->Args({64 * 1024, 16})
+    ->Args({64 * 1024, 64})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(ZeroCopyEncodeBench)
+    ->Args({1024, 64})
+    ->Args({64 * 1024, 1})
+    ->Args({64 * 1024, 16})
+    ->Args({64 * 1024, 64})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(CompressedEncodeBench)
+    ->Args({64 * 1024, 16, pb::COMPRESS_SNAPPY})
+    ->Args({64 * 1024, 16, pb::COMPRESS_ZLIB})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,99 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/testing.h"
+#include "rpc/message_codec.h"
+
+#include <yaraft/pb_utils.h>
+
+using namespace consensus;
+using namespace consensus::rpc;
+
+class MessageCodecTest : public BaseTest {};
+
+TEST_F(MessageCodecTest, EncodeAndDecode) {
+  struct TestData {
+    std::vector<size_t> sizes;
+  } tests[] = {
+      {{}},
+      {{0}},
+      {{10, 0, 100}},
+      {{kZeroCopyPayloadSize - 1, kZeroCopyPayloadSize, 64 * 1024}},
+  };
+
+  for (auto t : tests) {
+    yaraft::pb::Message msg;
+    msg.set_type(yaraft::pb::MsgApp);
+    msg.set_to(2);
+    msg.set_from(1);
+    msg.set_index(5);
+    for (size_t i = 0; i < t.sizes.size(); i++) {
+      std::string data(t.sizes[i], static_cast<char>('a' + i));
+      *msg.add_entries() = yaraft::PBEntry().Index(i + 6).Term(1).Data(data).v;
+    }
+    yaraft::pb::Message expected(msg);
+
+    butil::IOBuf buf;
+    EncodeMessage(&msg, &buf);
+
+    yaraft::pb::Message actual;
+    ASSERT_OK(DecodeMessage(&buf, &actual));
+    ASSERT_TRUE(buf.empty());
+    ASSERT_EQ(actual.SerializeAsString(), expected.SerializeAsString());
+  }
+}
+
+TEST_F(MessageCodecTest, DecodeTruncated) {
+  yaraft::pb::Message msg;
+  msg.set_type(yaraft::pb::MsgApp);
+  *msg.add_entries() = yaraft::PBEntry().Index(1).Term(1).Data(std::string(100, 'a')).v;
+
+  butil::IOBuf buf;
+  EncodeMessage(&msg, &buf);
+  buf.pop_back(1);
+
+  yaraft::pb::Message actual;
+  ASSERT_EQ(DecodeMessage(&buf, &actual).Code(), Error::Corruption);
+}
+
+TEST_F(MessageCodecTest, Compression) {
+  struct TestData {
+    pb::CompressType type;
+    size_t minCompressSize;
+    bool compressed;
+  } tests[] = {
+      {pb::COMPRESS_NONE, 0, false},
+      {pb::COMPRESS_SNAPPY, 0, true},
+      {pb::COMPRESS_ZLIB, 0, true},
+      {pb::COMPRESS_SNAPPY, 1024 * 1024, false},
+  };
+
+  for (auto t : tests) {
+    yaraft::pb::Message msg;
+    msg.set_type(yaraft::pb::MsgApp);
+    for (int i = 0; i < 4; i++) {
+      *msg.add_entries() =
+          yaraft::PBEntry().Index(i + 1).Term(1).Data(std::string(64 * 1024, 'a')).v;
+    }
+    yaraft::pb::Message expected(msg);
+
+    butil::IOBuf buf;
+    EncodeMessage(&msg, &buf, t.type, t.minCompressSize);
+    ASSERT_EQ(buf.size() < expected.ByteSizeLong(), t.compressed);
+
+    yaraft::pb::Message actual;
+    ASSERT_OK(DecodeMessage(&buf, &actual));
+    ASSERT_EQ(actual.SerializeAsString(), expected.SerializeAsString());
+  }
+}
@@ -20,23 +20,54 @@
 namespace consensus {
 namespace rpc {
 
-Peer::Peer(const std::string& url) : client_(new AsyncRaftClient(url)) {}
+Peer::Peer(const std::string& url, const ClusterOptions& options)
+    : client_(std::make_shared<StreamingRaftClient>(url, options)) {}
+
+Peer::~Peer() {
+  client_->Close();
+}
 
 void Peer::AsyncSend(yaraft::pb::Message* msg) {
-  client_->Step(msg);
+  client_->Send(msg);
+}
+
+StatusWith<uint64_t> Peer::ReadIndex() {
+  return client_->ReadIndex();
+}
+
+PeerStatus Peer::GetStatus() const {
+  return client_->GetStatus();
 }
 
 Status PeerManager::Pass(std::vector<yaraft::pb::Message>& mails) {
-  for (const auto& m : mails) {
+  for (auto& m : mails) {
     CHECK(m.to() != 0);
     CHECK(peerMap_.find(m.to()) != peerMap_.end());
 
-    auto newMsg = new yaraft::pb::Message(std::move(m));
-    peerMap_[m.to()]->AsyncSend(newMsg);
+    // Swap rather than copy, the entries in `mails` may carry large payloads.
+    auto newMsg = new yaraft::pb::Message;
+    newMsg->Swap(&m);
+    peerMap_[newMsg->to()]->AsyncSend(newMsg);
   }
   return Status::OK();
 }
 
+StatusWith<uint64_t> PeerManager::ReadIndex(uint64_t leader) {
+  auto it = peerMap_.find(leader);
+  if (it == peerMap_.end()) {
+    return FMT_Status(NotLeader, "leader {} is not a peer", leader);
+  }
+  return it->second->ReadIndex();
+}
+
+std::map<uint64_t, PeerStatus> PeerManager::PeerStatuses() const {
+  std::map<uint64_t, PeerStatus> statuses;
+  for (const auto& e : peerMap_) {
+    statuses[e.first] = e.second->GetStatus();
+  }
+  return statuses;
+}
+
 PeerManager::~PeerManager() {
   STLDeleteContainerPairSecondPointers(peerMap_.begin(), peerMap_.end());
 }
@@ -23,15 +23,22 @@
 namespace consensus {
 namespace rpc {
 
-class AsyncRaftClient;
+class StreamingRaftClient;
 class Peer {
  public:
-  explicit Peer(const std::string& url);
+  Peer(const std::string& url, const ClusterOptions& options);
 
+  ~Peer();
+
+  // Takes the ownership of `msg`.
   void AsyncSend(yaraft::pb::Message* msg);
 
+  StatusWith<uint64_t> ReadIndex();
+
+  PeerStatus GetStatus() const;
+
  private:
-  std::unique_ptr<AsyncRaftClient> client_;
+  std::shared_ptr<StreamingRaftClient> client_;
 };
 
 class PeerManager : public Cluster {
@@ -42,6 +49,10 @@ class PeerManager : public Cluster {
 
   Status Pass(std::vector<yaraft::pb::Message>& mails) override;
 
+  StatusWith<uint64_t> ReadIndex(uint64_t leader) override;
+
+  std::map<uint64_t, PeerStatus> PeerStatuses() const override;
+
  private:
   std::map<uint64_t, Peer*> peerMap_;
 };
@@ -0,0 +1,370 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "rpc/raft_client.h"
+#include "rpc/message_codec.h"
+
+#include <bthread/bthread.h>
+#include <bvar/bvar.h>
+
+namespace consensus {
+namespace rpc {
+
+// failures of the rpcs and the streams to the peers, of all the clients in the process.
+static bvar::Adder<int64_t> g_rpc_failures("consensus_rpc_failures");
+static bvar::PerSecond<bvar::Adder<int64_t>> g_rpc_failures_second(
+    "consensus_rpc_failures_second", &g_rpc_failures);
+
+// messages dropped as the peers fall too far behind.
+static bvar::Adder<int64_t> g_rpc_dropped_messages("consensus_rpc_dropped_messages");
+
+// Interval between two attempts to establish the stream to an unreachable peer.
+static const auto kStreamRetryInterval = std::chrono::milliseconds(1000);
+
+// StreamHandler receives acks on behalf of the client. It's bound to a single
+// stream, and deletes itself once the stream is closed.
+class StreamingRaftClient::StreamHandler : public brpc::StreamInputHandler {
+ public:
+  explicit StreamHandler(std::shared_ptr<StreamingRaftClient> client)
+      : client_(std::move(client)) {}
+
+  int on_received_messages(brpc::StreamId id, butil::IOBuf *const messages[],
+                           size_t size) override {
+    for (size_t i = 0; i < size; i++) {
+      pb::StepStreamAck ack;
+      butil::IOBufAsZeroCopyInputStream wrapper(*messages[i]);
+      if (UNLIKELY(!ack.ParseFromZeroCopyStream(&wrapper))) {
+        LOG(ERROR) << "StreamingRaftClient: unable to parse StepStreamAck";
+        continue;
+      }
+      client_->onAck(id);
+    }
+    return 0;
+  }
+
+  void on_idle_timeout(brpc::StreamId id) override {}
+
+  void on_closed(brpc::StreamId id) override {
+    client_->onClosed(id);
+    delete this;
+  }
+
+ private:
+  std::shared_ptr<StreamingRaftClient> client_;
+};
+
+struct StreamingRaftClient::OpenCall {
+  std::shared_ptr<StreamingRaftClient> client;
+  brpc::StreamId stream;
+
+  brpc::Controller cntl;
+  pb::StepStreamRequest request;
+  pb::StepStreamResponse response;
+};
+
+StreamingRaftClient::StreamingRaftClient(const std::string &url, const ClusterOptions &options)
+    : options_(options),
+      stream_(brpc::INVALID_STREAM_ID),
+      streamReady_(false),
+      streamOpening_(false),
+      waitingWritable_(false),
+      draining_(false),
+      closed_(false),
+      compressType_(pb::COMPRESS_NONE),
+      inflight_(0) {
+  brpc::ChannelOptions channelOptions;
+  channelOptions.max_retry = 0;  // no retry
+  channelOptions.connect_timeout_ms = 2000;
+  channel_.Init(url.c_str(), &channelOptions);
+
+  snapshotSender_.reset(new SnapshotSender(&channel_, options));
+}
+
+void StreamingRaftClient::Send(yaraft::pb::Message *msg) {
+  if (msg->type() == yaraft::pb::MsgSnap) {
+    snapshotSender_->Send(msg);
+    return;
+  }
+
+  // The message is encoded by drainPending, off the caller thread.
+  Frame frame;
+  frame.to = msg->to();
+  frame.isApp = msg->type() == yaraft::pb::MsgApp;
+  frame.msg.reset(msg);
+
+  std::lock_guard<std::mutex> g(mu_);
+  if (closed_) {
+    return;
+  }
+
+  openStreamIfNecessary();
+
+  if (enqueue(std::move(frame)) && streamReady_) {
+    scheduleDrain();
+  }
+}
+
+bool StreamingRaftClient::enqueue(Frame &&frame) {
+  if (pending_.size() >= options_.max_pending_appends) {
+    g_rpc_dropped_messages << 1;
+    LOG_EVERY_N(WARNING, 100) << "StreamingRaftClient: too many pending messages to "
+                              << frame.to << ", dropping message";
+    return false;
+  }
+
+  if (frame.isApp) {
+    pending_.push_back(std::move(frame));
+  } else {
+    auto it = std::find_if(pending_.begin(), pending_.end(),
+                           [](const Frame &f) { return f.isApp; });
+    pending_.insert(it, std::move(frame));
+  }
+  return true;
+}
+
+void StreamingRaftClient::Close() {
+  snapshotSender_->Stop();
+
+  std::lock_guard<std::mutex> g(mu_);
+  closed_ = true;
+  pending_.clear();
+  if (streamReady_) {
+    brpc::StreamClose(stream_);
+  }
+}
+
+PeerStatus StreamingRaftClient::GetStatus() const {
+  std::lock_guard<std::mutex> g(mu_);
+  PeerStatus status;
+  status.inflight_appends = inflight_;
+  status.pending_messages = static_cast<uint32_t>(pending_.size());
+  return status;
+}
+
+StatusWith<uint64_t> StreamingRaftClient::ReadIndex() {
+  brpc::Controller cntl;
+  cntl.set_timeout_ms(5000);
+
+  pb::ReadIndexRequest request;
+  request.set_group(options_.group_id);
+  pb::ReadIndexResponse response;
+  pb::RaftService_Stub stub(&channel_);
+  stub.ReadIndex(&cntl, &request, &response, nullptr);
+  if (cntl.Failed()) {
+    g_rpc_failures << 1;
+    return FMT_Status(RuntimeError, "ReadIndex rpc failed: {}", cntl.ErrorText());
+  }
+  if (response.code() != pb::OK) {
+    return FMT_Status(NotLeader, "ReadIndex rejected by the leader: {}", response.message());
+  }
+  return response.read_index();
+}
+
+void StreamingRaftClient::openStreamIfNecessary() {
+  if (streamReady_ || streamOpening_) {
+    return;
+  }
+  if (std::chrono::steady_clock::now() - lastOpenFailure_ < kStreamRetryInterval) {
+    return;
+  }
+
+  auto call = new OpenCall;
+  call->client = shared_from_this();
+  call->cntl.set_timeout_ms(3000);
+  call->request.set_compress_type(options_.compress_type);
+  call->request.set_group(options_.group_id);
+
+  brpc::StreamOptions streamOptions;
+  streamOptions.handler = new StreamHandler(shared_from_this());
+  if (brpc::StreamCreate(&call->stream, call->cntl, &streamOptions) != 0) {
+    LOG(ERROR) << "StreamingRaftClient: failed to create stream";
+    g_rpc_failures << 1;
+    lastOpenFailure_ = std::chrono::steady_clock::now();
+    delete streamOptions.handler;
+    delete call;
+    return;
+  }
+
+  streamOpening_ = true;
+  pb::RaftService_Stub stub(&channel_);
+  stub.StepStream(&call->cntl, &call->request, &call->response,
+                  brpc::NewCallback(&StreamingRaftClient::onStreamOpened, call));
+}
+
+void StreamingRaftClient::onStreamOpened(OpenCall *call) {
+  std::unique_ptr<OpenCall> g(call);
+  StreamingRaftClient *client = call->client.get();
+
+  std::lock_guard<std::mutex> lock(client->mu_);
+  client->streamOpening_ = false;
+
+  if (call->cntl.Failed() || call->response.code() != pb::OK) {
+    FMT_SLOG(ERROR, "StreamingRaftClient: failed to open stream: %s",
+             call->cntl.Failed() ? call->cntl.ErrorText().c_str()
+                                 : pb::StatusCode_Name(call->response.code()).c_str());
+    g_rpc_failures << 1;
+    client->lastOpenFailure_ = std::chrono::steady_clock::now();
+    brpc::StreamClose(call->stream);
+    return;
+  }
+
+  if (client->closed_) {
+    brpc::StreamClose(call->stream);
+    return;
+  }
+
+  client->stream_ = call->stream;
+  client->streamReady_ = true;
+  client->compressType_ = call->response.compress_type();
+  client->inflight_ = 0;
+  client->scheduleDrain();
+}
+
+void StreamingRaftClient::onStreamWritable(brpc::StreamId id, void *arg, int errorCode) {
+  std::unique_ptr<std::shared_ptr<StreamingRaftClient>> holder(
+      static_cast<std::shared_ptr<StreamingRaftClient> *>(arg));
+  StreamingRaftClient *client = holder->get();
+
+  std::lock_guard<std::mutex> g(client->mu_);
+  if (id != client->stream_ || !client->streamReady_) {
+    return;
+  }
+  client->waitingWritable_ = false;
+  if (errorCode == 0) {
+    client->scheduleDrain();
+  }
+}
+
+void StreamingRaftClient::onAck(brpc::StreamId id) {
+  std::lock_guard<std::mutex> g(mu_);
+  if (id != stream_) {
+    return;
+  }
+
+  if (inflight_ > 0) {
+    inflight_--;
+  }
+
+  if (streamReady_) {
+    scheduleDrain();
+  }
+}
+
+void StreamingRaftClient::onClosed(brpc::StreamId id) {
+  std::lock_guard<std::mutex> g(mu_);
+  if (id != stream_) {
+    return;
+  }
+
+  // Appends that were inflight may have been lost, raft will find out the gap
+  // by the follower's rejection and send them again.
+  stream_ = brpc::INVALID_STREAM_ID;
+  streamReady_ = false;
+  waitingWritable_ = false;
+  inflight_ = 0;
+}
+
+void StreamingRaftClient::scheduleDrain() {
+  if (draining_ || waitingWritable_ || pending_.empty()) {
+    return;
+  }
+
+  auto arg = new std::shared_ptr<StreamingRaftClient>(shared_from_this());
+  bthread_t tid;
+  if (UNLIKELY(bthread_start_background(&tid, nullptr, &StreamingRaftClient::runDrain, arg) !=
+               0)) {
+    LOG(ERROR) << "StreamingRaftClient: failed to start bthread to drain pending messages";
+    delete arg;
+    return;
+  }
+  draining_ = true;
+}
+
+void *StreamingRaftClient::runDrain(void *arg) {
+  std::unique_ptr<std::shared_ptr<StreamingRaftClient>> holder(
+      static_cast<std::shared_ptr<StreamingRaftClient> *>(arg));
+  (*holder)->drainPending();
+  return nullptr;
+}
+
+void StreamingRaftClient::drainPending() {
+  std::unique_lock<std::mutex> lock(mu_);
+  while (streamReady_ && !waitingWritable_ && !pending_.empty()) {
+    if (pending_.front().isApp && inflight_ >= options_.max_inflight_appends) {
+      break;
+    }
+    Frame frame = std::move(pending_.front());
+    pending_.pop_front();
+
+    if (frame.msg) {
+      // Encoding and compression are done out of the lock, with the compression
+      // accepted on the current stream. Entry payloads are moved into the frame
+      // rather than copied.
+      frame.stream = stream_;
+      pb::CompressType compressType = compressType_;
+      lock.unlock();
+      EncodeMessage(frame.msg.get(), &frame.buf, compressType, options_.min_compress_size);
+      frame.msg.reset();
+      lock.lock();
+    }
+
+    if (closed_) {
+      break;
+    }
+    if (frame.stream != stream_) {
+      // the stream the message was encoded for is gone, raft will send it again.
+      g_rpc_dropped_messages << 1;
+      continue;
+    }
+
+    int rc = write(frame);
+    if (rc == EAGAIN) {
+      pending_.push_front(std::move(frame));
+      waitForWritable();
+      break;
+    } else if (rc != 0) {
+      // the stream is broken, the rest of the messages are kept until it's re-established.
+      g_rpc_dropped_messages << 1;
+      break;
+    }
+
+    if (frame.isApp) {
+      inflight_++;
+    }
+  }
+  draining_ = false;
+}
+
+int StreamingRaftClient::write(const Frame &frame) {
+  // StreamWrite only takes references of the blocks in frame.buf, the frame
+  // can be written again if it fails with EAGAIN.
+  int rc = brpc::StreamWrite(stream_, frame.buf);
+  if (UNLIKELY(rc != 0 && rc != EAGAIN)) {
+    FMT_LOG(ERROR, "StreamingRaftClient: failed to write stream to {}: {}", frame.to,
+            strerror(rc));
+    g_rpc_failures << 1;
+  }
+  return rc;
+}
+
+void StreamingRaftClient::waitForWritable() {
+  waitingWritable_ = true;
+  brpc::StreamWait(stream_, nullptr, &StreamingRaftClient::onStreamWritable,
+                   new std::shared_ptr<StreamingRaftClient>(shared_from_this()));
+}
+
+}  // namespace rpc
+}  // namespace consensus
@@ -14,52 +14,135 @@
 
 #pragma once
 
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+
 #include "base/logging.h"
 #include "pb/raft_server.pb.h"
+#include "rpc/cluster.h"
+#include "rpc/snapshot_sender.h"
 
 #include <brpc/channel.h>
+#include <brpc/stream.h>
+#include <butil/iobuf.h>
 
 namespace consensus {
 namespace rpc {
 
-static void doneCallBack(pb::StepResponse* response, brpc::Controller* cntl) {
-  if (cntl->Failed()) {
-    FMT_SLOG(ERROR, "request failed: %s", cntl->ErrorText().c_str());
-  } else {
-    delete response;
-  }
-  delete cntl;
-}
-
-class AsyncRaftClient {
+// StreamingRaftClient sends raft messages to a single peer through a brpc stream,
+// so that messages arrive in the order they were sent.
+//
+// MsgApps are pipelined: up to `max_inflight_appends` of them can be on the wire
+// without being acknowledged by the follower, the rest wait in a bounded queue until
+// acks come back. This keeps a slow follower from making the leader buffer
+// unboundedly. The stream is ordered, so each ack releases the earliest inflight
+// MsgApp, i.e the window bounds the MsgApps sent beyond the follower's acked index. Other messages (heartbeats, votes, etc) are small and time-sensitive,
+// they're queued ahead of the MsgApps.
+//
+// Snapshots (MsgSnap) are not sent through the stream, but handed to a
+// SnapshotSender that transfers them in chunks.
+//
+// Messages are encoded and compressed when they're dequeued to be written, on a bthread,
+// so that the caller of Send (the ReadyFlusher) isn't held up by compression. They're
+// compressed with the compression negotiated on the stream they're written to, see
+// ClusterOptions::compress_type.
+//
+// The stream is established lazily and re-established after it's closed.
+// The client must be created by std::make_shared, and closed before released.
+//
+// Thread-Safe
+class StreamingRaftClient : public std::enable_shared_from_this<StreamingRaftClient> {
  public:
-  explicit AsyncRaftClient(const std::string& url) {
-    brpc::ChannelOptions options;
-    options.max_retry = 0;  // no retry
-    options.connect_timeout_ms = 2000;
-    channel_.Init(url.c_str(), &options);
-  }
+  StreamingRaftClient(const std::string& url, const ClusterOptions& options);
+
+  // Takes the ownership of `msg`.
+  void Send(yaraft::pb::Message* msg);
+
+  // Closes the stream and drops all pending messages. Send after Close is no-op.
+  void Close();
+
+  // Calls RaftService::ReadIndex on the peer, blocks until it responds.
+  StatusWith<uint64_t> ReadIndex();
+
+  PeerStatus GetStatus() const;
+
+ private:
+  // A message queued for the stream. `msg` is encoded into `buf` by EncodeMessage
+  // right before the message is first written.
+  struct Frame {
+    std::unique_ptr<yaraft::pb::Message> msg;
+    butil::IOBuf buf;
+    // the stream that `buf` was encoded for.
+    brpc::StreamId stream = brpc::INVALID_STREAM_ID;
+    uint64_t to;
+    bool isApp;
+  };
+
+  class StreamHandler;
+  struct OpenCall;
 
-  // Asynchronously sending request to specified url.
-  void Step(yaraft::pb::Message* msg) {
-    // -- prepare parameters --
+  // REQUIRES: mu_ held
+  void openStreamIfNecessary();
 
-    auto cntl = new brpc::Controller;
-    cntl->set_timeout_ms(3000);
+  static void onStreamOpened(OpenCall* call);
 
-    pb::StepRequest request;
-    request.set_allocated_message(msg);
-    auto response = new pb::StepResponse;
+  static void onStreamWritable(brpc::StreamId id, void* arg, int errorCode);
 
-    // -- request --
+  void onAck(brpc::StreamId id);
 
-    pb::RaftService_Stub stub(&channel_);
-    stub.Step(cntl, &request, response, brpc::NewCallback(&doneCallBack, response, cntl));
-  }
+  void onClosed(brpc::StreamId id);
+
+  // Queues a message until the stream is writable. Other messages are queued ahead
+  // of the appends, so that they don't wait for the inflight window.
+  // Returns false if the queue is full and the message is dropped.
+  // REQUIRES: mu_ held
+  bool enqueue(Frame&& frame);
+
+  // Starts a bthread to drainPending, unless one is running.
+  // REQUIRES: mu_ held
+  void scheduleDrain();
+
+  static void* runDrain(void* arg);
+
+  // Encodes and writes pending messages as far as the inflight window allows.
+  // Only one drainPending runs at a time, see draining_.
+  void drainPending();
+
+  // REQUIRES: mu_ held, streamReady_
+  int write(const Frame& frame);
+
+  // REQUIRES: mu_ held, streamReady_
+  void waitForWritable();
 
  private:
+  const ClusterOptions options_;
+
   brpc::Channel channel_;
+
+  std::unique_ptr<SnapshotSender> snapshotSender_;
+
+  mutable std::mutex mu_;
+
+  brpc::StreamId stream_;
+  bool streamReady_;
+  bool streamOpening_;
+  bool waitingWritable_;
+  bool draining_;
+  bool closed_;
+  std::chrono::steady_clock::time_point lastOpenFailure_;
+
+  // the compression accepted by the peer on the current stream.
+  pb::CompressType compressType_;
+
+  // Messages waiting for the stream to be established or writable, or for MsgApps,
+  // for a free slot in the inflight window. Other messages are ahead of MsgApps.
+  std::deque<Frame> pending_;
+
+  // the number of unacknowledged MsgApps on the current stream.
+  uint32_t inflight_;
 };
 
 }  // namespace rpc
-}  // namespace consensus
\ No newline at end of file
+}  // namespace consensus
@@ -0,0 +1,195 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "base/testing.h"
+#include "rpc/message_codec.h"
+#include "rpc/raft_client.h"
+
+#include <brpc/closure_guard.h>
+#include <brpc/server.h>
+
+using namespace consensus;
+using namespace consensus::rpc;
+
+// FakeFollower accepts the stream from a StreamingRaftClient, and records the messages
+// received from it. The MsgApps are acked only when the test asks for.
+class FakeFollower : public pb::RaftService, public brpc::StreamInputHandler {
+ public:
+  FakeFollower() : stream_(brpc::INVALID_STREAM_ID), closed_(false) {}
+
+  void StepStream(::google::protobuf::RpcController *controller,
+                  const pb::StepStreamRequest *request, pb::StepStreamResponse *response,
+                  ::google::protobuf::Closure *done) override {
+    brpc::ClosureGuard doneGuard(done);
+    auto cntl = static_cast<brpc::Controller *>(controller);
+
+    brpc::StreamOptions options;
+    options.handler = this;
+    brpc::StreamId stream;
+    if (brpc::StreamAccept(&stream, *cntl, &options) != 0) {
+      cntl->SetFailed("failed to accept stream");
+      return;
+    }
+
+    std::lock_guard<std::mutex> g(mu_);
+    stream_ = stream;
+    response->set_code(pb::OK);
+  }
+
+  int on_received_messages(brpc::StreamId id, butil::IOBuf *const messages[],
+                           size_t size) override {
+    std::lock_guard<std::mutex> g(mu_);
+    for (size_t i = 0; i < size; i++) {
+      yaraft::pb::Message msg;
+      consensus::Status s = DecodeMessage(messages[i], &msg);
+      EXPECT_TRUE(s.IsOK()) << s.ToString();
+      if (msg.type() == yaraft::pb::MsgApp) {
+        unacked_.push_back(msg.index());
+      }
+      received_.push_back(std::move(msg));
+    }
+    cond_.notify_all();
+    return 0;
+  }
+
+  void on_idle_timeout(brpc::StreamId id) override {}
+
+  void on_closed(brpc::StreamId id) override {
+    std::lock_guard<std::mutex> g(mu_);
+    closed_ = true;
+    cond_.notify_all();
+  }
+
+  // Acks the first `n` MsgApps that haven't been acked.
+  void Ack(size_t n) {
+    std::lock_guard<std::mutex> g(mu_);
+    for (size_t i = 0; i < n && !unacked_.empty(); i++) {
+      pb::StepStreamAck ack;
+      ack.set_index(unacked_.front());
+      unacked_.pop_front();
+
+      butil::IOBuf buf;
+      butil::IOBufAsZeroCopyOutputStream wrapper(&buf);
+      ack.SerializeToZeroCopyStream(&wrapper);
+      ASSERT_EQ(brpc::StreamWrite(stream_, buf), 0);
+    }
+  }
+
+  // Waits at most 2 seconds until `n` messages are received, and returns the type and
+  // the index of each message received, e.g "App:1", "Heartbeat:0".
+  std::vector<std::string> WaitReceived(size_t n) {
+    std::unique_lock<std::mutex> lock(mu_);
+    cond_.wait_for(lock, std::chrono::seconds(2), [&]() { return received_.size() >= n; });
+
+    std::vector<std::string> result;
+    for (const auto &m : received_) {
+      std::string type = yaraft::pb::MessageType_Name(m.type());
+      result.push_back(fmt::format("{}:{}", type.substr(3), m.index()));
+    }
+    return result;
+  }
+
+  // Waits at most 2 seconds until the stream is closed.
+  void WaitClosed() {
+    std::unique_lock<std::mutex> lock(mu_);
+    cond_.wait_for(lock, std::chrono::seconds(2), [&]() { return closed_; });
+  }
+
+ private:
+  std::mutex mu_;
+  std::condition_variable cond_;
+  brpc::StreamId stream_;
+  bool closed_;
+  std::vector<yaraft::pb::Message> received_;
+  std::deque<uint64_t> unacked_;
+};
+
+static const int kPort = 12358;
+
+class StreamingRaftClientTest : public BaseTest {
+ public:
+  void SetUp() override {
+    ASSERT_EQ(server_.AddService(&follower_, brpc::SERVER_DOESNT_OWN_SERVICE), 0);
+    ASSERT_EQ(server_.Start(kPort, nullptr), 0);
+
+    ClusterOptions options;
+    options.max_inflight_appends = 2;
+    client_ = std::make_shared<StreamingRaftClient>(fmt::format("127.0.0.1:{}", kPort), options);
+  }
+
+  void TearDown() override {
+    client_->Close();
+    follower_.WaitClosed();
+    server_.Stop(0);
+    server_.Join();
+  }
+
+  static yaraft::pb::Message *newMessage(yaraft::pb::MessageType type, uint64_t index) {
+    auto msg = new yaraft::pb::Message;
+    msg->set_type(type);
+    msg->set_from(1);
+    msg->set_to(2);
+    msg->set_index(index);
+    return msg;
+  }
+
+ protected:
+  FakeFollower follower_;
+  brpc::Server server_;
+  std::shared_ptr<StreamingRaftClient> client_;
+};
+
+TEST_F(StreamingRaftClientTest, InflightWindow) {
+  for (uint64_t i = 1; i <= 5; i++) {
+    client_->Send(newMessage(yaraft::pb::MsgApp, i));
+  }
+
+  using Received = std::vector<std::string>;
+  ASSERT_EQ(follower_.WaitReceived(2), (Received{"App:1", "App:2"}));
+
+  // the rest wait for the acks.
+  usleep(100 * 1000);
+  ASSERT_EQ(follower_.WaitReceived(0).size(), 2);
+  PeerStatus status = client_->GetStatus();
+  ASSERT_EQ(status.inflight_appends, 2);
+  ASSERT_EQ(status.pending_messages, 3);
+
+  follower_.Ack(1);
+  ASSERT_EQ(follower_.WaitReceived(3), (Received{"App:1", "App:2", "App:3"}));
+
+  follower_.Ack(3);
+  ASSERT_EQ(follower_.WaitReceived(5), (Received{"App:1", "App:2", "App:3", "App:4", "App:5"}));
+}
+
+TEST_F(StreamingRaftClientTest, NonAppendAheadOfAppends) {
+  for (uint64_t i = 1; i <= 4; i++) {
+    client_->Send(newMessage(yaraft::pb::MsgApp, i));
+  }
+
+  using Received = std::vector<std::string>;
+  ASSERT_EQ(follower_.WaitReceived(2), (Received{"App:1", "App:2"}));
+
+  // the heartbeat doesn't wait behind the appends queued for the window.
+  client_->Send(newMessage(yaraft::pb::MsgHeartbeat, 0));
+  ASSERT_EQ(follower_.WaitReceived(3), (Received{"App:1", "App:2", "Heartbeat:0"}));
+  ASSERT_EQ(client_->GetStatus().pending_messages, 2);
+
+  follower_.Ack(2);
+  ASSERT_EQ(follower_.WaitReceived(5),
+            (Received{"App:1", "App:2", "Heartbeat:0", "App:3", "App:4"}));
+}
@@ -0,0 +1,163 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <thread>
+
+#include "base/logging.h"
+#include "rpc/message_codec.h"
+#include "rpc/snapshot_sender.h"
+
+#include <brpc/controller.h>
+
+namespace consensus {
+namespace rpc {
+
+// Interval between two attempts to send a chunk that failed.
+static const auto kChunkRetryInterval = std::chrono::milliseconds(1000);
+
+SnapshotSender::SnapshotSender(brpc::Channel *channel, const ClusterOptions &options)
+    : channel_(channel), options_(options), stopped_(false) {
+  FATAL_NOT_OK(worker_.StartLoop(std::bind(&SnapshotSender::sendRound, this)),
+               "SnapshotSender: failed to start sender thread");
+}
+
+SnapshotSender::~SnapshotSender() {
+  Stop();
+}
+
+void SnapshotSender::Send(yaraft::pb::Message *msg) {
+  DCHECK_EQ(msg->type(), yaraft::pb::MsgSnap);
+
+  std::lock_guard<std::mutex> g(mu_);
+  next_.reset(msg);
+  cond_.notify_one();
+}
+
+void SnapshotSender::Stop() {
+  {
+    std::lock_guard<std::mutex> g(mu_);
+    if (stopped_) {
+      return;
+    }
+    stopped_ = true;
+    next_.reset();
+    cond_.notify_one();
+  }
+  FATAL_NOT_OK(worker_.Stop(), "SnapshotSender: failed to stop sender thread");
+}
+
+void SnapshotSender::sendRound() {
+  MessageUPtr msg;
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    cond_.wait_for(lock, std::chrono::milliseconds(100), [&]() { return next_ || stopped_; });
+    if (stopped_ || !next_) {
+      return;
+    }
+    msg = std::move(next_);
+  }
+  transfer(std::move(msg));
+}
+
+bool SnapshotSender::interrupted() {
+  std::lock_guard<std::mutex> g(mu_);
+  return stopped_ || next_;
+}
+
+void SnapshotSender::transfer(MessageUPtr msg) {
+  const uint64_t term = msg->snapshot().metadata().term();
+  const uint64_t index = msg->snapshot().metadata().index();
+
+  butil::IOBuf data;
+  data.append(msg->snapshot().data());
+  msg->mutable_snapshot()->clear_data();
+
+  FMT_LOG(INFO, "SnapshotSender: start sending snapshot [term: {}, index: {}, size: {}] to {}",
+          term, index, data.size(), msg->to());
+
+  const size_t chunkSize = std::max<size_t>(options_.snapshot_chunk_size, 1);
+  auto start = std::chrono::steady_clock::now();
+  uint64_t sentBytes = 0;
+  uint64_t offset = 0;
+
+  pb::RaftService_Stub stub(channel_);
+  while (!interrupted()) {
+    size_t len = std::min<size_t>(chunkSize, data.size() - offset);
+    bool last = (offset + len == data.size());
+
+    brpc::Controller cntl;
+    cntl.set_timeout_ms(10000);
+    data.append_to(&cntl.request_attachment(), len, offset);
+
+    pb::InstallSnapshotRequest request;
+    pb::InstallSnapshotResponse response;
+    request.set_group(options_.group_id);
+    request.set_from(msg->from());
+    request.set_term(term);
+    request.set_index(index);
+    request.set_offset(offset);
+    request.set_checksum(ChecksumIOBuf(cntl.request_attachment()));
+    if (last) {
+      request.mutable_message()->CopyFrom(*msg);
+    }
+
+    stub.InstallSnapshot(&cntl, &request, &response, nullptr);
+    if (cntl.Failed()) {
+      FMT_LOG(WARNING, "SnapshotSender: failed to send chunk [offset: {}] to {}: {}", offset,
+              msg->to(), cntl.ErrorText());
+      std::this_thread::sleep_for(kChunkRetryInterval);
+      continue;
+    }
+
+    if (response.code() == pb::SnapshotChunkRejected) {
+      // resumes from where the receiver is, or restarts if it makes no sense.
+      FMT_LOG(WARNING, "SnapshotSender: chunk [offset: {}] rejected by {}, resuming from {}",
+              offset, msg->to(), response.next_offset());
+      offset = response.next_offset() <= data.size() ? response.next_offset() : 0;
+      std::this_thread::sleep_for(kChunkRetryInterval);
+      continue;
+    }
+    if (response.code() != pb::OK) {
+      FMT_LOG(ERROR, "SnapshotSender: {} is unable to install snapshot [term: {}, index: {}]: {}",
+              msg->to(), term, index, pb::StatusCode_Name(response.code()));
+      report(msg->to(), true);
+      return;
+    }
+
+    if (last) {
+      FMT_LOG(INFO, "SnapshotSender: finished sending snapshot [term: {}, index: {}] to {}",
+              term, index, msg->to());
+      report(msg->to(), false);
+      return;
+    }
+    offset += len;
+
+    // throttles to the rate limit.
+    sentBytes += len;
+    if (options_.snapshot_rate_limit > 0) {
+      auto expected = start + std::chrono::microseconds(sentBytes * 1000000 /
+                                                        options_.snapshot_rate_limit);
+      std::this_thread::sleep_until(expected);
+    }
+  }
+}
+
+void SnapshotSender::report(uint64_t to, bool failed) {
+  if (options_.snapshot_reporter) {
+    options_.snapshot_reporter(to, failed);
+  }
+}
+
+}  // namespace rpc
+}  // namespace consensus
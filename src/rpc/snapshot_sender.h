@@ -0,0 +1,82 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "base/background_worker.h"
+#include "rpc/cluster.h"
+
+#include <brpc/channel.h>
+
+namespace consensus {
+namespace rpc {
+
+// SnapshotSender transfers the snapshots carried by MsgSnap to a single peer through
+// RaftService::InstallSnapshot, from its own thread, so that neither the raft thread
+// nor the peer's message stream is blocked by a large snapshot.
+//
+// The data is sent in checksummed chunks of `snapshot_chunk_size` bytes, at most
+// `snapshot_rate_limit` bytes per second. A failed chunk is retried after a while, and
+// the transfer resumes from the offset the receiver reports. The transfer is given up
+// if the receiver can never accept it, e.g the group isn't found. A newer snapshot to
+// the same peer abandons the one being sent.
+//
+// The result of a transfer that's not abandoned is passed to
+// ClusterOptions::snapshot_reporter.
+//
+// Thread-Safe
+class SnapshotSender {
+ public:
+  // `channel` must outlive the sender.
+  SnapshotSender(brpc::Channel* channel, const ClusterOptions& options);
+
+  ~SnapshotSender();
+
+  // Takes the ownership of `msg`.
+  // REQUIRES: msg->type() == MsgSnap
+  void Send(yaraft::pb::Message* msg);
+
+  // Abandons the current transfer and stops the sender thread.
+  void Stop();
+
+ private:
+  using MessageUPtr = std::unique_ptr<yaraft::pb::Message>;
+
+  void sendRound();
+
+  void transfer(MessageUPtr msg);
+
+  void report(uint64_t to, bool failed);
+
+  // Returns true if the current transfer should be abandoned.
+  bool interrupted();
+
+ private:
+  brpc::Channel* channel_;
+  const ClusterOptions options_;
+
+  std::mutex mu_;
+  std::condition_variable cond_;
+  MessageUPtr next_;
+  bool stopped_;
+
+  BackgroundWorker worker_;
+};
+
+}  // namespace rpc
+}  // namespace consensus
@@ -0,0 +1,127 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/logging.h"
+#include "snapshotter.h"
+
+namespace consensus {
+
+Snapshotter::Snapshotter(StateMachine *stateMachine, RaftTaskExecutor *executor,
+                         yaraft::MemoryStorage *memstore, const SnapshotterOptions &options)
+    : stateMachine_(stateMachine),
+      executor_(executor),
+      memstore_(memstore),
+      options_(options),
+      lastSnapshotIndex_(0),
+      unsupported_(false),
+      pendingIndex_(0),
+      busy_(false),
+      stopped_(false) {
+  FATAL_NOT_OK(worker_.StartLoop(std::bind(&Snapshotter::serializeRound, this)),
+               "Snapshotter: failed to start snapshot thread");
+}
+
+Snapshotter::~Snapshotter() {
+  {
+    std::lock_guard<std::mutex> g(mu_);
+    stopped_ = true;
+    cond_.notify_one();
+  }
+  FATAL_NOT_OK(worker_.Stop(), "Snapshotter: failed to stop snapshot thread");
+}
+
+void Snapshotter::OnApplied(uint64_t index) {
+  if (unsupported_ || index < lastSnapshotIndex_ + options_.threshold) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> g(mu_);
+    if (busy_) {
+      return;
+    }
+  }
+
+  std::unique_ptr<StateMachineSnapshot> snap(stateMachine_->TakeSnapshot());
+  if (!snap) {
+    FMT_LOG(WARNING, "Snapshotter: the state machine doesn't support snapshot, log compaction "
+                     "is disabled");
+    unsupported_ = true;
+    return;
+  }
+  lastSnapshotIndex_ = index;
+
+  std::lock_guard<std::mutex> g(mu_);
+  pending_ = std::move(snap);
+  pendingIndex_ = index;
+  busy_ = true;
+  cond_.notify_one();
+}
+
+void Snapshotter::serializeRound() {
+  std::unique_ptr<StateMachineSnapshot> snap;
+  uint64_t index;
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    cond_.wait_for(lock, std::chrono::milliseconds(100), [&]() { return pending_ || stopped_; });
+    if (stopped_ || !pending_) {
+      return;
+    }
+    snap = std::move(pending_);
+    index = pendingIndex_;
+  }
+
+  std::string data;
+  Status s = snap->Serialize(&data);
+  snap.reset();
+  if (s.IsOK()) {
+    install(index, std::move(data));
+  } else {
+    FMT_LOG(ERROR, "Snapshotter: failed to serialize snapshot at {}: {}", index, s.ToString());
+  }
+
+  std::lock_guard<std::mutex> g(mu_);
+  busy_ = false;
+}
+
+void Snapshotter::install(uint64_t index, std::string data) {
+  auto dataPtr = std::make_shared<std::string>(std::move(data));
+  yaraft::MemoryStorage *memstore = memstore_;
+  yaraft::pb::ConfState confState = options_.conf_state;
+  uint64_t retained = options_.retained_entries;
+
+  executor_->Submit([=](yaraft::RawNode *node) mutable {
+    auto sw = memstore->CreateSnapshot(index, &confState, *dataPtr);
+    if (!sw.IsOK()) {
+      // e.g a newer snapshot has been received from the leader.
+      FMT_LOG(WARNING, "Snapshotter: failed to create snapshot at {}: {}", index,
+              sw.GetStatus().ToString());
+      return;
+    }
+
+    uint64_t compactIndex = index > retained ? index - retained : 0;
+    if (compactIndex >= memstore->FirstIndex()) {
+      auto s = memstore->Compact(compactIndex);
+      if (!s.IsOK()) {
+        FMT_LOG(WARNING, "Snapshotter: failed to compact log to {}: {}", compactIndex,
+                s.ToString());
+        return;
+      }
+    }
+    FMT_LOG(INFO, "Snapshotter: created snapshot [index: {}, size: {}], log compacted to {}",
+            index, dataPtr->size(), compactIndex);
+  });
+}
+
+}  // namespace consensus
@@ -0,0 +1,93 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "base/background_worker.h"
+#include "raft_task_executor.h"
+#include "state_machine.h"
+
+#include <yaraft/memory_storage.h>
+
+namespace consensus {
+
+struct SnapshotterOptions {
+  // A snapshot is taken once this number of entries have been applied since the
+  // last one.
+  uint64_t threshold;
+
+  // The number of entries kept in the log behind a snapshot, so that a slightly
+  // lagging follower catches up by entries rather than by the snapshot.
+  uint64_t retained_entries;
+
+  // The members of the cluster, recorded in the snapshots.
+  yaraft::pb::ConfState conf_state;
+
+  SnapshotterOptions() : threshold(0), retained_entries(0) {}
+};
+
+// Snapshotter compacts the raft log by snapshots of the state machine.
+//
+// The state machine takes a snapshot on the apply thread every `threshold` entries,
+// the snapshot is serialized on the snapshotter's own thread while applies go on.
+// Then, on the raft thread, the serialized data becomes the snapshot of MemoryStorage,
+// which is sent to the followers that are too far behind, and the log before it is
+// compacted.
+//
+// At most one snapshot is in progress, the next is taken after it finishes.
+//
+// Thread-Safe
+class Snapshotter {
+ public:
+  // `stateMachine`, `executor` and `memstore` must outlive the snapshotter.
+  Snapshotter(StateMachine* stateMachine, RaftTaskExecutor* executor,
+              yaraft::MemoryStorage* memstore, const SnapshotterOptions& options);
+
+  // The snapshot in progress is abandoned.
+  ~Snapshotter();
+
+  // Takes a snapshot if it's time to.
+  // ONLY the apply thread is allowed to call this function.
+  void OnApplied(uint64_t index);
+
+ private:
+  void serializeRound();
+
+  void install(uint64_t index, std::string data);
+
+ private:
+  StateMachine* stateMachine_;
+  RaftTaskExecutor* executor_;
+  yaraft::MemoryStorage* memstore_;
+  const SnapshotterOptions options_;
+
+  // only accessed by the apply thread.
+  uint64_t lastSnapshotIndex_;
+  bool unsupported_;
+
+  std::mutex mu_;
+  std::condition_variable cond_;
+  std::unique_ptr<StateMachineSnapshot> pending_;
+  uint64_t pendingIndex_;
+  bool busy_;
+  bool stopped_;
+
+  BackgroundWorker worker_;
+};
+
+}  // namespace consensus
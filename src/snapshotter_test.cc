@@ -0,0 +1,201 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <mutex>
+#include <thread>
+
+#include "base/testing.h"
+#include "rpc/loopback_cluster.h"
+
+#include "replicated_log.h"
+
+using namespace consensus;
+
+// CountingStateMachine counts the non-empty entries it has applied, the count is
+// the data of its snapshots.
+class CountingStateMachine : public StateMachine {
+ public:
+  class Image : public StateMachineSnapshot {
+   public:
+    explicit Image(uint64_t count) : count_(count) {}
+
+    Status Serialize(std::string *data) override {
+      *data = std::to_string(count_);
+      return Status::OK();
+    }
+
+   private:
+    const uint64_t count_;
+  };
+
+  void Apply(const std::vector<yaraft::pb::Entry> &entries) override {
+    std::lock_guard<std::mutex> g(mu_);
+    for (const auto &e : entries) {
+      if (!e.data().empty()) {
+        count_++;
+      }
+    }
+  }
+
+  void ApplySnapshot(const yaraft::pb::Snapshot &snapshot) override {
+    std::lock_guard<std::mutex> g(mu_);
+    count_ = std::stoull(snapshot.data());
+    snapshotIndex_ = snapshot.metadata().index();
+  }
+
+  StateMachineSnapshot *TakeSnapshot() override {
+    std::lock_guard<std::mutex> g(mu_);
+    return new Image(count_);
+  }
+
+  uint64_t Count() {
+    std::lock_guard<std::mutex> g(mu_);
+    return count_;
+  }
+
+  // the index of the last snapshot received, 0 if none.
+  uint64_t SnapshotIndex() {
+    std::lock_guard<std::mutex> g(mu_);
+    return snapshotIndex_;
+  }
+
+ private:
+  std::mutex mu_;
+  uint64_t count_ = 0;
+  uint64_t snapshotIndex_ = 0;
+};
+
+// A cluster of 3 nodes connected by a LoopbackNetwork, each with its own WAL
+// directory, so that a node can be restarted from its WAL.
+class SnapshotterTest : public BaseTest {
+ public:
+  SnapshotterTest() : network_(rpc::LoopbackNetworkOptions()) {}
+
+  void SetUp() override {
+    dirGuard_.reset(CreateTestDirGuard());
+  }
+
+ protected:
+  static constexpr uint64_t kNodes = 3;
+
+  void startNode(uint64_t id) {
+    wal::WriteAheadLogOptions walOptions;
+    walOptions.log_dir = fmt::format("{}/node{}", GetTestDir(), id);
+    ASSERT_OK(wal::WriteAheadLog::Default(walOptions, &wals_[id], &memstores_[id]));
+    if (!memstores_[id]) {
+      memstores_[id].reset(new yaraft::MemoryStorage);
+    }
+    stateMachines_[id].reset(new CountingStateMachine);
+
+    ReplicatedLogOptions options;
+    options.id = id;
+    for (uint64_t n = 1; n <= kNodes; n++) {
+      // the addresses are unused by the loopback network.
+      options.initial_cluster[n] = fmt::format("127.0.0.1:{}", 12320 + n);
+    }
+    options.heartbeat_interval = 10;
+    options.election_timeout = 100;
+    options.campaign_on_start = id == 1;
+    options.cluster = network_.NewCluster();
+    options.wal = wals_[id].get();
+    options.memstore = memstores_[id].get();
+    options.state_machine = stateMachines_[id].get();
+    options.snapshot_threshold = 20;
+    options.snapshot_retained_entries = 5;
+
+    ReplicatedLog *log;
+    ASSIGN_IF_ASSERT_OK(ReplicatedLog::New(options), log);
+    logs_[id].reset(log);
+    network_.Register(id, log->RaftTaskExecutorInstance());
+  }
+
+  void stopNode(uint64_t id) {
+    network_.Unregister(id);
+    logs_[id].reset();
+    wals_[id].reset();
+    memstores_[id].reset();
+  }
+
+  // Writes `data` through whichever node is the leader, retries until it succeeds.
+  void write(const std::string &data) {
+    while (true) {
+      for (uint64_t n = 1; n <= kNodes; n++) {
+        if (logs_[n]->Write(data).IsOK()) {
+          return;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  // Waits until every node has applied all the completed writes. A node that rejoins
+  // may start an election, so the read index is retried until a leader serves it.
+  void waitAllApplied() {
+    uint64_t index = 0;
+    while (index == 0) {
+      for (uint64_t n = 1; n <= kNodes && index == 0; n++) {
+        auto sw = logs_[n]->ReadIndex();
+        if (sw.IsOK()) {
+          index = sw.GetValue();
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    for (uint64_t n = 1; n <= kNodes; n++) {
+      ASSERT_OK(logs_[n]->WaitApplied(index, 10 * 1000));
+    }
+  }
+
+ protected:
+  TestDirGuard dirGuard_;
+  rpc::LoopbackNetwork network_;
+
+  // indexed by node id, the logs are released first since they use the others.
+  std::unique_ptr<CountingStateMachine> stateMachines_[kNodes + 1];
+  yaraft::MemStoreUptr memstores_[kNodes + 1];
+  wal::WriteAheadLogUPtr wals_[kNodes + 1];
+  std::unique_ptr<ReplicatedLog> logs_[kNodes + 1];
+};
+
+// This test verifies that a follower that caught up by a snapshot recovers the
+// snapshot from its WAL after restart, without the leader sending it again.
+TEST_F(SnapshotterTest, RestartFollowerAfterInstallingSnapshot) {
+  for (uint64_t n = 1; n <= kNodes; n++) {
+    startNode(n);
+  }
+
+  // node 3 misses the entries, which are compacted by the snapshots of the leader.
+  network_.Isolate(3);
+  for (int i = 0; i < 100; i++) {
+    write("a");
+  }
+
+  network_.Heal();
+  waitAllApplied();
+  uint64_t snapshotIndex = stateMachines_[3]->SnapshotIndex();
+  ASSERT_GT(snapshotIndex, 0);
+  ASSERT_EQ(stateMachines_[3]->Count(), stateMachines_[1]->Count());
+
+  // restarted apart from the others, node 3 can only restore the snapshot from its WAL.
+  network_.Isolate(3);
+  stopNode(3);
+  startNode(3);
+  ASSERT_OK(logs_[3]->WaitApplied(snapshotIndex, 10 * 1000));
+  ASSERT_EQ(stateMachines_[3]->SnapshotIndex(), snapshotIndex);
+
+  network_.Heal();
+  write("a");
+  waitAllApplied();
+  ASSERT_EQ(stateMachines_[3]->Count(), stateMachines_[1]->Count());
+}
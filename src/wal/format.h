@@ -36,6 +36,15 @@ namespace wal {
 //  SegmentFooter :=
 //
 
+//  The latest snapshot received from the leader is saved in the file "snapshot":
+//
+//  SnapshotFile := LogHeader FirstSegmentId VarString(HardState) VarString(Snapshot)
+//
+//  FirstSegmentId -> 8 bytes, id of the first segment written after the snapshot,
+//                    the entries of the segments before are replaced by the snapshot.
+//  HardState      -> empty if there's no hard state saved along with the snapshot
+//
+
 constexpr static size_t kLogBatchHeaderSize = 4 + 4;
 constexpr static size_t kRecordHeaderSize = 1;
 
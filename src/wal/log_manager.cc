@@ -13,13 +13,97 @@
 // limitations under the License.
 
 #include "wal/log_manager.h"
+#include "base/coding.h"
+#include "base/env_util.h"
 #include "base/logging.h"
 #include "wal/log_writer.h"
 #include "wal/readable_log_segment.h"
 
+#include <boost/crc.hpp>
+#include <butil/time.h>
+#include <bvar/bvar.h>
+
 namespace consensus {
 namespace wal {
 
+// time (in microseconds) of a write to the WAL.
+static bvar::LatencyRecorder g_wal_write("consensus_wal_write");
+
+// the number of entries in a write.
+static bvar::IntRecorder g_wal_batch_entries;
+static bvar::Window<bvar::IntRecorder> g_wal_batch_entries_window("consensus_wal_batch_entries",
+                                                                  &g_wal_batch_entries, 10);
+
+static const std::string kSnapshotFileName = "snapshot";
+static const std::string kTmpSnapshotFileName = "snapshot.tmp";
+
+// The content of the snapshot file, see format.h.
+struct SnapshotFile {
+  uint64_t firstSegId;
+  std::unique_ptr<yaraft::pb::HardState> hardState;
+  yaraft::pb::Snapshot snapshot;
+};
+
+static Status readSnapshotFile(const std::string& fname, SnapshotFile* file,
+                               bool verifyChecksum) {
+  char* buf;
+  Slice s;
+  RETURN_NOT_OK(env_util::ReadFullyToBuffer(fname, &s, &buf));
+  std::unique_ptr<char[]> g(buf);
+
+  if (UNLIKELY(s.size() < kLogBatchHeaderSize)) {
+    return Status::Make(Error::Corruption, "bad snapshot file: missing header");
+  }
+  uint32_t crc = DecodeFixed32(s.data());
+  uint32_t len = DecodeFixed32(s.data() + 4);
+  s.Skip(kLogBatchHeaderSize);
+  if (UNLIKELY(s.size() != len || len < 8)) {
+    return FMT_Status(Corruption, "bad snapshot file: bad length {}", len);
+  }
+
+  if (verifyChecksum) {
+    boost::crc_32_type crc32;
+    crc32.process_bytes(s.data(), s.size());
+    if (crc32.checksum() != crc) {
+      return Status::Make(Error::Corruption, "bad snapshot file: bad checksum");
+    }
+  }
+
+  file->firstSegId = DecodeFixed64(s.data());
+  s.Skip(8);
+
+  Slice hs, snap;
+  if (UNLIKELY(!GetLengthPrefixedSlice(&s, &hs) || !GetLengthPrefixedSlice(&s, &snap))) {
+    return Status::Make(Error::Corruption, "bad snapshot file: bad record");
+  }
+  if (hs.size() > 0) {
+    file->hardState.reset(new yaraft::pb::HardState);
+    if (UNLIKELY(!file->hardState->ParseFromArray(hs.data(), hs.size()))) {
+      return Status::Make(Error::Corruption, "bad snapshot file: unable to parse hard state");
+    }
+  }
+  if (UNLIKELY(!file->snapshot.ParseFromArray(snap.data(), snap.size()))) {
+    return Status::Make(Error::Corruption, "bad snapshot file: unable to parse snapshot");
+  }
+  return Status::OK();
+}
+
+// The entries read before are covered by the snapshot, and discarded by ApplySnapshot.
+static Status restoreSnapshot(const SnapshotFile& file, yaraft::MemoryStorage* memstore) {
+  const auto& meta = file.snapshot.metadata();
+  FMT_LOG(INFO, "restoring snapshot [index: {}, term: {}]", meta.index(), meta.term());
+
+  auto s = memstore->ApplySnapshot(file.snapshot);
+  if (UNLIKELY(!s.IsOK())) {
+    return FMT_Status(Corruption, "unable to restore snapshot [index: {}, term: {}]: {}",
+                      meta.index(), meta.term(), s.ToString());
+  }
+  if (file.hardState) {
+    memstore->SetHardState(*file.hardState);
+  }
+  return Status::OK();
+}
+
 static bool isWal(const std::string& fname) {
   // TODO(optimize)
   size_t len = fname.length();
@@ -64,7 +148,12 @@ Status AppendToMemStore(yaraft::pb::Entry& e, yaraft::MemoryStorage* memstore) {
 //////////////////////////////////////////////////////////////////////
 
 LogManager::LogManager(const WriteAheadLogOptions& options)
-    : lastIndex_(0), options_(options), empty_(false) {}
+    : lastIndex_(0),
+      options_(options),
+      empty_(false),
+      finishedBytes_(0),
+      segmentNum_(0),
+      bytes_(0) {}
 
 LogManager::~LogManager() {
   Close();
@@ -81,17 +170,20 @@ Status LogManager::Recover(const WriteAheadLogOptions& options, yaraft::MemStore
 
   // finds all files with suffix ".wal"
   std::map<uint64_t, uint64_t> wals;  // ordered by segId
+  bool hasSnapshot = false;
   for (const auto& f : files) {
     if (isWal(f)) {
       uint64_t segId, segStart;
       parseWalName(f, &segId, &segStart);
       wals[segId] = segStart;
+    } else if (f == kSnapshotFileName) {
+      hasSnapshot = true;
     }
   }
 
   LogManagerUPtr& m = *pLogManager;
   m.reset(new LogManager(options));
-  if (wals.empty()) {
+  if (wals.empty() && !hasSnapshot) {
     return Status::OK();
   }
   m->empty_ = false;
@@ -99,16 +191,41 @@ Status LogManager::Recover(const WriteAheadLogOptions& options, yaraft::MemStore
   LOG_ASSERT(*memstore == nullptr);
   memstore->reset(new yaraft::MemoryStorage);
 
-  FMT_LOG(INFO, "recovering from {} wals, starts from {}-{}, ends at {}-{}", wals.size(),
-          wals.begin()->first, wals.begin()->second, wals.rbegin()->first, wals.rbegin()->second);
+  SnapshotFile snapFile;
+  if (hasSnapshot) {
+    RETURN_NOT_OK_APPEND(readSnapshotFile(options.log_dir + "/" + kSnapshotFileName, &snapFile,
+                                          options.verify_checksum),
+                         fmt::format(" [log_dir: \"{}\"]", options.log_dir));
+  }
+  bool snapshotRestored = !hasSnapshot;
+
+  if (!wals.empty()) {
+    FMT_LOG(INFO, "recovering from {} wals, starts from {}-{}, ends at {}-{}", wals.size(),
+            wals.begin()->first, wals.begin()->second, wals.rbegin()->first,
+            wals.rbegin()->second);
+  }
 
   for (auto it = wals.begin(); it != wals.end(); it++) {
+    // the segments written before the snapshot are read for their hard states.
+    if (!snapshotRestored && it->first >= snapFile.firstSegId) {
+      RETURN_NOT_OK(restoreSnapshot(snapFile, memstore->get()));
+      snapshotRestored = true;
+    }
+
     std::string fname = options.log_dir + "/" + SegmentFileName(it->first, it->second);
     SegmentMetaData meta;
     RETURN_NOT_OK(
         ReadSegmentIntoMemoryStorage(fname, memstore->get(), &meta, options.verify_checksum));
     m->files_.push_back(std::move(meta));
+
+    uint64_t size;
+    ASSIGN_IF_OK(Env::Default()->GetFileSize(fname), size);
+    m->finishedBytes_ += size;
+  }
+  if (!snapshotRestored) {
+    RETURN_NOT_OK(restoreSnapshot(snapFile, memstore->get()));
   }
+  m->updateUsage();
   return Status::OK();
 }
 
@@ -123,7 +240,49 @@ Status LogManager::Write(const PBEntryVec& entries, const yaraft::pb::HardState*
     empty_ = false;
   }
 
-  return doWrite(entries.begin(), entries.end(), hs);
+  int64_t start = butil::cpuwide_time_us();
+  Status s = doWrite(entries.begin(), entries.end(), hs);
+  updateUsage();
+  RETURN_NOT_OK(s);
+  g_wal_write << butil::cpuwide_time_us() - start;
+  g_wal_batch_entries << static_cast<int64_t>(entries.size());
+  return Status::OK();
+}
+
+Status LogManager::SaveSnapshot(const yaraft::pb::Snapshot& snap,
+                                const yaraft::pb::HardState* hs) {
+  if (current_) {
+    finishCurrentWriter();
+  }
+
+  std::string record;
+  PutFixed64(&record, files_.size() + 1);
+  PutLengthPrefixedSlice(&record, hs ? hs->SerializeAsString() : std::string());
+  PutLengthPrefixedSlice(&record, snap.SerializeAsString());
+
+  boost::crc_32_type crc;
+  crc.process_bytes(record.data(), record.size());
+  std::string header;
+  PutFixed32(&header, static_cast<uint32_t>(crc.checksum()));
+  PutFixed32(&header, static_cast<uint32_t>(record.size()));
+
+  // the snapshot is written to a temporary file and renamed, so that a crash never
+  // leaves a partially written snapshot.
+  std::string tmpName = options_.log_dir + "/" + kTmpSnapshotFileName;
+  WritableFile* wf;
+  ASSIGN_IF_OK(Env::Default()->NewWritableFile(tmpName), wf);
+  std::unique_ptr<WritableFile> file(wf);
+  RETURN_NOT_OK(file->Append(header));
+  RETURN_NOT_OK(file->Append(record));
+  RETURN_NOT_OK(file->Sync());
+  RETURN_NOT_OK(file->Close());
+  RETURN_NOT_OK(Env::Default()->RenameFile(tmpName, options_.log_dir + "/" + kSnapshotFileName));
+
+  // the next segment starts right after the snapshot.
+  lastIndex_ = snap.metadata().index();
+  empty_ = false;
+  updateUsage();
+  return Status::OK();
 }
 
 // Required: begin != end
@@ -172,12 +331,25 @@ Status LogManager::Close() {
   return Status::OK();
 }
 
+WalUsage LogManager::Usage() const {
+  WalUsage usage;
+  usage.segment_num = segmentNum_.load(std::memory_order_relaxed);
+  usage.bytes = bytes_.load(std::memory_order_relaxed);
+  return usage;
+}
+
+void LogManager::updateUsage() {
+  segmentNum_.store(SegmentNum(), std::memory_order_relaxed);
+  bytes_.store(finishedBytes_ + (current_ ? current_->Size() : 0), std::memory_order_relaxed);
+}
+
 Status LogManager::GC(WriteAheadLog::CompactionHint* hint) {
   return Status::OK();
 }
 
 void LogManager::finishCurrentWriter() {
   SegmentMetaData meta;
+  finishedBytes_ += current_->Size();
   FATAL_NOT_OK(current_->Finish(&meta), "LogWriter::Finish");
   files_.push_back(meta);
   delete current_.release();
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "base/status.h"
 #include "wal/segment_meta.h"
 #include "wal/wal.h"
@@ -38,7 +40,8 @@ class LogManager : public WriteAheadLog {
 
   // Recover from existing wal files.
   // The options.log_dir will be created when it's not existed.
-  // All of the uncompacted log entries will be read into `memstore`.
+  // The saved snapshot, if any, and all of the log entries after it will be read
+  // into `memstore`.
   //
   // ASSERT: *memstore == null
   static Status Recover(const WriteAheadLogOptions& options, yaraft::MemStoreUptr* memstore,
@@ -49,6 +52,10 @@ class LogManager : public WriteAheadLog {
   // Required: no holes between logs and msg.entries.
   Status Write(const PBEntryVec& vec, const yaraft::pb::HardState* hs) override;
 
+  // The current segment is finished, so that the segments before the snapshot are
+  // all immutable. They are kept on disk, their entries are discarded in recovery.
+  Status SaveSnapshot(const yaraft::pb::Snapshot& snap, const yaraft::pb::HardState* hs) override;
+
   // naive implementation: delete all committed segments.
   Status GC(WriteAheadLog::CompactionHint* hint) override;
 
@@ -56,6 +63,8 @@ class LogManager : public WriteAheadLog {
 
   Status Close() override;
 
+  WalUsage Usage() const override;
+
   // the number of log segments
   size_t SegmentNum() const {
     return files_.size() + static_cast<size_t>(bool(current_));
@@ -67,6 +76,8 @@ class LogManager : public WriteAheadLog {
 
   void finishCurrentWriter();
 
+  void updateUsage();
+
  private:
   friend class LogManagerTest;
   friend class LogWriter;
@@ -81,6 +92,13 @@ class LogManager : public WriteAheadLog {
   uint64_t lastIndex_;
   bool empty_;
 
+  // the size of the immutable segments.
+  uint64_t finishedBytes_;
+
+  // a copy of the usage for the readers from other threads.
+  std::atomic<size_t> segmentNum_;
+  std::atomic<uint64_t> bytes_;
+
   const WriteAheadLogOptions options_;
 };
 
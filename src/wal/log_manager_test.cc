@@ -53,6 +53,8 @@ TEST_F(LogManagerTest, AppendToOneSegment) {
       expected.push_back(PBEntry().Index(i).Term(i).v);
     }
     ASSERT_OK(wal->Write(expected));
+    ASSERT_EQ(wal->Usage().segment_num, 1);
+    ASSERT_GT(wal->Usage().bytes, 0);
 
     // flush data into file
     ASSERT_OK(wal->Close());
@@ -136,6 +138,7 @@ TEST_F(LogManagerTest, Recover) {
   for (auto t : tests) {
     TestDirGuard g(CreateTestDirGuard());
     size_t segNum;
+    WalUsage usage;
 
     // prepare data
     EntryVec expected;
@@ -149,6 +152,7 @@ TEST_F(LogManagerTest, Recover) {
 
       auto m = dynamic_cast<LogManager*>(w.get());
       segNum = m->SegmentNum();
+      usage = m->Usage();
     }
 
     WriteAheadLogOptions options;
@@ -160,6 +164,8 @@ TEST_F(LogManagerTest, Recover) {
     ASSERT_OK(LogManager::Recover(options, &memstore, &m));
 
     ASSERT_EQ(segNum, m->SegmentNum());
+    ASSERT_EQ(usage.segment_num, m->Usage().segment_num);
+    ASSERT_EQ(usage.bytes, m->Usage().bytes);
 
     EntryVec actual(memstore->TEST_Entries().begin() + 1, memstore->TEST_Entries().end());
     for (int i = 1; i < actual.size(); i++) {
@@ -168,5 +174,62 @@ TEST_F(LogManagerTest, Recover) {
   }
 }
 
+// This test verifies that recovery starts from the saved snapshot, and discards the
+// entries written before it.
+TEST_F(LogManagerTest, RecoverFromSnapshot) {
+  struct TestData {
+    uint64_t entriesAfterSnapshot;
+  } tests[] = {
+      {0}, {10}, {100},
+  };
+
+  for (auto t : tests) {
+    TestDirGuard g(CreateTestDirGuard());
+
+    yaraft::pb::Snapshot snap;
+    snap.mutable_metadata()->set_index(50);
+    snap.mutable_metadata()->set_term(3);
+    snap.set_data("snapshot");
+
+    yaraft::pb::HardState hs;
+    hs.set_term(3);
+    hs.set_commit(50);
+
+    EntryVec expected;
+    for (uint64_t i = 51; i <= 50 + t.entriesAfterSnapshot; i++) {
+      expected.push_back(PBEntry().Index(i).Term(3).v);
+    }
+    {
+      WriteAheadLogUPtr w(TEST_CreateWalStore(GetTestDir()));
+      EntryVec before;
+      for (uint64_t i = 1; i <= 30; i++) {
+        before.push_back(PBEntry().Index(i).Term(1).v);
+      }
+      ASSERT_OK(w->Write(before));
+      ASSERT_OK(w->SaveSnapshot(snap, &hs));
+      ASSERT_OK(w->Write(expected));
+      ASSERT_OK(w->Close());
+    }
+
+    WriteAheadLogOptions options;
+    options.log_dir = GetTestDir();
+
+    yaraft::MemStoreUptr memstore;
+    LogManagerUPtr m;
+    ASSERT_OK(LogManager::Recover(options, &memstore, &m));
+
+    auto sw = memstore->Snapshot();
+    ASSERT_TRUE(sw.IsOK());
+    ASSERT_EQ(sw.GetValue().metadata().index(), 50);
+    ASSERT_EQ(sw.GetValue().metadata().term(), 3);
+    ASSERT_EQ(sw.GetValue().data(), "snapshot");
+
+    ASSERT_EQ(memstore->FirstIndex(), 51);
+    ASSERT_EQ(memstore->LastIndex(), 50 + t.entriesAfterSnapshot);
+    EntryVec actual(memstore->TEST_Entries().begin() + 1, memstore->TEST_Entries().end());
+    ASSERT_TRUE(expected == actual);
+  }
+}
+
 }  // namespace wal
 }  // namespace consensus
\ No newline at end of file
@@ -16,10 +16,25 @@
 #include "base/coding.h"
 
 #include <boost/crc.hpp>
+#include <butil/time.h>
+#include <bvar/bvar.h>
 
 namespace consensus {
 namespace wal {
 
+// bytes written to the WALs of the process.
+static bvar::Adder<int64_t> g_wal_write_bytes("consensus_wal_write_bytes");
+static bvar::PerSecond<bvar::Adder<int64_t>> g_wal_write_bytes_second(
+    "consensus_wal_write_bytes_second", &g_wal_write_bytes);
+
+// the size of a batch appended to the segment.
+static bvar::IntRecorder g_wal_batch_bytes;
+static bvar::Window<bvar::IntRecorder> g_wal_batch_bytes_window("consensus_wal_batch_bytes",
+                                                                &g_wal_batch_bytes, 10);
+
+// time (in microseconds) of an fsync.
+static bvar::LatencyRecorder g_wal_fsync("consensus_wal_fsync");
+
 StatusWith<ConstPBEntriesIterator> LogWriter::Append(ConstPBEntriesIterator begin,
                                                      ConstPBEntriesIterator end,
                                                      const yaraft::pb::HardState *hs) {
@@ -70,11 +85,28 @@ StatusWith<ConstPBEntriesIterator> LogWriter::Append(ConstPBEntriesIterator begi
   EncodeFixed32(&scratch[0], static_cast<uint32_t>(crc.checksum()));
 
   RETURN_NOT_OK(file_->Append(scratch));
+  g_wal_write_bytes << static_cast<int64_t>(totalSize);
+  g_wal_batch_bytes << static_cast<int64_t>(totalSize);
 
   meta_.numEntries += std::distance(begin, newBegin);
   return newBegin;
 }
 
+Status LogWriter::Sync() {
+  int64_t start = butil::cpuwide_time_us();
+  RETURN_NOT_OK(file_->Sync());
+  g_wal_fsync << butil::cpuwide_time_us() - start;
+  return Status::OK();
+}
+
+Status LogWriter::Finish(SegmentMetaData *meta) {
+  RETURN_NOT_OK(Sync());
+  RETURN_NOT_OK(file_->Close());
+
+  *meta = meta_;
+  return Status::OK();
+}
+
 void LogWriter::saveHardState(const yaraft::pb::HardState &hs, char *dest, size_t *offset) {
   char *p = dest;
   p[0] = static_cast<char>(kHardStateType);
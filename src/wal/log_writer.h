@@ -53,18 +53,15 @@ class LogWriter {
                                             ConstPBEntriesIterator end,
                                             const yaraft::pb::HardState *hs = nullptr);
 
-  Status Sync() {
-    return file_->Sync();
-  }
-
-  Status Finish(SegmentMetaData *meta) {
-    RETURN_NOT_OK(file_->Sync());
-    RETURN_NOT_OK(file_->Close());
+  Status Sync();
 
-    *meta = meta_;
-    return Status::OK();
+  uint64_t Size() const {
+    return file_->Size();
   }
 
+  // Syncs and closes the segment.
+  Status Finish(SegmentMetaData *meta);
+
  private:
   void saveHardState(const yaraft::pb::HardState &hs, char *dest, size_t *offset);
 
@@ -28,6 +28,11 @@ class MockWriteAheadLog : public WriteAheadLog {
     return Status::OK();
   }
 
+  virtual Status SaveSnapshot(const yaraft::pb::Snapshot& snap,
+                              const yaraft::pb::HardState* hs) override {
+    return Status::OK();
+  }
+
   virtual Status GC(CompactionHint* hint) override {
     return Status::OK();
   }
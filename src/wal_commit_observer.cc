@@ -14,6 +14,7 @@
 
 #include <map>
 #include <set>
+#include <vector>
 
 #include "base/logging.h"
 
@@ -23,7 +24,7 @@ namespace consensus {
 
 class WalCommitObserver::Impl {
  public:
-  void Register(std::pair<uint64_t, uint64_t> range, SimpleChannel<Status> *channel) {
+  void Register(std::pair<uint64_t, uint64_t> range, Callback callback) {
     std::lock_guard<std::mutex> g(mu_);
 
     WalWritesMap::const_iterator it = writes_.find(range);
@@ -32,32 +33,43 @@ class WalCommitObserver::Impl {
               "WalCommitObserver::Register: duplicate calls for a range of entries in [{}, {}]",
               range.first, range.second);
     } else {
-      writes_[range] = channel;
+      writes_[range] = std::move(callback);
     }
   }
 
   void Notify(uint64_t commitIndex) {
-    std::lock_guard<std::mutex> g(mu_);
+    std::vector<Callback> committed;
+    {
+      std::lock_guard<std::mutex> g(mu_);
 
-    auto it = writes_.begin();
-    for (; it != writes_.end(); it++) {
-      if (commitIndex >= it->first.second) {
-        (*it->second) <<= Status::OK();
+      // the ranges are ordered by their first index, none after commitIndex can be covered.
+      auto it = writes_.begin();
+      while (it != writes_.end() && it->first.first <= commitIndex) {
+        if (commitIndex >= it->first.second) {
+          committed.push_back(std::move(it->second));
+          it = writes_.erase(it);
+        } else {
+          it++;
+        }
       }
-      writes_.erase(it);
+    }
+
+    // the callbacks may take a while, e.g to send the responses, they're called
+    // without the lock so that new writes can still register.
+    for (const Callback &cb : committed) {
+      cb(Status::OK());
     }
   }
 
  private:
-  typedef std::map<std::pair<uint64_t, uint64_t>, SimpleChannel<Status> *> WalWritesMap;
+  typedef std::map<std::pair<uint64_t, uint64_t>, Callback> WalWritesMap;
   WalWritesMap writes_;
 
   std::mutex mu_;
 };
 
-void WalCommitObserver::Register(std::pair<uint64_t, uint64_t> range,
-                                 SimpleChannel<Status> *channel) {
-  impl_->Register(range, channel);
+void WalCommitObserver::Register(std::pair<uint64_t, uint64_t> range, Callback callback) {
+  impl_->Register(range, std::move(callback));
 }
 
 void WalCommitObserver::Notify(uint64_t commitIndex) {
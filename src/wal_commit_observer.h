@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include "base/simple_channel.h"
 #include "base/status.h"
 
@@ -25,6 +27,8 @@ namespace consensus {
 // object generated by RawNode contains committedIndex updates, the observers
 // will be informed, and all the registered listeners with ranges
 // covering the new committedIndex will be notified.
+// If the log has a StateMachine, listeners are notified once the entries are
+// applied instead.
 //
 // Thread-Safe
 class WalCommitObserver {
@@ -33,10 +37,13 @@ class WalCommitObserver {
  public:
   WalCommitObserver();
 
-  // ONLY the wal write thread is allowed to call this function.
-  void Register(std::pair<uint64_t, uint64_t> range, SimpleChannel<Status> *channel);
+  typedef std::function<void(const Status &)> Callback;
+
+  // `callback` is invoked on the notifying thread once the range is committed.
+  void Register(std::pair<uint64_t, uint64_t> range, Callback callback);
 
-  // ONLY the flusher thread is allowed to call this function.
+  // ONLY the flusher thread, or the apply thread if there's a StateMachine, is allowed
+  // to call this function.
   void Notify(uint64_t commitIndex);
 
   ~WalCommitObserver();
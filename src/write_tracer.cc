@@ -0,0 +1,141 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include "base/logging.h"
+#include "write_tracer.h"
+
+#include <butil/time.h>
+#include <bvar/bvar.h>
+
+namespace consensus {
+
+static const char *stageName(WriteTracer::Stage stage) {
+  switch (stage) {
+    case WriteTracer::kQueue:
+      return "queue";
+    case WriteTracer::kReady:
+      return "ready";
+    case WriteTracer::kSend:
+      return "send";
+    case WriteTracer::kWal:
+      return "wal";
+    case WriteTracer::kCommit:
+      return "commit";
+    case WriteTracer::kApply:
+      return "apply";
+    default:
+      LOG(FATAL) << "unexpected stage: " << stage;
+      return "";
+  }
+}
+
+// the traces of the writes never committed, e.g by a deposed leader, are dropped
+// beyond this limit.
+static const size_t kMaxTraces = 1024;
+
+class WriteTracer::Impl {
+ public:
+  Impl(const std::string &prefix, uint32_t sampleEvery) : sampleEvery_(sampleEvery) {
+    for (int i = 0; i < kNumStages; i++) {
+      recorders_[i].expose(prefix + "_" + stageName(static_cast<Stage>(i)));
+    }
+  }
+
+  int64_t Sample() {
+    if (sampleEvery_ == 0 || counter_.fetch_add(1, std::memory_order_relaxed) % sampleEvery_ != 0) {
+      return 0;
+    }
+    return butil::cpuwide_time_us();
+  }
+
+  void OnProposed(uint64_t index, int64_t submitTime) {
+    int64_t now = butil::cpuwide_time_us();
+    recorders_[kQueue] << now - submitTime;
+
+    std::lock_guard<std::mutex> g(mu_);
+    if (traces_.size() >= kMaxTraces) {
+      traces_.erase(traces_.begin());
+    }
+    traces_[index] = Trace{kQueue, now};
+    size_.store(traces_.size(), std::memory_order_relaxed);
+  }
+
+  void Record(Stage stage, uint64_t lo, uint64_t hi) {
+    // fast path for the writes not sampled.
+    if (size_.load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+
+    int64_t now = butil::cpuwide_time_us();
+    std::lock_guard<std::mutex> g(mu_);
+    auto it = traces_.lower_bound(lo);
+    while (it != traces_.end() && it->first <= hi) {
+      Trace &t = it->second;
+      if (t.stage < stage) {
+        recorders_[stage] << now - t.time;
+        t.stage = stage;
+        t.time = now;
+      }
+      it = stage == kApply ? traces_.erase(it) : std::next(it);
+    }
+    size_.store(traces_.size(), std::memory_order_relaxed);
+  }
+
+  int64_t Count(Stage stage) const {
+    return recorders_[stage].count();
+  }
+
+ private:
+  struct Trace {
+    // the last stage reached, and the time of it.
+    Stage stage;
+    int64_t time;
+  };
+
+  const uint32_t sampleEvery_;
+  std::atomic<uint64_t> counter_{0};
+
+  bvar::LatencyRecorder recorders_[kNumStages];
+
+  std::mutex mu_;
+  std::map<uint64_t, Trace> traces_;
+  std::atomic<size_t> size_{0};
+};
+
+WriteTracer::WriteTracer(const std::string &prefix, uint32_t sampleEvery)
+    : impl_(new Impl(prefix, sampleEvery)) {}
+
+WriteTracer::~WriteTracer() = default;
+
+int64_t WriteTracer::Sample() {
+  return impl_->Sample();
+}
+
+void WriteTracer::OnProposed(uint64_t index, int64_t submitTime) {
+  impl_->OnProposed(index, submitTime);
+}
+
+void WriteTracer::Record(Stage stage, uint64_t lo, uint64_t hi) {
+  impl_->Record(stage, lo, hi);
+}
+
+int64_t WriteTracer::Count(Stage stage) const {
+  return impl_->Count(stage);
+}
+
+}  // namespace consensus
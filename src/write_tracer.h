@@ -0,0 +1,80 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <silly/disallow_copying.h>
+
+namespace consensus {
+
+// WriteTracer samples the writes to a ReplicatedLog, and records the time a sampled
+// write spends in each stage of the pipeline:
+//
+//   kQueue:  from the write being submitted to its task running in the TaskQueue.
+//   kReady:  from the proposal to the flusher getting the Ready carrying the entry.
+//   kSend:   passing the messages of the Ready to the cluster, leader only.
+//   kWal:    writing the entry to the WAL, fsync included.
+//   kCommit: from the entry being persisted to its commit, which waits for the acks
+//            of the followers.
+//   kApply:  from the commit to the writer being notified, the entry is applied to
+//            the state machine in between if there's one.
+//
+// The latencies of each stage are exported as a bvar::LatencyRecorder named
+// "<prefix>_<stage>", see /vars of the brpc server. A stage that a write skips, e.g
+// kSend on a single node, isn't recorded.
+//
+// Thread-Safe
+class WriteTracer {
+  __DISALLOW_COPYING__(WriteTracer);
+
+ public:
+  enum Stage {
+    kQueue,
+    kReady,
+    kSend,
+    kWal,
+    kCommit,
+    kApply,
+
+    kNumStages,
+  };
+
+  // One in every `sampleEvery` writes is traced.
+  WriteTracer(const std::string &prefix, uint32_t sampleEvery);
+
+  ~WriteTracer();
+
+  // Returns the timestamp in microseconds if the next write is sampled, or 0 if not.
+  int64_t Sample();
+
+  // The sampled write submitted at `submitTime` is proposed as the entry at `index`.
+  // ONLY the raft thread is allowed to call this function.
+  void OnProposed(uint64_t index, int64_t submitTime);
+
+  // The traced entries in [lo, hi] reach `stage`.
+  // The traces of the entries that have been notified are discarded.
+  void Record(Stage stage, uint64_t lo, uint64_t hi);
+
+  // The number of the latencies recorded for `stage`.
+  int64_t Count(Stage stage) const;
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace consensus
@@ -0,0 +1,61 @@
+// Copyright 2017 Wu Tao
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/testing.h"
+#include "write_tracer.h"
+
+using namespace consensus;
+
+TEST(WriteTracerTest, Sample) {
+  WriteTracer tracer("write_tracer_test_sample", 3);
+  int sampled = 0;
+  for (int i = 0; i < 9; i++) {
+    if (tracer.Sample() != 0) {
+      sampled++;
+    }
+  }
+  ASSERT_EQ(sampled, 3);
+}
+
+TEST(WriteTracerTest, Stages) {
+  WriteTracer tracer("write_tracer_test_stages", 1);
+  tracer.OnProposed(5, tracer.Sample());
+  ASSERT_EQ(tracer.Count(WriteTracer::kQueue), 1);
+
+  // the entries not traced are ignored.
+  tracer.Record(WriteTracer::kReady, 1, 4);
+  ASSERT_EQ(tracer.Count(WriteTracer::kReady), 0);
+
+  tracer.Record(WriteTracer::kReady, 5, 6);
+  tracer.Record(WriteTracer::kWal, 5, 6);
+  ASSERT_EQ(tracer.Count(WriteTracer::kReady), 1);
+  ASSERT_EQ(tracer.Count(WriteTracer::kWal), 1);
+
+  // skipped
+  ASSERT_EQ(tracer.Count(WriteTracer::kSend), 0);
+
+  // a stage is recorded once.
+  tracer.Record(WriteTracer::kWal, 5, 5);
+  ASSERT_EQ(tracer.Count(WriteTracer::kWal), 1);
+
+  tracer.Record(WriteTracer::kCommit, 0, 4);
+  ASSERT_EQ(tracer.Count(WriteTracer::kCommit), 0);
+  tracer.Record(WriteTracer::kCommit, 0, 5);
+  ASSERT_EQ(tracer.Count(WriteTracer::kCommit), 1);
+
+  // the trace is discarded once notified.
+  tracer.Record(WriteTracer::kApply, 0, 5);
+  tracer.Record(WriteTracer::kApply, 0, 5);
+  ASSERT_EQ(tracer.Count(WriteTracer::kApply), 1);
+}